@@ -0,0 +1,297 @@
+/**
+ * @file affinita.c
+ * @author Marco Colognese
+*/
+
+#define _GNU_SOURCE
+#include "mylib.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <dirent.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+///Politiche di mbind() e get_mempolicy() (da numaif.h, senza dipendere da libnuma)
+#define MPOL_PREFERRED 1
+#define MPOL_F_NODE (1<<0)
+#define MPOL_F_ADDR (1<<1)
+
+///STRUTTURA CONTENENTE LA POSIZIONE DI UNA CPU NELLA TOPOLOGIA DELLA MACCHINA
+typedef struct posizione{
+	///Numero della CPU
+	int cpu;
+	///Nodo NUMA
+	int nodo;
+	///Socket
+	int socket;
+	///Core fisico, nel socket
+	int core;
+	///Ordine della CPU tra i thread dello stesso core (0 = primo thread)
+	int thread;
+	///Ordine della CPU nel suo nodo (core distinti prima dei thread fratelli), per la politica sparsa
+	int rango;
+}posizione;
+
+/**
+ * @brief Funzione che legge un intero da un file di /sys.
+ *
+ * @param percorso	percorso del file
+ * @param predefinito	valore restituito se il file non c'e' o non contiene un intero
+ * @return		intero letto
+*/
+
+static int leggi_sys(const char *percorso, int predefinito){
+	FILE *f=fopen(percorso, "r");
+	int x;
+
+	if(f==NULL)
+		return predefinito;
+	if(fscanf(f, "%d", &x)!=1)
+		x=predefinito;
+	fclose(f);
+	return x;
+}
+
+/**
+ * @brief Funzione che trova il nodo NUMA di una CPU (la directory nodeN in /sys/devices/system/cpu/cpuX).
+ *
+ * @param cpu		numero della CPU
+ * @return		nodo della CPU, 0 se il sistema non ha NUMA
+*/
+
+static int nodo_cpu(int cpu){
+	char percorso[64];
+	struct dirent *e;
+	DIR *d;
+	int nodo=0;
+
+	sprintf(percorso, "/sys/devices/system/cpu/cpu%d", cpu);
+	if((d=opendir(percorso))==NULL)
+		return 0;
+	while((e=readdir(d))!=NULL)
+		if(strncmp(e->d_name, "node", 4)==0 && e->d_name[4]>='0' && e->d_name[4]<='9'){
+			nodo=atoi(e->d_name+4);
+			break;
+		}
+	closedir(d);
+	return nodo;
+}
+
+/**
+ * @brief Funzioni di confronto per qsort: ordine compatto (nodo, socket, core, thread) e ordine sparso.
+ *
+ *	Nell'ordine sparso le CPU si alternano tra i nodi e, in ciascun nodo, si usano prima i core
+ *	distinti e poi i thread fratelli.
+*/
+
+static int compatto(const void *x, const void *y){
+	const posizione *a=(const posizione *)x, *b=(const posizione *)y;
+
+	if(a->nodo!=b->nodo)
+		return a->nodo-b->nodo;
+	if(a->socket!=b->socket)
+		return a->socket-b->socket;
+	if(a->core!=b->core)
+		return a->core-b->core;
+	return a->cpu-b->cpu;
+}
+
+static int sparso(const void *x, const void *y){
+	const posizione *a=(const posizione *)x, *b=(const posizione *)y;
+
+	if(a->rango!=b->rango)
+		return a->rango-b->rango;
+	if(a->nodo!=b->nodo)
+		return a->nodo-b->nodo;
+	return a->cpu-b->cpu;
+}
+
+/**
+ * @brief Funzione che legge un elenco di CPU, ad esempio "0,2,4-7".
+ *
+ * @param s		elenco
+ * @param cpu		CPU lette (al piu' CPU_SETSIZE)
+ * @return		numero di CPU lette, -1 se l'elenco non e' valido
+*/
+
+static int leggi_elenco(const char *s, int *cpu){
+	char *fine;
+	long da, a, k;
+	int n=0;
+
+	while(*s!='\0'){
+		da=strtol(s, &fine, 10);
+		if(fine==s)
+			return -1;
+		a=da;
+		if(*fine=='-'){
+			s=fine+1;
+			a=strtol(s, &fine, 10);
+			if(fine==s)
+				return -1;
+		}
+		if(da<0 || a<da || a>=CPU_SETSIZE || (*fine!=',' && *fine!='\0'))
+			return -1;
+		for(k=da; k<=a && n<CPU_SETSIZE; k++)
+			cpu[n++]=(int)k;
+		s=(*fine==',') ? fine+1 : fine;
+	}
+	return (n>0) ? n : -1;
+}
+
+/**
+ * @brief Funzione che calcola su quali CPU mettere il padre e i figli.
+ *
+ *	Con "compatta" le CPU consentite al processo vengono ordinate per nodo, socket e core, cosi'
+ *	il padre e i primi figli stanno sullo stesso nodo e i thread fratelli sono vicini; con
+ *	"sparsa" si alternano i nodi e si usano prima i core distinti; altrimenti spec e' un elenco
+ *	esplicito di CPU ("0,2,4-7"). Il padre prende la prima CPU dell'ordine e il figlio j la
+ *	j-esima, ripartendo dall'inizio se i figli sono piu' delle CPU. Per ogni posto si calcola
+ *	anche il nodo NUMA, in cui allocare le code del figlio.
+ *
+ * @param spec		"compatta", "sparsa" o elenco di CPU
+ * @param num_proc	numero di figli
+ * @param cpu		CPU del padre (cpu[0]) e dei figli (cpu[j]), num_proc+1 elementi
+ * @param nodo		nodo NUMA di ciascun posto, num_proc+1 elementi
+ * @return		numero di nodi NUMA distinti usati, -1 se spec non e' valido
+*/
+
+int affinita_piano(const char *spec, int num_proc, int *cpu, int *nodo){
+	posizione *p;
+	cpu_set_t consentite;
+	char percorso[96];
+	int *elenco, n=0, j, k, nodi=0;
+
+	p=(posizione *)malloc(CPU_SETSIZE*sizeof(posizione));
+	elenco=(int *)malloc(CPU_SETSIZE*sizeof(int));
+	if(p==NULL || elenco==NULL){
+		free(p);
+		free(elenco);
+		return -1;
+	}
+
+	if(strcmp(spec, "compatta")==0 || strcmp(spec, "sparsa")==0){
+		CPU_ZERO(&consentite);
+		if(sched_getaffinity(0, sizeof(consentite), &consentite)==-1)
+			CPU_SET(0, &consentite);
+		for(j=0; j<CPU_SETSIZE; j++)
+			if(CPU_ISSET(j, &consentite))
+				elenco[n++]=j;
+	}
+	else if((n=leggi_elenco(spec, elenco))==-1){
+		free(p);
+		free(elenco);
+		return -1;
+	}
+
+	//topologia da /sys: senza le informazioni ogni CPU e' un core a se' sul nodo 0
+	for(j=0; j<n; j++){
+		p[j].cpu=elenco[j];
+		p[j].nodo=nodo_cpu(elenco[j]);
+		sprintf(percorso, "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", elenco[j]);
+		p[j].socket=leggi_sys(percorso, 0);
+		sprintf(percorso, "/sys/devices/system/cpu/cpu%d/topology/core_id", elenco[j]);
+		p[j].core=leggi_sys(percorso, elenco[j]);
+	}
+	if(strcmp(spec, "compatta")==0 || strcmp(spec, "sparsa")==0)
+		qsort(p, n, sizeof(posizione), compatto);
+	if(strcmp(spec, "sparsa")==0){
+		//rango: core distinti del nodo prima, poi i thread fratelli (ordine compatto gia' applicato)
+		for(j=0; j<n; j++){
+			p[j].thread=(j>0 && p[j-1].nodo==p[j].nodo && p[j-1].socket==p[j].socket && p[j-1].core==p[j].core) ? p[j-1].thread+1 : 0;
+			p[j].rango=0;
+		}
+		for(j=0; j<n; j++)
+			for(k=0; k<n; k++)
+				if(p[k].nodo==p[j].nodo && (p[k].thread<p[j].thread || (p[k].thread==p[j].thread && k<j)))
+					p[j].rango++;
+		qsort(p, n, sizeof(posizione), sparso);
+	}
+
+	for(j=0; j<=num_proc; j++){
+		cpu[j]=p[j%n].cpu;
+		nodo[j]=p[j%n].nodo;
+	}
+	for(j=0; j<n; j++){
+		for(k=0; k<j && p[k].nodo!=p[j].nodo; k++)
+			;
+		if(k==j)
+			nodi++;
+	}
+	free(p);
+	free(elenco);
+	return nodi;
+}
+
+/**
+ * @brief Funzione che lega il thread chiamante (il processo, se ha un solo thread) a una CPU.
+ *
+ * @param cpu		numero della CPU
+ * @return		0 in caso di successo, -1 in caso di errore
+*/
+
+int affinita_applica(int cpu){
+	cpu_set_t s;
+
+	CPU_ZERO(&s);
+	CPU_SET(cpu, &s);
+	return sched_setaffinity(0, sizeof(s), &s);
+}
+
+/**
+ * @brief Funzione che restituisce la CPU e il nodo NUMA su cui sta girando il chiamante.
+ *
+ * @param cpu		CPU corrente (-1 se non disponibile)
+ * @param nodo		nodo corrente (-1 se non disponibile)
+*/
+
+void affinita_dove(int *cpu, int *nodo){
+	unsigned c, n;
+
+	if(syscall(SYS_getcpu, &c, &n, NULL)==-1){
+		*cpu=-1;
+		*nodo=-1;
+		return;
+	}
+	*cpu=(int)c;
+	*nodo=(int)n;
+}
+
+/**
+ * @brief Funzione che chiede di allocare le pagine di una zona di memoria sul nodo NUMA indicato.
+ *
+ *	Si usa MPOL_PREFERRED: se il nodo non ha memoria libera il kernel ripiega sugli altri. Se
+ *	il kernel non supporta NUMA l'errore viene ignorato dal chiamante.
+ *
+ * @param ind		inizio della zona, allineato alla pagina
+ * @param dim		dimensione della zona, multiplo della pagina
+ * @param nodo		nodo NUMA
+ * @return		0 in caso di successo, -1 in caso di errore
+*/
+
+int affinita_lega_memoria(void *ind, size_t dim, int nodo){
+	unsigned long maschera[16];
+
+	if(nodo<0 || nodo>=(int)(8*sizeof(maschera)))
+		return -1;
+	memset(maschera, 0, sizeof(maschera));
+	maschera[nodo/(8*sizeof(unsigned long))]|=1UL<<(nodo%(8*sizeof(unsigned long)));
+	return (syscall(SYS_mbind, ind, dim, MPOL_PREFERRED, maschera, 8*sizeof(maschera), 0)==-1) ? -1 : 0;
+}
+
+/**
+ * @brief Funzione che restituisce il nodo NUMA su cui si trova la pagina di un indirizzo.
+ *
+ * @param ind		indirizzo (la pagina deve essere gia' stata scritta)
+ * @return		nodo della pagina, -1 se non disponibile
+*/
+
+int affinita_nodo_memoria(const void *ind){
+	int nodo=-1;
+
+	if(syscall(SYS_get_mempolicy, &nodo, NULL, 0, ind, MPOL_F_NODE|MPOL_F_ADDR)==-1)
+		return -1;
+	return nodo;
+}
@@ -0,0 +1,211 @@
+/**
+ * @file arena.c
+ * @author Marco Colognese
+*/
+
+#include "mylib.h"
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/shm.h>
+
+/**
+ * @brief Funzione che crea l'unica regione di memoria condivisa tra padre e figli.
+ *
+ *	La regione contiene un'intestazione, un array di NUM_PROC slot (ciascuno allineato alla
+ *	linea di cache, cosi' i campi di figli diversi non finiscono mai sulla stessa linea) e, di
+ *	seguito, lo spazio per le code di operazioni, risultati e operazioni condivise di ogni figlio. La regione e'
+ *	anonima (MAP_SHARED|MAP_ANONYMOUS): viene ereditata dai figli con la fork() e sparisce da
+ *	sola quando l'ultimo processo termina, anche in caso di crash. Se mmap() non e' disponibile
+ *	si ripiega su un segmento IPC_PRIVATE marcato subito per la rimozione. In entrambi i casi
+ *	servono O(1) system call, indipendentemente da NUM_PROC.
+ *
+ *	Se nodi non e' NULL le code di ciascun figlio iniziano su una pagina propria e vengono
+ *	allocate, se possibile, sul nodo NUMA del figlio (vedi affinita.c): gli slot restano
+ *	nell'intestazione, che e' comune a padre e figli.
+ *
+ *	In fondo alla regione c'e' la tabella dei valori: il risultato di ciascuna delle ultime
+ *	2*finestra operazioni, scritto dal figlio che la svolge e letto da chi ne dipende ($N).
+ *
+ * @param num_proc	numero di processi figli
+ * @param profondita	numero di elementi di ciascuna coda, potenza di 2
+ * @param finestra	numero massimo di operazioni lette e non ancora consegnate
+ * @param modo		meccanismo di sincronizzazione (SYNC_SYSV o SYNC_FUTEX)
+ * @param semaforo	id dell'array di semafori, uno per figlio piu' uno per il padre (solo SYNC_SYSV)
+ * @param costi		modello di costo delle operazioni, copiato nella regione
+ * @param nodi		nodo NUMA delle code di ciascun figlio (NULL = nessuna preferenza)
+ * @return		puntatore alla regione, NULL in caso di errore
+*/
+
+arena *arena_crea(int num_proc, unsigned profondita, unsigned finestra, int modo, int semaforo, const modello_costo *costi, const int *nodi){
+	arena *a;
+	char *code;
+	size_t pagina=(nodi!=NULL) ? (size_t)sysconf(_SC_PAGESIZE) : CACHE_LINE;
+	size_t testa=(sizeof(arena)+(size_t)num_proc*sizeof(share_mem)+pagina-1)&~(pagina-1);
+	size_t blocco=((size_t)profondita*(2*sizeof(lavoro)+2*sizeof(risultato))+pagina-1)&~(pagina-1);
+	size_t code_dim=(size_t)num_proc*blocco;
+	int parole=(num_proc+63)/64;
+	size_t dim=testa+code_dim+parole*sizeof(unsigned long long)+2*(size_t)finestra*sizeof(valore);
+	int shm_id, j;
+
+	a=(arena *)mmap(NULL, dim, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+	if(a==(arena *)MAP_FAILED){
+		if((shm_id=shmget(IPC_PRIVATE, dim, IPC_CREAT|0600))==-1)
+			return NULL;
+		a=(arena *)shmat(shm_id, NULL, 0);
+		//il segmento viene distrutto all'ultimo shmdt(), anche se il padre muore prima
+		shmctl(shm_id, IPC_RMID, NULL);
+		if(a==(arena *)-1)
+			return NULL;
+		memset(a, 0, dim);
+		a->sysv=true;
+	}
+	a->num_proc=num_proc;
+	a->profondita=profondita;
+	a->dim=dim;
+	a->costi=*costi;
+	a->verboso=true;
+	a->furto=false;
+	a->tracce=NULL;
+	a->memo=NULL;
+	attesa_init(&a->padre, modo, semaforo, num_proc);
+
+	code=(char *)a+testa;
+	for(j=0; j<num_proc; j++){
+		a->slot[j].code=code;
+		a->slot[j].cpu=-1;
+		a->slot[j].nodo=-1;
+		//le pagine delle code non sono ancora state toccate: verranno allocate sul nodo del figlio
+		if(nodi!=NULL && nodi[j]>=0 && affinita_lega_memoria(code, blocco, nodi[j])==0)
+			a->slot[j].nodo=nodi[j];
+		ring_init(&a->slot[j].richieste, code, profondita, sizeof(lavoro));
+		code+=profondita*sizeof(lavoro);
+		ring_init(&a->slot[j].risultati, code, 2*profondita, sizeof(risultato));
+		code+=2*profondita*sizeof(risultato);
+		spmc_init(&a->slot[j].condivise, (lavoro *)code, profondita);
+		code+=profondita*sizeof(lavoro);
+		attesa_init(&a->slot[j].attesa, modo, semaforo, j);
+		code=(char *)a->slot[j].code+blocco;
+	}
+
+	//bitmap dei figli liberi, dopo le code: all'inizio sono tutti liberi
+	a->liberi=(_Atomic unsigned long long *)((char *)a+testa+code_dim);
+	a->parole=parole;
+	for(j=0; j<parole; j++)
+		atomic_init(&a->liberi[j], 0);
+	for(j=0; j<num_proc; j++)
+		a->liberi[j/64]|=1ULL<<(j%64);
+
+	//tabella dei valori, dopo la bitmap: la regione e' gia' azzerata, nessun risultato
+	a->valori=(valore *)(a->liberi+parole);
+	a->num_valori=2*finestra;
+	return a;
+}
+
+/**
+ * @brief Funzione che stacca la regione di memoria condivisa.
+ *
+ * @param a		regione creata con arena_crea()
+*/
+
+void arena_distruggi(arena *a){
+	if(a->sysv)
+		shmdt(a);
+	else
+		munmap(a, a->dim);
+}
+
+/**
+ * @brief Funzione che segna come libero il figlio j+1 nella bitmap condivisa.
+ *
+ * @param a		regione condivisa
+ * @param j		indice del figlio (da 0 a NUM_PROC-1)
+*/
+
+void arena_libera(arena *a, int j){
+	atomic_fetch_or_explicit(&a->liberi[j/64], 1ULL<<(j%64), memory_order_release);
+}
+
+/**
+ * @brief Funzione che segna come occupato il figlio j+1 nella bitmap condivisa.
+ *
+ *	Il bit viene letto prima di essere azzerato, cosi' se e' gia' zero non si scrive sulla linea.
+ *
+ * @param a		regione condivisa
+ * @param j		indice del figlio (da 0 a NUM_PROC-1)
+*/
+
+void arena_occupa(arena *a, int j){
+	unsigned long long bit=1ULL<<(j%64);
+
+	if(atomic_load_explicit(&a->liberi[j/64], memory_order_relaxed)&bit)
+		atomic_fetch_and_explicit(&a->liberi[j/64], ~bit, memory_order_relaxed);
+}
+
+/**
+ * @brief Funzione che cerca un figlio libero nella bitmap, partendo dall'indice da.
+ *
+ *	Ogni parola da 64 bit viene esaminata con una sola find-first-set, quindi il costo e'
+ *	NUM_PROC/64 letture nel caso peggiore invece di NUM_PROC semop().
+ *
+ * @param a		regione condivisa
+ * @param da		indice (da 0 a NUM_PROC-1) da cui iniziare la ricerca, circolarmente
+ * @return		indice del primo figlio libero trovato, -1 se sono tutti occupati
+*/
+
+int arena_cerca_libero(arena *a, int da){
+	unsigned long long w;
+	int k, i=da/64;
+
+	//prima parola: solo i bit da 'da' in poi
+	w=atomic_load_explicit(&a->liberi[i], memory_order_acquire)&(~0ULL<<(da%64));
+	for(k=0; k<=a->parole; k++){
+		if(w!=0)
+			return i*64+__builtin_ctzll(w);
+		i=(i+1==a->parole) ? 0 : i+1;
+		w=atomic_load_explicit(&a->liberi[i], memory_order_acquire);
+		//tornato alla prima parola: restano i bit prima di 'da'
+		if(k+1==a->parole)
+			w&=~(~0ULL<<(da%64));
+	}
+	return -1;
+}
+
+/**
+ * @brief Funzione che scrive il risultato dell'operazione seq nella tabella dei valori.
+ *
+ *	Il numero d'ordine viene pubblicato dopo il risultato, cosi' chi lo vede legge il risultato giusto.
+ *
+ * @param a		regione condivisa
+ * @param seq		numero d'ordine dell'operazione
+ * @param res		risultato
+*/
+
+void arena_scrivi_valore(arena *a, unsigned long long seq, int res){
+	valore *v=&a->valori[seq%a->num_valori];
+
+	v->res=res;
+	atomic_store_explicit(&v->seq, seq+1, memory_order_release);
+}
+
+/**
+ * @brief Funzione che legge il risultato dell'operazione seq dalla tabella dei valori, se e' gia' stato scritto.
+ *
+ *	Il posto dell'operazione seq viene riusato dall'operazione seq+2*finestra, che il padre non
+ *	legge finche' le operazioni che possono dipendere da seq non sono state consegnate.
+ *
+ * @param a		regione condivisa
+ * @param seq		numero d'ordine dell'operazione
+ * @param res		risultato letto
+ * @return		true se il risultato e' pronto
+*/
+
+bool arena_valore(const arena *a, unsigned long long seq, int *res){
+	const valore *v=&a->valori[seq%a->num_valori];
+
+	if(atomic_load_explicit(&v->seq, memory_order_acquire)!=seq+1)
+		return false;
+	*res=v->res;
+	return true;
+}
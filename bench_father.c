@@ -0,0 +1,263 @@
+/**
+ * @file bench_father.c
+ * @author Marco Colognese
+*/
+
+#include "mylib.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+/**
+ * @brief Benchmark del simulatore completo, per confrontare le prestazioni tra versioni diverse.
+ *
+ *	Per ogni forma del carico e per ogni numero di processi indicato con -p, genera con il
+ *	programma generatore un file binario di N operazioni e lo fa svolgere a father (con -q,
+ *	costo nullo e risultati scartati), ripetendo ogni misura R volte. Per ogni combinazione
+ *	stampa una riga chiave=valore con la ripetizione mediana per operazioni al secondo:
+ *		forma, processi, operazioni, secondi, op_al_secondo, p50_ns e p99_ns (latenza di
+ *		completamento misurata da father, vedi statistiche.c) e rss_max_kb (massimo della
+ *		memoria residente di father e dei suoi figli).
+ *	Le forme sono:
+ *		1. fissi: tutte le operazioni hanno un id, uniforme tra i figli;
+ *		2. liberi: tutte le operazioni hanno id 0;
+ *		3. misti: meta' con id, meta' con id 0;
+ *		4. asimmetrici: id con legge di Zipf (k=1.2), pochi con id 0, cosi' i primi figli sono sovraccarichi;
+ *		5. prodotti: come misti, ma quasi solo moltiplicazioni;
+ *		6. dipendenti: come liberi, ma meta' delle operazioni usa il risultato di una delle 16
+ *		   precedenti ($N);
+ *		7. ripetute: come misti, ma con pochi operandi distinti, cosi' le stesse operazioni si
+ *		   ripetono spesso (per la cache dei risultati, -e "-M voci").
+ *	Con -e si passano altre opzioni a father (ad esempio "-b thread -s futex").
+ *
+ *	Uso: bench_father [-n operazioni] [-p processi,...] [-f forma,...] [-r ripetizioni] [-e "opzioni di father"]
+*/
+
+///Messaggio di uso del programma
+static const char uso[]="Uso: bench_father [-n operazioni] [-p processi,...] [-f forma,...] [-r ripetizioni] [-e \"opzioni di father\"]\n";
+
+///File temporaneo del carico
+#define CARICO "bench_carico.bin"
+
+///Numero massimo di ripetizioni e di argomenti dei programmi eseguiti
+#define MAX_RIPETIZIONI 64
+#define MAX_ARGOMENTI 64
+
+///STRUTTURA CONTENENTE UNA FORMA DEL CARICO: NOME E OPZIONI DEL GENERATORE
+typedef struct forma{
+	const char *nome;
+	const char *opzioni[8];
+}forma;
+
+static const forma FORME[]={
+	{"fissi", {"-z", "0", NULL}},
+	{"liberi", {"-z", "1", NULL}},
+	{"misti", {"-z", "0.5", NULL}},
+	{"asimmetrici", {"-z", "0.1", "-k", "1.2", NULL}},
+	{"prodotti", {"-z", "0.5", "-m", "*=8,+=1", NULL}},
+	{"dipendenti", {"-z", "1", "-d", "0.5:16", NULL}},
+	{"ripetute", {"-z", "0.5", "-a", "1:100", "-b", "1:10", NULL}},
+};
+
+///STRUTTURA CONTENENTE LA MISURA DI UNA ESECUZIONE DI FATHER
+typedef struct misura{
+	double secondi;
+	unsigned long long p50, p99;
+	long rss_kb;
+}misura;
+
+/**
+ * @brief Funzione che restituisce il tempo trascorso in secondi.
+*/
+
+static double secondi(void){
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec+t.tv_nsec*1e-9;
+}
+
+/**
+ * @brief Funzione che esegue un programma e ne attende la terminazione.
+ *
+ * @param argv		argomenti del programma (argv[0] = percorso), terminati da NULL
+ * @param uscita	se non e' NULL, buffer in cui salvare lo standard output del programma (terminato da '\0')
+ * @param dim		dimensione del buffer
+ * @param uso		risorse usate dal programma e dai suoi figli
+ * @return		0 se il programma e' terminato con successo, -1 altrimenti
+*/
+
+static int esegui(char *const argv[], char *uscita, size_t dim, struct rusage *uso){
+	size_t len=0;
+	ssize_t r;
+	int tubo[2], stato;
+	pid_t pid;
+
+	if(uscita!=NULL && pipe(tubo)==-1)
+		return -1;
+	if((pid=fork())==-1)
+		return -1;
+	if(pid==0){
+		if(uscita!=NULL){
+			dup2(tubo[1], STDOUT);
+			close(tubo[0]);
+			close(tubo[1]);
+		}
+		execv(argv[0], argv);
+		_exit(127);
+	}
+	if(uscita!=NULL){
+		//si legge tutto per non bloccare il programma; se il buffer e' pieno si tiene la seconda meta' (le righe STAT sono alla fine)
+		close(tubo[1]);
+		while((r=read(tubo[0], uscita+len, dim-1-len))>0){
+			if((len+=r)==dim-1){
+				memmove(uscita, uscita+len/2, len-len/2);
+				len-=len/2;
+			}
+		}
+		uscita[len]='\0';
+		close(tubo[0]);
+	}
+	if(wait4(pid, &stato, 0, uso)==-1)
+		return -1;
+	return (WIFEXITED(stato) && WEXITSTATUS(stato)==0) ? 0 : -1;
+}
+
+/**
+ * @brief Funzione che legge il valore di una chiave nella riga "STAT padre latenza=completamento" di father.
+ *
+ * @param testo		standard output di father
+ * @param chiave	chiave da leggere, con '=' finale
+ * @return		valore, 0 se non trovato
+*/
+
+static unsigned long long latenza(const char *testo, const char *chiave){
+	const char *riga=strstr(testo, "STAT padre latenza=completamento"), *s;
+
+	if(riga==NULL || (s=strstr(riga, chiave))==NULL)
+		return 0;
+	return strtoull(s+strlen(chiave), NULL, 10);
+}
+
+/**
+ * @brief Funzione che confronta due misure per operazioni al secondo (cioe' per tempo), per qsort.
+*/
+
+static int confronta(const void *x, const void *y){
+	double a=((const misura *)x)->secondi, b=((const misura *)y)->secondi;
+
+	return (a>b)-(a<b);
+}
+
+int main(int argc, char *argv[]){
+	long n=1000000;				//numero di operazioni per file
+	char processi_def[]="1,2,4,8";
+	char *processi=processi_def;		//elenco dei numeri di processi
+	const char *forme=NULL;			//elenco delle forme (NULL = tutte)
+	int ripetizioni=3;
+	char *extra=NULL;			//opzioni aggiuntive di father
+	char *gen[MAX_ARGOMENTI], *fat[MAX_ARGOMENTI];
+	char num_op[32], num_proc[32], *copia, *p, *tok;
+	static char testo[1<<16];		//standard output di father
+	misura m[MAX_RIPETIZIONI];
+	struct rusage ru;
+	double t0;
+	int opt, f, i, k, g, a, np;
+
+	while((opt=getopt(argc, argv, "n:p:f:r:e:"))!=-1){
+		switch(opt){
+			case 'n':
+				n=atol(optarg);
+				break;
+			case 'p':
+				processi=optarg;
+				break;
+			case 'f':
+				forme=optarg;
+				break;
+			case 'r':
+				ripetizioni=atoi(optarg);
+				break;
+			case 'e':
+				extra=optarg;
+				break;
+			default:
+				fprintf(stderr, "%s", uso);
+				exit(1);
+		}
+	}
+	if(n<1 || ripetizioni<1 || ripetizioni>MAX_RIPETIZIONI){
+		fprintf(stderr, "%s", uso);
+		exit(1);
+	}
+	if(access("./father", X_OK)==-1 || access("./generatore", X_OK)==-1){
+		fprintf(stderr, "Servono ./father e ./generatore (make father generatore)\n");
+		exit(1);
+	}
+	sprintf(num_op, "%ld", n);
+
+	//argomenti fissi di father: il file del carico e' l'ultimo
+	a=0;
+	fat[a++]="./father";
+	fat[a++]="-q";
+	fat[a++]="-c";
+	fat[a++]="zero";
+	fat[a++]="-o";
+	fat[a++]="/dev/null";
+	for(tok=(extra!=NULL) ? strtok(extra, " ") : NULL; tok!=NULL && a<MAX_ARGOMENTI-2; tok=strtok(NULL, " "))
+		fat[a++]=tok;
+	fat[a++]=CARICO;
+	fat[a]=NULL;
+
+	for(f=0; f<(int)(sizeof(FORME)/sizeof(FORME[0])); f++){
+		if(forme!=NULL && !strstr(forme, FORME[f].nome))
+			continue;
+		copia=strdup(processi);
+		for(p=strtok(copia, ","); p!=NULL; p=strtok(NULL, ",")){
+			if((np=atoi(p))<1)
+				continue;
+			sprintf(num_proc, "%d", np);
+
+			//generazione del carico (lo stesso seme per tutte le versioni confrontate)
+			g=0;
+			gen[g++]="./generatore";
+			gen[g++]="-B";
+			gen[g++]="-n";
+			gen[g++]=num_op;
+			gen[g++]="-p";
+			gen[g++]=num_proc;
+			for(k=0; FORME[f].opzioni[k]!=NULL; k++)
+				gen[g++]=(char *)FORME[f].opzioni[k];
+			gen[g++]=CARICO;
+			gen[g]=NULL;
+			if(esegui(gen, NULL, 0, &ru)==-1){
+				fprintf(stderr, "Generazione del carico fallita\n");
+				exit(1);
+			}
+
+			for(i=0; i<ripetizioni; i++){
+				t0=secondi();
+				if(esegui(fat, testo, sizeof(testo), &ru)==-1){
+					fprintf(stderr, "father fallito (forma=%s processi=%d)\n", FORME[f].nome, np);
+					unlink(CARICO);
+					exit(1);
+				}
+				m[i].secondi=secondi()-t0;
+				m[i].p50=latenza(testo, "p50_ns=");
+				m[i].p99=latenza(testo, "p99_ns=");
+				m[i].rss_kb=ru.ru_maxrss;
+			}
+			qsort(m, ripetizioni, sizeof(misura), confronta);
+			i=ripetizioni/2;
+			printf("forma=%s processi=%d operazioni=%ld ripetizioni=%d secondi=%.3f op_al_secondo=%.0f p50_ns=%llu p99_ns=%llu rss_max_kb=%ld\n", FORME[f].nome, np, n, ripetizioni, m[i].secondi, n/m[i].secondi, m[i].p50, m[i].p99, m[i].rss_kb);
+			fflush(stdout);
+		}
+		free(copia);
+	}
+	unlink(CARICO);
+	return 0;
+}
@@ -0,0 +1,129 @@
+/**
+ * @file bench_kernel.c
+ * @author Marco Colognese
+*/
+
+#include "mylib.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+
+/**
+ * @brief Micro-benchmark che confronta il calcolo di un'operazione alla volta con i kernel dei lotti.
+ *
+ *	Su N operazioni casuali (operatori mescolati, come in un file di configurazione) misura le
+ *	operazioni al secondo di:
+ *		1. per_op: lo switch sull'operatore del vecchio ciclo dei figli, un'operazione alla volta.
+ *		2. lotto: kernel_lotto() su lotti di LOTTO operazioni, con ciascun kernel supportato
+ *		   (scalare, sse2, avx2), compreso il raggruppamento per operatore.
+ *		3. contiguo: kernel_calcola() su array contigui di un solo operatore, cioe' il limite
+ *		   superiore dei kernel senza il costo del raggruppamento.
+ *
+ *	Uso: bench_kernel [-n operazioni] [-g ripetizioni]
+*/
+
+static const char OPERAZIONI[4]={'+', '-', '*', '/'};
+
+/**
+ * @brief Funzione che restituisce il tempo trascorso in secondi.
+*/
+
+static double secondi(void){
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec+t.tv_nsec*1e-9;
+}
+
+/**
+ * @brief Funzione che svolge un'operazione come il vecchio ciclo dei figli (con la divisione protetta).
+*/
+
+static int __attribute__((noinline)) per_op(const lavoro *l){
+	switch(l->op){
+		case '+': return (int)((unsigned)l->val1+(unsigned)l->val2);
+		case '-': return (int)((unsigned)l->val1-(unsigned)l->val2);
+		case '*': return (int)((unsigned)l->val1*(unsigned)l->val2);
+		case '/': return (l->val2==0) ? 0 : (l->val2==-1) ? (int)(0u-(unsigned)l->val1) : l->val1/l->val2;
+		default: return 0;
+	}
+}
+
+int main(int argc, char *argv[]){
+	long n=1<<20;
+	int giri=20;
+	lavoro *l;
+	int *res, *controllo, *a, *b;
+	unsigned long long x=88172645463325252ULL;
+	long i, k;
+	double t0, t;
+	int opt, tipo, massimo, g;
+
+	while((opt=getopt(argc, argv, "n:g:"))!=-1){
+		switch(opt){
+			case 'n': n=atol(optarg); break;
+			case 'g': giri=atoi(optarg); break;
+			default:
+				fprintf(stderr, "Uso: bench_kernel [-n operazioni] [-g ripetizioni]\n");
+				exit(1);
+		}
+	}
+	if(n<LOTTO || giri<1){
+		fprintf(stderr, "Parametri non validi\n");
+		exit(1);
+	}
+	n-=n%LOTTO;
+
+	l=(lavoro *)malloc(n*sizeof(lavoro));
+	res=(int *)malloc(n*sizeof(int));
+	controllo=(int *)malloc(n*sizeof(int));
+	a=(int *)malloc(n*sizeof(int));
+	b=(int *)malloc(n*sizeof(int));
+	for(i=0; i<n; i++){
+		x^=x<<13; x^=x>>7; x^=x<<17;
+		l[i].val1=(int)(x>>32);
+		l[i].val2=(int)(x&0xFFFF)-0x8000;
+		l[i].op=OPERAZIONI[(x>>20)&3];
+		a[i]=l[i].val1;
+		b[i]=l[i].val2;
+	}
+
+	t0=secondi();
+	for(g=0; g<giri; g++)
+		for(i=0; i<n; i++)
+			controllo[i]=per_op(&l[i]);
+	t=secondi()-t0;
+	printf("metodo=per_op kernel=- operazioni=%ld secondi=%.3f op_al_secondo=%.0f\n", n*giri, t, n*giri/t);
+
+	massimo=kernel_init(KERNEL_AUTO);
+	for(tipo=KERNEL_SCALARE; tipo<=massimo; tipo++){
+		kernel_init(tipo);
+		t0=secondi();
+		for(g=0; g<giri; g++)
+			for(i=0; i<n; i+=LOTTO)
+				kernel_lotto(l+i, res+i, LOTTO);
+		t=secondi()-t0;
+		if(memcmp(res, controllo, n*sizeof(int))!=0){
+			fprintf(stderr, "Il kernel %s non coincide con il calcolo per operazione\n", kernel_nome(tipo));
+			exit(1);
+		}
+		printf("metodo=lotto kernel=%s operazioni=%ld secondi=%.3f op_al_secondo=%.0f\n", kernel_nome(tipo), n*giri, t, n*giri/t);
+
+		for(k=0; k<3; k++){
+			t0=secondi();
+			for(g=0; g<giri; g++)
+				kernel_calcola(OPERAZIONI[k], a, b, res, (int)n);
+			t=secondi()-t0;
+			printf("metodo=contiguo kernel=%s op=%c operazioni=%ld secondi=%.3f op_al_secondo=%.0f\n", kernel_nome(tipo), OPERAZIONI[k], n*giri, t, n*giri/t);
+		}
+	}
+
+	free(l);
+	free(res);
+	free(controllo);
+	free(a);
+	free(b);
+	return 0;
+}
@@ -0,0 +1,241 @@
+/**
+ * @file bench_ring.c
+ * @author Marco Colognese
+*/
+
+#include "mylib.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/sem.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#include <signal.h>
+
+/**
+ * @brief Micro-benchmark che confronta il protocollo a casella singola originale con le code circolari.
+ *
+ *	Il padre invia N operazioni a NUM_PROC figli (l'operazione i al figlio i%NUM_PROC+1), senza
+ *	sleep() e senza stampe, e misura le operazioni al secondo di ciascun protocollo:
+ *		1. mailbox: lo slot share_mem originale con la coppia di semafori pari/dispari per figlio e
+ *		   il semaforo intero, con le stesse semop() del vecchio father.c.
+ *		2. ring: le code di arena_crea(), il distributore e il ciclo dei figli usati oggi da
+ *		   father.c (con costo nullo e senza stampe), con la sincronizzazione scelta con -s
+ *		   (sysv, futex o entrambe).
+ *
+ *	Con -0 le operazioni del protocollo a code hanno tutte id 0, cosi' si misura la scelta del
+ *	figlio libero al crescere di NUM_PROC.
+ *
+ *	Uso: bench_ring [-n operazioni] [-p processi] [-r profondita] [-s sysv|futex|tutte] [-0]
+*/
+
+///STRUTTURA CONTENENTE LO SLOT DEL VECCHIO PROTOCOLLO A CASELLA SINGOLA
+typedef struct casella{
+	int val1;
+	char op;
+	int val2;
+	int res;
+	bool finish;
+}mailbox;
+
+/**
+ * @brief Funzione che esegue una semop() su un solo semaforo o su una coppia (attesa dello zero e incremento).
+ *
+ * @param semaforo	id dell'array di semafori
+ * @param num		indice del semaforo
+ * @param op		operazione (0 = coppia attesa dello zero + incremento)
+*/
+
+static void sem(int semaforo, int num, int op){
+	struct sembuf sops[2];
+
+	sops[0].sem_num=num;
+	sops[0].sem_op=op;
+	sops[0].sem_flg=0;
+	sops[1].sem_num=num;
+	sops[1].sem_op=1;
+	sops[1].sem_flg=0;
+	semop(semaforo, sops, op==0 ? 2 : 1);
+}
+
+/**
+ * @brief Funzione che svolge un'operazione aritmetica.
+*/
+
+static int calcola(int a, char op, int b){
+	switch(op){
+		case '+': return a+b;
+		case '-': return a-b;
+		case '*': return a*b;
+		default: return b ? a/b : 0;
+	}
+}
+
+/**
+ * @brief Funzione che restituisce il tempo trascorso in secondi.
+*/
+
+static double secondi(void){
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec+t.tv_nsec*1e-9;
+}
+
+static void nulla(void *ctx, const risultato *r){
+	(void)ctx;
+	(void)r;
+}
+
+static const char OPERAZIONI[4]={'+', '-', '*', '/'};
+
+/**
+ * @brief Funzione che misura il vecchio protocollo: semafori pari=figli, dispari=padre, 2*NUM_PROC=intero.
+*/
+
+static double bench_mailbox(long n, int num_proc){
+	mailbox *m=(mailbox *)mmap(NULL, num_proc*sizeof(mailbox), PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+	int semaforo=semget(IPC_PRIVATE, 2*num_proc+1, IPC_CREAT|0600);
+	double t0, t;
+	long i;
+	int j, val;
+
+	for(j=0; j<num_proc; j++)
+		sem(semaforo, 2*j, 1);
+	for(j=0; j<num_proc; j++)
+		sem(semaforo, 2*num_proc, 1);
+
+	for(j=0; j<num_proc; j++){
+		if(fork()==0){
+			prctl(PR_SET_PDEATHSIG, SIGKILL);
+			while(true){
+				sem(semaforo, 2*j, 0);
+				if(m[j].op=='K')
+					_exit(0);
+				m[j].res=calcola(m[j].val1, m[j].op, m[j].val2);
+				m[j].finish=true;
+				sem(semaforo, 2*j+1, -1);
+				sem(semaforo, 2*num_proc, 1);
+			}
+		}
+	}
+
+	t0=secondi();
+	for(i=0; i<n; i++){
+		val=i%num_proc;
+		sem(semaforo, 2*num_proc, -1);
+		sem(semaforo, 2*val+1, 0);
+		m[val].finish=false;
+		m[val].val1=(int)i;
+		m[val].op=OPERAZIONI[i&3];
+		m[val].val2=7;
+		sem(semaforo, 2*val, -1);
+	}
+	for(j=0; j<num_proc; j++){
+		sem(semaforo, 2*num_proc, -1);
+		sem(semaforo, 2*j+1, 0);
+		m[j].op='K';
+		sem(semaforo, 2*j, -1);
+	}
+	for(j=0; j<num_proc; j++)
+		wait(NULL);
+	t=secondi()-t0;
+
+	semctl(semaforo, 0, IPC_RMID, 0);
+	munmap(m, num_proc*sizeof(mailbox));
+	return t;
+}
+
+/**
+ * @brief Funzione che misura il protocollo a code circolari di father.c.
+*/
+
+static double bench_code(long n, int num_proc, unsigned profondita, int modo, bool liberi){
+	int semaforo=(modo==SYNC_SYSV) ? semget(IPC_PRIVATE, num_proc+1, IPC_CREAT|0600) : -1;
+	modello_costo costi;
+	arena *a;
+	dispatcher d;
+	lavoro l;
+	double t0, t;
+	long i;
+	int j;
+
+	costo_init(&costi, 0);
+	a=arena_crea(num_proc, profondita, FINESTRA, modo, semaforo, &costi, NULL);
+	a->verboso=false;
+
+	for(j=0; j<num_proc; j++){
+		if(fork()==0){
+			prctl(PR_SET_PDEATHSIG, SIGKILL);
+			esegui_figlio(a, j+1);
+			_exit(0);
+		}
+	}
+
+	disp_init(&d, a, FINESTRA, nulla, NULL);
+	d.verboso=false;
+	t0=secondi();
+	for(i=0; i<n; i++){
+		l.riga=(int)i;
+		l.id=liberi ? 0 : i%num_proc+1;
+		l.val1=(int)i;
+		l.op=OPERAZIONI[i&3];
+		l.val2=7;
+		disp_invia(&d, &l);
+	}
+	disp_svuota(&d);
+	disp_termina(&d);
+	for(j=0; j<num_proc; j++)
+		wait(NULL);
+	t=secondi()-t0;
+
+	disp_chiudi(&d);
+	if(semaforo!=-1)
+		semctl(semaforo, 0, IPC_RMID, 0);
+	arena_distruggi(a);
+	return t;
+}
+
+int main(int argc, char *argv[]){
+	long n=200000;
+	int num_proc=4;
+	unsigned profondita=PROFONDITA;
+	const char *modi="tutte";
+	bool liberi=false;
+	double t;
+	int opt;
+
+	while((opt=getopt(argc, argv, "n:p:r:s:0"))!=-1){
+		switch(opt){
+			case 'n': n=atol(optarg); break;
+			case 'p': num_proc=atoi(optarg); break;
+			case 'r': profondita=atoi(optarg); break;
+			case 's': modi=optarg; break;
+			case '0': liberi=true; break;
+			default:
+				fprintf(stderr, "Uso: bench_ring [-n operazioni] [-p processi] [-r profondita] [-s sysv|futex|tutte] [-0]\n");
+				exit(1);
+		}
+	}
+	if(n<1 || num_proc<1 || profondita<1 || (profondita&(profondita-1))){
+		fprintf(stderr, "Parametri non validi (la profondita' deve essere una potenza di 2)\n");
+		exit(1);
+	}
+
+	t=bench_mailbox(n, num_proc);
+	printf("protocollo=mailbox sync=sysv processi=%d profondita=1 operazioni=%ld secondi=%.3f op_al_secondo=%.0f\n", num_proc, n, t, n/t);
+	fflush(stdout);
+	if(strcmp(modi, "futex")!=0){
+		t=bench_code(n, num_proc, profondita, SYNC_SYSV, liberi);
+		printf("protocollo=ring sync=sysv id0=%d processi=%d profondita=%u operazioni=%ld secondi=%.3f op_al_secondo=%.0f\n", liberi, num_proc, profondita, n, t, n/t);
+		fflush(stdout);
+	}
+	if(strcmp(modi, "sysv")!=0){
+		t=bench_code(n, num_proc, profondita, SYNC_FUTEX, liberi);
+		printf("protocollo=ring sync=futex id0=%d processi=%d profondita=%u operazioni=%ld secondi=%.3f op_al_secondo=%.0f\n", liberi, num_proc, profondita, n, t, n/t);
+	}
+	return 0;
+}
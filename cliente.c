@@ -0,0 +1,96 @@
+/**
+ * @file cliente.c
+ * @author Marco Colognese
+*/
+
+#include "mylib.h"
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/**
+ * @brief Client del servizio (father -D): invia un file di operazioni sul socket e scrive i risultati su STDOUT.
+ *
+ *	Il file (o lo standard input) viene inviato cosi' com'e', nel formato di testo o binario;
+ *	la prima riga con il numero di processi puo' esserci o mancare. Le operazioni vengono
+ *	inviate e i risultati letti insieme, con poll(), cosi' ne' il client ne' il servizio si
+ *	bloccano per un flusso lungo. A fine file il client chiude il socket in scrittura e attende
+ *	gli ultimi risultati.
+ *
+ *	Uso: cliente socket [file|-]
+*/
+
+///Messaggio di uso del programma
+static const char uso[]="Uso: cliente socket [file|-]\n";
+
+int main(int argc, char *argv[]){
+	struct sockaddr_un ind;
+	struct pollfd pf[2];
+	char ingresso[PARSER_BLOCCO];	//byte letti dal file e non ancora inviati
+	char uscita[PARSER_BLOCCO];	//risultati ricevuti
+	size_t pos=0, len=0;
+	ssize_t r;
+	int sock, fd=STDIN;
+	bool fine_file=false;
+
+	if(argc<2 || argc>3){
+		write(STDOUT, uso, strlen(uso));
+		exit(1);
+	}
+	if(argc==3 && strcmp(argv[2], "-")!=0 && (fd=open(argv[2], O_RDONLY))==-1){
+		write(STDERR, "Errore in apertura del file\n", strlen("Errore in apertura del file\n"));
+		exit(1);
+	}
+	memset(&ind, 0, sizeof(ind));
+	ind.sun_family=AF_UNIX;
+	strncpy(ind.sun_path, argv[1], sizeof(ind.sun_path)-1);
+	if((sock=socket(AF_UNIX, SOCK_STREAM, 0))==-1 || connect(sock, (struct sockaddr *)&ind, sizeof(ind))==-1){
+		write(STDERR, "Connessione al servizio non riuscita\n", strlen("Connessione al servizio non riuscita\n"));
+		exit(1);
+	}
+
+	for(;;){
+		//si legge un nuovo blocco dal file solo quando il precedente e' stato inviato tutto
+		pf[0].fd=(pos<len) ? sock : (fine_file ? -1 : fd);
+		pf[0].events=(pos<len) ? POLLOUT : POLLIN;
+		pf[1].fd=sock;
+		pf[1].events=POLLIN;
+		if(poll(pf, 2, -1)==-1){
+			if(errno==EINTR)
+				continue;
+			break;
+		}
+
+		if(pf[0].revents){
+			if(pos<len){
+				if((r=write(sock, ingresso+pos, len-pos))==-1){
+					write(STDERR, "Errore in invio delle operazioni\n", strlen("Errore in invio delle operazioni\n"));
+					exit(1);
+				}
+				pos+=r;
+			}
+			else if((r=read(fd, ingresso, sizeof(ingresso)))>0){
+				pos=0;
+				len=r;
+			}
+			else{
+				//fine del file: il servizio invia gli ultimi risultati e chiude
+				fine_file=true;
+				shutdown(sock, SHUT_WR);
+			}
+		}
+
+		if(pf[1].revents){
+			if((r=read(sock, uscita, sizeof(uscita)))<=0)
+				break;
+			write(STDOUT, uscita, r);
+		}
+	}
+	close(sock);
+	exit(fine_file ? 0 : 1);
+}
@@ -0,0 +1,225 @@
+/**
+ * @file convertitore.c
+ * @author Marco Colognese
+*/
+
+#include "mylib.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * @brief Programma che converte i file di operazioni e di risultati tra il formato di testo e quello binario.
+ *
+ *	Un file di operazioni di testo (come file.txt) viene convertito nel formato binario, con le
+ *	direttive #costo nella tabella dei costi dell'intestazione; un file di operazioni binario
+ *	viene riconvertito in testo. Il verso si ricava dall'intestazione del file. Con -r il file
+ *	in ingresso e' un file di risultati binario (scritto da father -B), che viene convertito
+ *	nel formato di testo di Risultati.txt.
+ *
+ *	Uso: convertitore [-r] ingresso|- uscita|-
+*/
+
+///Messaggio di uso del programma
+static const char uso[]="Uso: convertitore [-r] ingresso|- uscita|-\n";
+
+/**
+ * @brief Funzione che converte un file di operazioni, dal testo al binario o viceversa.
+ *
+ * @param nome		nome del file in ingresso ("-" = STDIN)
+ * @param u		scrittore del file in uscita
+ * @return		0 in caso di successo, -1 in caso di errore
+*/
+
+static int converti_lavori(const char *nome, uscita *u){
+	intestazione_lavori t;
+	modello_costo costi;
+	record_lavoro b;
+	char riga[4*BUFLEN+64];
+	char *s;
+	parser p;
+	lavoro l;
+	int i, r;
+
+	if(parser_apri(&p, nome)==-1){
+		write(STDOUT, "Errore in apertura del file\n", strlen("Errore in apertura del file\n"));
+		return -1;
+	}
+	costo_init(&costi, COSTO_PREDEFINITO);
+	p.costi=&costi;
+	if(parser_intestazione(&p)<1){
+		write(STDOUT, "Intestazione del file non valida\n", strlen("Intestazione del file non valida\n"));
+		parser_chiudi(&p);
+		return -1;
+	}
+
+	if(p.binario){
+		//binario -> testo: numero di processi, direttive di costo e una riga per operazione
+		s=riga+scrivi_intero(riga, p.num_proc);
+		*s++='\n';
+		uscita_scrivi(u, riga, s-riga);
+		for(i=0; i<4; i++){
+			costo_scrivi(&costi, i, riga);
+			uscita_scrivi(u, riga, strlen(riga));
+		}
+	}
+	else{
+		//testo -> binario: intestazione con la tabella dei costi e un record per operazione
+		memset(&t, 0, sizeof(t));
+		memcpy(t.magia, MAGIA_LAVORI, 4);
+		t.versione=FORMATO_VERSIONE;
+		t.dim_record=sizeof(record_lavoro);
+		t.num_proc=p.num_proc;
+		t.con_costi=1;
+		for(i=0; i<4; i++){
+			t.costi[i].tipo=costi.op[i].tipo;
+			t.costi[i].a=costi.op[i].a;
+			t.costi[i].b=costi.op[i].b;
+		}
+		uscita_scrivi(u, (const char *)&t, sizeof(t));
+	}
+
+	memset(&b, 0, sizeof(b));
+	while((r=parser_prossimo(&p, &l))==1){
+		//il parser restituisce i riferimenti come distanza: nel file si scrive il numero N dell'operazione
+		if(l.rif&RIF_VAL1)
+			l.val1=p.lavori-l.val1;
+		if(l.rif&RIF_VAL2)
+			l.val2=p.lavori-l.val2;
+		if(p.binario){
+			s=riga+scrivi_intero(riga, l.id);
+			*s++=' ';
+			if(l.rif&RIF_VAL1)
+				*s++='$';
+			s+=scrivi_intero(s, l.val1);
+			*s++=' ';
+			*s++=l.op;
+			*s++=' ';
+			if(l.rif&RIF_VAL2)
+				*s++='$';
+			s+=scrivi_intero(s, l.val2);
+			*s++='\n';
+			uscita_scrivi(u, riga, s-riga);
+		}
+		else{
+			b.id=l.id;
+			b.val1=l.val1;
+			b.val2=l.val2;
+			b.op=l.op;
+			b.rif=l.rif;
+			uscita_scrivi(u, (const char *)&b, sizeof(b));
+		}
+	}
+	parser_chiudi(&p);
+	return (r==-1 || p.errori>0) ? -1 : 0;
+}
+
+/**
+ * @brief Funzione che legge esattamente n byte dal file descriptor fd.
+ *
+ * @return		n se i byte sono stati letti, meno di n a fine file, -1 in caso di errore
+*/
+
+static ssize_t leggi_tutto(int fd, void *buf, size_t n){
+	size_t fatti=0;
+	ssize_t r;
+
+	while(fatti<n){
+		r=read(fd, (char *)buf+fatti, n-fatti);
+		if(r==-1 && errno==EINTR)
+			continue;
+		if(r==-1)
+			return -1;
+		if(r==0)
+			break;
+		fatti+=r;
+	}
+	return fatti;
+}
+
+/**
+ * @brief Funzione che converte un file di risultati binario nel formato di testo.
+ *
+ * @param nome		nome del file in ingresso ("-" = STDIN)
+ * @param u		scrittore del file in uscita (di testo)
+ * @return		0 in caso di successo, -1 in caso di errore
+*/
+
+static int converti_risultati(const char *nome, uscita *u){
+	intestazione_risultati t;
+	record_risultato b[256];
+	risultato r;
+	ssize_t n;
+	int fd, i, esito=0;
+
+	if((fd=(strcmp(nome, "-")==0) ? STDIN : open(nome, O_RDONLY))==-1){
+		write(STDOUT, "Errore in apertura del file\n", strlen("Errore in apertura del file\n"));
+		return -1;
+	}
+	if(leggi_tutto(fd, &t, sizeof(t))!=sizeof(t) || memcmp(t.magia, MAGIA_RISULTATI, 4)!=0 || t.versione!=FORMATO_VERSIONE || t.dim_record!=sizeof(record_risultato)){
+		write(STDOUT, "Il file non e' un file di risultati binario valido\n", strlen("Il file non e' un file di risultati binario valido\n"));
+		esito=-1;
+	}
+	memset(&r, 0, sizeof(r));
+	while(esito==0 && (n=leggi_tutto(fd, b, sizeof(b)))>0){
+		for(i=0; i<n/(ssize_t)sizeof(record_risultato); i++){
+			r.val1=b[i].val1;
+			r.op=b[i].op;
+			r.val2=b[i].val2;
+			r.res=b[i].res;
+			uscita_risultato(u, &r);
+		}
+		if(n%sizeof(record_risultato)!=0){
+			write(STDOUT, "Record incompleto alla fine del file\n", strlen("Record incompleto alla fine del file\n"));
+			esito=-1;
+		}
+	}
+	if(n==-1)
+		esito=-1;
+	if(fd!=STDIN)
+		close(fd);
+	return esito;
+}
+
+int main(int argc, char *argv[]){
+	bool risultati=false;
+	uscita u;
+	int opt, fd, esito;
+
+	while((opt=getopt(argc, argv, "r"))!=-1){
+		switch(opt){
+			case 'r':
+				risultati=true;
+				break;
+			default:
+				write(STDOUT, uso, strlen(uso));
+				exit(1);
+		}
+	}
+	if(argc-optind!=2){
+		write(STDOUT, uso, strlen(uso));
+		exit(1);
+	}
+
+	//con l'uscita sullo standard output, i messaggi vanno sullo standard error
+	if(strcmp(argv[optind+1], "-")==0){
+		fd=dup(STDOUT);
+		dup2(STDERR, STDOUT);
+	}
+	else if((fd=creat(argv[optind+1], 0666))==-1){
+		write(STDOUT, "Errore in creazione del file\n", strlen("Errore in creazione del file\n"));
+		exit(1);
+	}
+	if(uscita_apri(&u, fd, false, false)==-1){
+		write(STDOUT, "Allocazione del buffer fallita\n", strlen("Allocazione del buffer fallita\n"));
+		exit(1);
+	}
+
+	esito=risultati ? converti_risultati(argv[optind], &u) : converti_lavori(argv[optind], &u);
+	if(uscita_chiudi(&u)==-1)
+		esito=-1;
+	exit(esito==0 ? 0 : 1);
+}
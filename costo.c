@@ -0,0 +1,239 @@
+/**
+ * @file costo.c
+ * @author Marco Colognese
+*/
+
+#include "mylib.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+
+///Nomi dei tipi di costo, nell'ordine delle costanti COSTO_*
+static const char *nomi[]={"zero", "fisso", "uniforme", "esponenziale"};
+
+/**
+ * @brief Funzione che restituisce la posizione dell'operatore nell'array dei costi.
+ *
+ * @param op		operatore ('+', '-', '*', '/')
+ * @return		indice da 0 a 3, -1 se l'operatore non e' valido
+*/
+
+int costo_indice(char op){
+	switch(op){
+		case '+': return 0;
+		case '-': return 1;
+		case '*': return 2;
+		case '/': return 3;
+		default: return -1;
+	}
+}
+
+/**
+ * @brief Funzione che assegna a tutti gli operatori lo stesso costo fisso.
+ *
+ * @param m		modello di costo
+ * @param ns		costo di ogni operazione in nanosecondi (0 = nessun costo)
+*/
+
+void costo_init(modello_costo *m, long long ns){
+	int i;
+
+	for(i=0; i<4; i++){
+		m->op[i].tipo=(ns>0) ? COSTO_FISSO : COSTO_ZERO;
+		m->op[i].a=ns;
+		m->op[i].b=0;
+	}
+	m->reale=false;
+}
+
+/**
+ * @brief Funzione che imposta il costo di uno o di tutti gli operatori.
+ *
+ * @param m		modello di costo
+ * @param op		operatore, oppure 0 per tutti gli operatori
+ * @param c		costo da assegnare
+*/
+
+static void assegna(modello_costo *m, char op, costo_op c){
+	int i;
+
+	if(op!=0){
+		m->op[costo_indice(op)]=c;
+		return;
+	}
+	for(i=0; i<4; i++)
+		m->op[i]=c;
+}
+
+/**
+ * @brief Funzione che interpreta il costo passato con l'opzione -c.
+ *
+ *	Sono accettati: "zero", un numero di nanosecondi per tutti gli operatori, oppure un elenco
+ *	separato da virgole di coppie <op>=<ns> (ad esempio "+=100,-=100,*=300,/=2000").
+ *
+ * @param m		modello di costo
+ * @param spec		stringa passata sulla riga di comando
+ * @return		0 in caso di successo, -1 se la stringa non e' valida
+*/
+
+int costo_imposta(modello_costo *m, const char *spec){
+	costo_op c={COSTO_FISSO, 0, 0};
+	char *fine;
+
+	if(strcmp(spec, "zero")==0){
+		costo_init(m, 0);
+		return 0;
+	}
+	if(spec[0]>='0' && spec[0]<='9'){
+		c.a=strtoll(spec, &fine, 10);
+		if(*fine!='\0')
+			return -1;
+		costo_init(m, c.a);
+		return 0;
+	}
+	while(*spec!='\0'){
+		if(costo_indice(spec[0])==-1 || spec[1]!='=')
+			return -1;
+		errno=0;
+		c.a=strtoll(spec+2, &fine, 10);
+		if(fine==spec+2 || errno!=0 || c.a<0 || (*fine!=',' && *fine!='\0'))
+			return -1;
+		c.tipo=(c.a>0) ? COSTO_FISSO : COSTO_ZERO;
+		assegna(m, spec[0], c);
+		spec=(*fine==',') ? fine+1 : fine;
+	}
+	return 0;
+}
+
+/**
+ * @brief Funzione che interpreta una direttiva di costo del file di configurazione.
+ *
+ *	Formato: "#costo <op|tutte> zero", "#costo <op|tutte> fisso <ns>",
+ *	"#costo <op|tutte> uniforme <min> <max>", "#costo <op|tutte> esponenziale <media>".
+ *
+ * @param m		modello di costo
+ * @param s		inizio della riga
+ * @param fine		fine della riga
+ * @return		0 in caso di successo, -1 se la direttiva non e' valida
+*/
+
+int costo_direttiva(modello_costo *m, const char *s, const char *fine){
+	char riga[128], op[16], tipo[16];
+	costo_op c={COSTO_ZERO, 0, 0};
+	int n, i;
+
+	if(fine-s>=(long)sizeof(riga))
+		return -1;
+	memcpy(riga, s, fine-s);
+	riga[fine-s]='\0';
+	n=sscanf(riga, "#costo %15s %15s %lld %lld", op, tipo, &c.a, &c.b);
+	if(n<2 || (strcmp(op, "tutte")!=0 && (op[1]!='\0' || costo_indice(op[0])==-1)))
+		return -1;
+	for(i=0; i<4; i++)
+		if(strcmp(tipo, nomi[i])==0)
+			c.tipo=i;
+	if(strcmp(tipo, nomi[c.tipo])!=0 || c.a<0 || c.b<0)
+		return -1;
+	if((c.tipo==COSTO_ZERO && n!=2) || (c.tipo==COSTO_FISSO && n!=3) || (c.tipo==COSTO_ESPONENZIALE && n!=3))
+		return -1;
+	if(c.tipo==COSTO_UNIFORME && (n!=4 || c.b<c.a))
+		return -1;
+	assegna(m, (op[1]=='\0') ? op[0] : 0, c);
+	return 0;
+}
+
+/**
+ * @brief Funzione che estrae il costo di un'operazione secondo il modello.
+ *
+ *	I numeri casuali sono generati con uno xorshift il cui stato e' privato di ciascun figlio.
+ *
+ * @param m		modello di costo
+ * @param op		operatore
+ * @param seme		stato del generatore di numeri casuali del figlio (diverso da 0)
+ * @return		costo dell'operazione in nanosecondi
+*/
+
+long long costo_campiona(const modello_costo *m, char op, unsigned long long *seme){
+	const costo_op *c;
+	unsigned long long x;
+	int i=costo_indice(op);
+
+	if(i==-1)
+		return 0;
+	c=&m->op[i];
+	if(c->tipo==COSTO_ZERO || c->tipo==COSTO_FISSO)
+		return c->a;
+
+	x=*seme;
+	x^=x<<13;
+	x^=x>>7;
+	x^=x<<17;
+	*seme=x;
+	if(c->tipo==COSTO_UNIFORME)
+		return c->a+(long long)(x%(unsigned long long)(c->b-c->a+1));
+	//esponenziale: -media*ln(u), con u in (0,1]
+	return (long long)(-(double)c->a*log(((x>>11)+1)*(1.0/9007199254740992.0)));
+}
+
+/**
+ * @brief Funzione che attende davvero il costo di un'operazione (opzione -R).
+ *
+ * @param ns		nanosecondi da attendere
+*/
+
+void costo_attendi(long long ns){
+	struct timespec t;
+
+	t.tv_sec=ns/1000000000LL;
+	t.tv_nsec=ns%1000000000LL;
+	while(nanosleep(&t, &t)==-1 && errno==EINTR)
+		;
+}
+
+/**
+ * @brief Funzione che descrive il modello di costo su una riga, per le stampe del padre.
+ *
+ * @param m		modello di costo
+ * @param s		stringa in cui scrivere la descrizione (almeno 256 caratteri)
+*/
+
+void costo_descrivi(const modello_costo *m, char s[]){
+	static const char operatori[4]={'+', '-', '*', '/'};
+	int i, n=0;
+
+	for(i=0; i<4; i++){
+		n+=sprintf(s+n, "%c:%s", operatori[i], nomi[m->op[i].tipo]);
+		if(m->op[i].tipo!=COSTO_ZERO)
+			n+=sprintf(s+n, "(%lld", m->op[i].a);
+		if(m->op[i].tipo==COSTO_UNIFORME)
+			n+=sprintf(s+n, ",%lld", m->op[i].b);
+		if(m->op[i].tipo!=COSTO_ZERO)
+			n+=sprintf(s+n, ")");
+		n+=sprintf(s+n, (i<3) ? " " : "");
+	}
+	sprintf(s+n, "%s", m->reale ? " reale" : " simulato");
+}
+
+/**
+ * @brief Funzione che scrive la direttiva #costo che descrive il costo dell'operatore i (usata dal convertitore).
+ *
+ * @param m		modello di costo
+ * @param i		indice dell'operatore (vedi costo_indice())
+ * @param s		stringa in cui scrivere la direttiva, con '\n' finale (almeno 64 caratteri)
+*/
+
+void costo_scrivi(const modello_costo *m, int i, char s[]){
+	static const char operatori[4]={'+', '-', '*', '/'};
+	const costo_op *c=&m->op[i];
+	int n;
+
+	n=sprintf(s, "#costo %c %s", operatori[i], nomi[c->tipo]);
+	if(c->tipo!=COSTO_ZERO)
+		n+=sprintf(s+n, " %lld", c->a);
+	if(c->tipo==COSTO_UNIFORME)
+		n+=sprintf(s+n, " %lld", c->b);
+	sprintf(s+n, "\n");
+}
@@ -0,0 +1,822 @@
+/**
+ * @file dispatcher.c
+ * @author Marco Colognese
+*/
+
+#include "mylib.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+static void invia_pronte(dispatcher *d);
+
+/**
+ * @brief Funzione che inizializza lo stato del padre per la distribuzione delle operazioni.
+ *
+ *	Tutta la memoria del distributore dipende solo dalla finestra e da NUM_PROC: un deposito di
+ *	finestra operazioni in attesa (con una lista per figlio e una per ogni operazione di cui
+ *	qualcuna attende il risultato) e un buffer di riordino di finestra risultati.
+ *
+ * @param d		distributore
+ * @param a		regione condivisa con i figli
+ * @param finestra	numero massimo di operazioni lette e non ancora consegnate
+ * @param consegna	funzione chiamata per ogni risultato, nell'ordine delle operazioni
+ * @param ctx		argomento passato a consegna
+*/
+
+void disp_init(dispatcher *d, arena *a, unsigned finestra, void (*consegna)(void *ctx, const risultato *r), void *ctx){
+	unsigned i;
+	int j;
+
+	memset(d, 0, sizeof(dispatcher));
+	d->a=a;
+	d->in_volo=(unsigned *)calloc(a->num_proc, sizeof(unsigned));
+	d->verboso=true;
+	d->consegna=consegna;
+	d->ctx=ctx;
+
+	d->finestra=finestra;
+	d->ordine=(risultato *)malloc(finestra*sizeof(risultato));
+	d->pronto=(bool *)calloc(finestra, sizeof(bool));
+	d->deposito=(lavoro *)malloc(finestra*sizeof(lavoro));
+	d->succ=(int *)malloc(finestra*sizeof(int));
+	d->att_testa=(int *)malloc(a->num_proc*sizeof(int));
+	d->att_coda=(int *)malloc(a->num_proc*sizeof(int));
+	d->t_letto=(unsigned long long *)malloc(finestra*sizeof(unsigned long long));
+	d->attivo=(bool *)malloc(a->num_proc*sizeof(bool));
+	d->dove=(int *)calloc(finestra, sizeof(int));
+	d->dip_testa=(int *)malloc(finestra*sizeof(int));
+	if(d->in_volo==NULL || d->ordine==NULL || d->pronto==NULL || d->deposito==NULL || d->succ==NULL || d->att_testa==NULL || d->att_coda==NULL || d->t_letto==NULL || d->attivo==NULL || d->dove==NULL || d->dip_testa==NULL){
+		write(STDOUT, "Allocazione del distributore fallita\n", strlen("Allocazione del distributore fallita\n"));
+		exit(1);
+	}
+	//lista dei posti liberi del deposito
+	for(i=0; i<finestra; i++){
+		d->succ[i]=(i+1<finestra) ? (int)i+1 : -1;
+		d->dip_testa[i]=-1;
+	}
+	d->posto_libero=0;
+	d->pronte_testa=d->pronte_coda=-1;
+	for(j=0; j<a->num_proc; j++){
+		d->att_testa[j]=d->att_coda[j]=-1;
+		d->attivo[j]=true;
+	}
+	d->attivi=d->minimo=a->num_proc;
+}
+
+/**
+ * @brief Funzione che rende elastico l'insieme dei figli: solo i primi minimo sono avviati.
+ *
+ *	Gli altri slot della regione restano vuoti finche' servono: un figlio viene avviato quando
+ *	arriva un'operazione con il suo id (cosi' ogni id corrisponde sempre allo stesso slot e alla
+ *	stessa coda) oppure quando soglia operazioni con id 0 di fila hanno trovato tutti i figli
+ *	occupati. I figli oltre il minimo che restano senza lavoro per timeout nanosecondi vengono
+ *	ritirati con il comando 'K'. Va chiamata dopo aver avviato i figli da 1 a minimo.
+ *
+ * @param d		distributore
+ * @param minimo	numero di figli sempre avviati (da 1 a NUM_PROC)
+ * @param timeout	tempo senza lavoro dopo cui un figlio oltre il minimo viene ritirato, in nanosecondi
+ * @param soglia	operazioni con id 0 inviate a figli occupati prima di avviare un nuovo figlio
+ * @param avvia		funzione che avvia il figlio j+1 (lo slot j e' vuoto o il suo figlio e' terminato)
+ * @param ctx		argomento passato ad avvia
+*/
+
+void disp_elastico(dispatcher *d, int minimo, unsigned long long timeout, unsigned soglia, void (*avvia)(void *ctx, int j), void *ctx){
+	int j;
+
+	d->avvia=avvia;
+	d->ctx_avvia=ctx;
+	d->minimo=d->attivi=minimo;
+	d->timeout=timeout;
+	d->soglia=(soglia>0) ? soglia : 1;
+	for(j=0; j<d->a->num_proc; j++){
+		d->attivo[j]=(j<minimo);
+		//gli slot vuoti non devono risultare liberi nella bitmap
+		if(j>=minimo)
+			arena_occupa(d->a, j);
+	}
+}
+
+/**
+ * @brief Funzione che fa ripartire la numerazione delle operazioni da consegnati, come se le prime consegnati fossero gia' state consegnate.
+ *
+ *	Serve per riprendere una simulazione interrotta (vedi ripresa.c): i numeri d'ordine restano
+ *	quelli del file, cosi' i riferimenti $N alle operazioni gia' svolte si risolvono con i
+ *	risultati salvati, che il chiamante scrive nella tabella dei valori. Va chiamata prima di
+ *	inviare qualunque operazione.
+ *
+ * @param d		distributore
+ * @param consegnati	numero di operazioni gia' svolte
+*/
+
+void disp_riprendi(dispatcher *d, unsigned long long consegnati){
+	d->inviati=d->consegnati=consegnati;
+}
+
+/**
+ * @brief Funzione che libera lo stato del distributore.
+ *
+ * @param d		distributore
+*/
+
+void disp_chiudi(dispatcher *d){
+	free(d->in_volo);
+	free(d->ordine);
+	free(d->pronto);
+	free(d->deposito);
+	free(d->succ);
+	free(d->att_testa);
+	free(d->att_coda);
+	free(d->t_letto);
+	free(d->attivo);
+	free(d->dove);
+	free(d->dip_testa);
+	d->in_volo=NULL;
+}
+
+/**
+ * @brief Funzione che inserisce un'operazione nella coda del figlio j+1 e lo sveglia.
+ *
+ *	Va chiamata solo se il figlio ha ancora spazio (in_volo minore della profondita').
+ *
+ * @param d		distributore
+ * @param j		indice del figlio
+ * @param l		operazione da inviare
+*/
+
+static void accoda(dispatcher *d, int j, const lavoro *l){
+	arena *a=d->a;
+
+	ring_inserisci(&a->slot[j].richieste, l);
+	isto_aggiungi(&d->inoltro, orologio_ns()-d->t_letto[l->seq%d->finestra]);
+	d->dove[l->seq%d->finestra]=j+1;
+	arena_occupa(a, j);
+	d->in_volo[j]++;
+	attesa_sveglia(&a->slot[j].attesa);
+}
+
+/**
+ * @brief Funzione che mette da parte un'operazione per il figlio j+1, la cui coda e' piena.
+ *
+ * @param d		distributore
+ * @param j		indice del figlio
+ * @param l		operazione da mettere da parte
+*/
+
+static void parcheggia(dispatcher *d, int j, const lavoro *l){
+	int k=d->posto_libero;
+
+	//la finestra limita le operazioni non consegnate, quindi il deposito non e' mai pieno
+	d->posto_libero=d->succ[k];
+	d->parcheggiate++;
+	TRACCIA(d->a, 0, TR_PARCHEGGIO, 0, j+1);
+	d->deposito[k]=*l;
+	d->succ[k]=-1;
+	d->dove[l->seq%d->finestra]=j+1;
+	if(d->att_coda[j]==-1)
+		d->att_testa[j]=k;
+	else
+		d->succ[d->att_coda[j]]=k;
+	d->att_coda[j]=k;
+}
+
+/**
+ * @brief Funzione che sposta nella coda del figlio j+1 le operazioni messe da parte, finche' c'e' spazio.
+ *
+ * @param d		distributore
+ * @param j		indice del figlio
+*/
+
+static void sblocca(dispatcher *d, int j){
+	int k;
+
+	while((k=d->att_testa[j])!=-1 && d->in_volo[j]<d->a->profondita){
+		accoda(d, j, &d->deposito[k]);
+		d->att_testa[j]=d->succ[k];
+		if(d->att_testa[j]==-1)
+			d->att_coda[j]=-1;
+		d->succ[k]=d->posto_libero;
+		d->posto_libero=k;
+	}
+}
+
+/**
+ * @brief Funzione che consegna, nell'ordine delle operazioni, i risultati gia' arrivati.
+ *
+ * @param d		distributore
+*/
+
+static void consegna_in_ordine(dispatcher *d){
+	unsigned long long ora=orologio_ns();
+	unsigned k;
+
+	while(d->pronto[k=d->consegnati%d->finestra]){
+		d->pronto[k]=false;
+		isto_aggiungi(&d->completamento, ora-d->t_letto[k]);
+		d->consegna(d->ctx, &d->ordine[k]);
+		d->consegnati++;
+	}
+}
+
+/**
+ * @brief Funzione che controlla i riferimenti di un'operazione prima di numerarla: l'operazione riferita deve essere ancora nella tabella dei valori.
+ *
+ *	La tabella dei valori conserva i risultati delle ultime 2*finestra operazioni: il parser (con
+ *	parser->portata) e il servizio scartano i riferimenti piu' lontani prima dell'invio. Se ne
+ *	arriva comunque uno l'operazione viene rifiutata, come fa il parser: il suo risultato non
+ *	si puo' calcolare.
+ *
+ * @param d		distributore
+ * @param l		operazione, che avra' numero d'ordine d->inviati
+ * @return		0 se i riferimenti si possono risolvere, -1 altrimenti
+*/
+
+static int controlla_riferimenti(dispatcher *d, const lavoro *l){
+	char stampa[256];	//array di char per le stampe di sprintf
+	const int *op[2]={&l->val1, &l->val2};
+	unsigned distanza;
+	int k;
+
+	for(k=0; k<2; k++){
+		if(!(l->rif&(RIF_VAL1<<k)))
+			continue;
+		distanza=(unsigned)*op[k];
+		if(distanza==0 || distanza>d->inviati || distanza>=d->a->num_valori){
+			sprintf(stampa, "Riga %d: riferimento oltre la tabella dei valori, operazione rifiutata\n", l->riga);
+			write(STDOUT, stampa, strlen(stampa));
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief Funzione che sostituisce negli operandi i risultati gia' calcolati e sceglie il figlio a cui l'operazione puo' andare.
+ *
+ *	I risultati si leggono dalla tabella dei valori della regione, in cui li scrive il figlio che
+ *	li calcola, anche prima che il padre li abbia prelevati. Un riferimento ancora aperto non
+ *	impedisce l'invio se l'operazione riferita e' nella coda (o tra le operazioni messe da parte)
+ *	dello stesso figlio: il figlio le svolge in ordine e legge da solo il risultato dalla tabella,
+ *	senza passare dal padre. Per questo un'operazione con id 0 segue quella da cui dipende (tranne
+ *	con il furto di lavoro, in cui va nelle code condivise).
+ *
+ * @param d		distributore
+ * @param l		operazione, con i riferimenti gia' controllati
+ * @param attesa	numero d'ordine di un'operazione di cui si attende il risultato (se restituisce -1)
+ * @return		numero del figlio a cui inviarla (0 = figlio libero), -1 se deve attendere
+*/
+
+static int risolvi(dispatcher *d, lavoro *l, unsigned long long *attesa){
+	int *op[2]={&l->val1, &l->val2};
+	unsigned long long rif;	//numero d'ordine dell'operazione riferita
+	int k, v, w, figlio=l->id;
+	bool attende=false;
+
+	for(k=0; k<2; k++){
+		if(!(l->rif&(RIF_VAL1<<k)))
+			continue;
+		rif=l->seq-(unsigned)*op[k];
+		if(arena_valore(d->a, rif, &v)){
+			*op[k]=v;
+			l->rif&=~(RIF_VAL1<<k);
+			continue;
+		}
+		*attesa=rif;
+		w=d->dove[*attesa%d->finestra];
+		if(w==0 || (l->id==0 && d->furto) || (figlio!=0 && figlio!=w))
+			attende=true;
+		else
+			figlio=w;
+	}
+	return attende ? -1 : figlio;
+}
+
+/**
+ * @brief Funzione che mette da parte un'operazione finche' non e' pronto il risultato dell'operazione seq.
+ *
+ * @param d		distributore
+ * @param l		operazione
+ * @param seq		numero d'ordine dell'operazione di cui si attende il risultato
+*/
+
+static void attendi_risultato(dispatcher *d, const lavoro *l, unsigned long long seq){
+	char stampa[256];	//array di char per le stampe di sprintf
+	int k=d->posto_libero;
+
+	d->posto_libero=d->succ[k];
+	d->deposito[k]=*l;
+	d->succ[k]=d->dip_testa[seq%d->finestra];
+	d->dip_testa[seq%d->finestra]=k;
+	if(d->verboso){
+		sprintf(stampa, "\tPADRE: il calcolo della riga %d attende il risultato dell'operazione %llu\n", l->riga, seq+1);
+		write(STDOUT, stampa, strlen(stampa));
+	}
+}
+
+/**
+ * @brief Funzione che rende pronte le operazioni che attendevano il risultato dell'operazione seq, appena prelevato.
+ *
+ *	La lista dell'operazione e' in ordine inverso di arrivo: viene rovesciata e aggiunta in fondo
+ *	alle operazioni pronte, cosi' ripartono nell'ordine in cui sono state lette.
+ *
+ * @param d		distributore
+ * @param seq		numero d'ordine dell'operazione
+*/
+
+static void libera_dipendenti(dispatcher *d, unsigned long long seq){
+	int *testa=&d->dip_testa[seq%d->finestra];
+	int k, prima=-1, ultima=*testa;
+
+	while((k=*testa)!=-1){
+		*testa=d->succ[k];
+		d->succ[k]=prima;
+		prima=k;
+	}
+	if(d->pronte_coda==-1)
+		d->pronte_testa=prima;
+	else
+		d->succ[d->pronte_coda]=prima;
+	d->pronte_coda=ultima;
+}
+
+/**
+ * @brief Funzione che avvia il figlio j+1 in uno slot vuoto.
+ *
+ * @param d		distributore
+ * @param j		indice del figlio
+*/
+
+static void avvia_figlio(dispatcher *d, int j){
+	char stampa[256];	//array di char per le stampe di sprintf
+
+	//il figlio appena avviato non deve essere ritirato prima di aver ricevuto lavoro
+	d->a->slot[j].stat.ns_ultimo=orologio_ns();
+	d->avvia(d->ctx_avvia, j);
+	d->attivo[j]=true;
+	d->attivi++;
+	d->avvii++;
+	arena_libera(d->a, j);
+	if(d->verboso){
+		sprintf(stampa, "\tPADRE: avvio il figlio %d (%d figli attivi)\n", j+1, d->attivi);
+		write(STDOUT, stampa, strlen(stampa));
+	}
+}
+
+/**
+ * @brief Funzione che avvia un figlio in piu', se l'insieme e' elastico e non ha raggiunto NUM_PROC.
+ *
+ * @param d		distributore
+ * @return		indice del figlio avviato, -1 se non e' possibile
+*/
+
+static int cresci(dispatcher *d){
+	int j;
+
+	d->arretrato=0;
+	if(d->avvia==NULL || d->attivi==d->a->num_proc)
+		return -1;
+	for(j=0; d->attivo[j]; j++)
+		;
+	avvia_figlio(d, j);
+	return j;
+}
+
+/**
+ * @brief Funzione che cerca un figlio avviato e libero nella bitmap, partendo dall'indice da.
+ *
+ *	Un figlio ritirato puo' aver acceso il proprio bit poco prima di ricevere il 'K': il bit
+ *	viene spento e la ricerca ripetuta.
+ *
+ * @param d		distributore
+ * @param da		indice da cui iniziare la ricerca, circolarmente
+ * @return		indice del figlio libero, -1 se sono tutti occupati
+*/
+
+static int libero_attivo(dispatcher *d, int da){
+	int j;
+
+	while((j=arena_cerca_libero(d->a, da))!=-1 && !d->attivo[j])
+		arena_occupa(d->a, j);
+	return j;
+}
+
+/**
+ * @brief Funzione che restituisce il primo figlio avviato a partire dall'indice j, circolarmente.
+ *
+ * @param d		distributore
+ * @param j		indice da cui partire
+ * @return		indice del figlio
+*/
+
+static int attivo_da(dispatcher *d, int j){
+	while(!d->attivo[j])
+		j=(j+1==d->a->num_proc) ? 0 : j+1;
+	return j;
+}
+
+/**
+ * @brief Funzione che ritira i figli oltre il minimo rimasti senza lavoro per piu' del timeout.
+ *
+ *	Un figlio si puo' ritirare solo se il padre non gli ha lasciato nulla: nessuna operazione in
+ *	coda o messa da parte e la sua coda condivisa vuota. Il controllo si ripete al piu' ogni
+ *	quarto di timeout.
+ *
+ * @param d		distributore
+*/
+
+static void ritira_inattivi(dispatcher *d){
+	arena *a=d->a;
+	char stampa[256];	//array di char per le stampe di sprintf
+	unsigned long long ora=orologio_ns();
+	lavoro k;
+	int j;
+
+	if(ora<d->prossimo_controllo)
+		return;
+	d->prossimo_controllo=ora+d->timeout/4;
+	memset(&k, 0, sizeof(lavoro));
+	k.op='K';
+	for(j=a->num_proc-1; j>=0 && d->attivi>d->minimo; j--){
+		if(!d->attivo[j] || d->in_volo[j]>0 || d->att_testa[j]!=-1 || !spmc_vuota(&a->slot[j].condivise))
+			continue;
+		if(ora-a->slot[j].stat.ns_ultimo<d->timeout)
+			continue;
+		d->attivo[j]=false;
+		d->attivi--;
+		d->ritiri++;
+		arena_occupa(a, j);
+		ring_inserisci(&a->slot[j].richieste, &k);
+		attesa_sveglia(&a->slot[j].attesa);
+		if(d->verboso){
+			sprintf(stampa, "\tPADRE: ritiro il figlio %d (%d figli attivi)\n", j+1, d->attivi);
+			write(STDOUT, stampa, strlen(stampa));
+		}
+	}
+}
+
+/**
+ * @brief Funzione che preleva i risultati depositati dai figli nelle loro code.
+ *
+ *	Per ogni figlio di cui si e' prelevato qualche risultato vengono inviate le operazioni che
+ *	erano state messe da parte in attesa di spazio. I risultati vengono poi consegnati nell'ordine
+ *	delle operazioni, anche se i figli li producono in un ordine diverso.
+ *	Se attendi e' true e non c'e' alcun risultato pronto, il padre si addormenta finche' un
+ *	figlio non ne deposita uno.
+ *
+ * @param d		distributore
+ * @param attendi	booleano che indica se bloccarsi in assenza di risultati
+ * @return		numero di risultati prelevati
+*/
+
+int disp_raccogli(dispatcher *d, bool attendi){
+	arena *a=d->a;
+	char stampa[256];	//array di char per le stampe di sprintf
+	risultato r;
+	unsigned long long t0;	//inizio della raccolta o dell'attesa dei risultati
+	int j, n, prima;
+
+	for(;;){
+		//statistiche richieste con SIGUSR1
+		stat_controlla(d);
+		t0=TRACCIA_ORA(a);
+		n=0;
+		for(j=0; j<a->num_proc; j++){
+			prima=n;
+			while(ring_estrai(&a->slot[j].risultati, &r)){
+				//le operazioni condivise non occupano la coda delle richieste del figlio
+				if(!d->furto || r.id!=0)
+					d->in_volo[j]--;
+				d->pendenti--;
+				n++;
+				if(d->verboso){
+					sprintf(stampa, "\tPADRE: ho prelevato il risultato: %d%c%d=%d del figlio %d\n", r.val1, r.op, r.val2, r.res, j+1);
+					write(STDOUT, stampa, strlen(stampa));
+				}
+				d->ordine[r.seq%d->finestra]=r;
+				d->pronto[r.seq%d->finestra]=true;
+				if(d->dip_testa[r.seq%d->finestra]!=-1)
+					libera_dipendenti(d, r.seq);
+			}
+			if(n>prima)
+				sblocca(d, j);
+		}
+		if(n>0){
+			consegna_in_ordine(d);
+			TRACCIA(a, 0, TR_RACCOLTA, t0, n);
+		}
+		//operazioni che attendevano i risultati appena prelevati (durante un invio le prende chi lo ha avviato)
+		if(d->pronte_testa!=-1 && d->inviando==0)
+			invia_pronte(d);
+		//senza attesa (lettura ferma o servizio) si controllano anche i figli da ritirare
+		if(!attendi && d->attivi>d->minimo)
+			ritira_inattivi(d);
+		if(n>0 || !attendi || d->pendenti==0)
+			return n;
+
+		//nessun risultato pronto: attendo che un figlio ne depositi uno
+		attesa_prepara(&a->padre);
+		for(j=0; j<a->num_proc; j++)
+			if(!ring_vuoto(&a->slot[j].risultati))
+				break;
+		if(j<a->num_proc)
+			attesa_annulla(&a->padre);
+		else{
+			t0=orologio_ns();
+			attesa_dormi(&a->padre);
+			d->ns_attesa+=orologio_ns()-t0;
+			TRACCIA(a, 0, TR_ATTESA, t0, 0);
+		}
+	}
+}
+
+/**
+ * @brief Funzione che sceglie il figlio a cui assegnare un'operazione con id 0.
+ *
+ *	Il figlio libero si cerca nella bitmap condivisa, in cui ogni figlio accende il proprio bit
+ *	quando svuota la coda e lo spegne quando riprende a lavorare: nessuna system call, e il costo
+ *	non cresce con NUM_PROC. Con SCELTA_PRIMO si prende il primo figlio libero (come nel
+ *	programma originale), con SCELTA_GIRO la ricerca riparte dal figlio successivo all'ultimo
+ *	scelto, per distribuire il carico. Se nessuno e' libero si prosegue a giro tra i figli
+ *	avviati: l'operazione resta in coda finche' il figlio non la svolge.
+ *
+ * @param d		distributore
+ * @return		numero del figlio (da 1 a NUM_PROC)
+*/
+
+static int scegli_figlio(dispatcher *d){
+	unsigned long long t0=TRACCIA_ORA(d->a);
+	int j=libero_attivo(d, (d->politica==SCELTA_GIRO) ? d->cursore : 0);
+
+	if(j!=-1)
+		d->arretrato=0;
+	//tutti occupati: con l'insieme elastico, dopo soglia operazioni si avvia un figlio in piu'
+	else if(++d->arretrato<d->soglia || (j=cresci(d))==-1)
+		j=attivo_da(d, d->cursore);
+	d->cursore=(j+1==d->a->num_proc) ? 0 : j+1;
+	TRACCIA(d->a, 0, TR_SCELTA, t0, j+1);
+	return j+1;
+}
+
+/**
+ * @brief Funzione che mette un'operazione con id 0 nelle code condivise, da cui i figli la prendono da soli.
+ *
+ *	L'operazione va nella coda di un figlio libero, se c'e', altrimenti in quella indicata dal
+ *	cursore; se e' piena si prova la successiva. Dopo l'inserimento il padre sveglia un figlio
+ *	libero (che la rubera' se non e' nella sua coda): la ricerca viene ripetuta dopo una barriera,
+ *	cosi' un figlio che si sta addormentando vede l'operazione oppure viene visto libero.
+ *
+ * @param d		distributore
+ * @param l		operazione da inviare
+*/
+
+static void invia_condivisa(dispatcher *d, const lavoro *l){
+	arena *a=d->a;
+	char stampa[256];	//array di char per le stampe di sprintf
+	int j, tentativi=0;
+
+	if((j=libero_attivo(d, d->cursore))!=-1)
+		d->arretrato=0;
+	else if(++d->arretrato<d->soglia || (j=cresci(d))==-1)
+		j=attivo_da(d, d->cursore);
+	while(!spmc_inserisci(&a->slot[j].condivise, l)){
+		j=attivo_da(d, (j+1==a->num_proc) ? 0 : j+1);
+		//tutte le code condivise sono piene: attendo che i figli producano qualche risultato,
+		//senza instradare qui le operazioni che ne diventano pronte (l'invio di l non e' finito)
+		if(++tentativi==a->num_proc){
+			d->inviando++;
+			disp_raccogli(d, true);
+			d->inviando--;
+			tentativi=0;
+		}
+	}
+	d->cursore=(j+1==a->num_proc) ? 0 : j+1;
+	isto_aggiungi(&d->inoltro, orologio_ns()-d->t_letto[l->seq%d->finestra]);
+	if(d->verboso){
+		sprintf(stampa, "\tPADRE: metto il calcolo %d%c%d nella coda condivisa del figlio %d\n", l->val1, l->op, l->val2, j+1);
+		write(STDOUT, stampa, strlen(stampa));
+	}
+
+	atomic_thread_fence(memory_order_seq_cst);
+	if((j=libero_attivo(d, j))!=-1){
+		arena_occupa(a, j);
+		attesa_sveglia(&a->slot[j].attesa);
+	}
+}
+
+/**
+ * @brief Funzione che cerca il risultato di un'operazione nella cache dei risultati e, se c'e', lo consegna senza inviarla ai figli.
+ *
+ *	Il risultato viene pubblicato nella tabella dei valori e reso pronto come se l'avesse
+ *	prelevato il padre (con figlio 0): le operazioni che lo attendevano diventano pronte.
+ *
+ * @param d		distributore
+ * @param x		operazione, senza riferimenti aperti
+ * @return		true se il risultato era nella cache
+*/
+
+static bool dalla_cache(dispatcher *d, const lavoro *x){
+	char stampa[256];	//array di char per le stampe di sprintf
+	risultato r;
+	int res;
+
+	if(!memo_cerca(d->a, x->val1, x->op, x->val2, &res)){
+		d->memo_mancati++;
+		return false;
+	}
+	d->memo_successi++;
+	r.riga=x->riga;
+	r.id=x->id;
+	r.val1=x->val1;
+	r.op=x->op;
+	r.val2=x->val2;
+	r.res=res;
+	r.figlio=0;
+	r.seq=x->seq;
+	if(d->verboso){
+		sprintf(stampa, "\tPADRE: il calcolo %d%c%d=%d e' nella cache dei risultati\n", r.val1, r.op, r.val2, r.res);
+		write(STDOUT, stampa, strlen(stampa));
+	}
+	arena_scrivi_valore(d->a, r.seq, r.res);
+	d->ordine[r.seq%d->finestra]=r;
+	d->pronto[r.seq%d->finestra]=true;
+	d->pendenti--;
+	if(d->dip_testa[r.seq%d->finestra]!=-1)
+		libera_dipendenti(d, r.seq);
+	consegna_in_ordine(d);
+	//dentro invia_pronte() le operazioni appena rese pronte vengono prese dal suo stesso ciclo
+	if(d->pronte_testa!=-1 && d->inviando==0)
+		invia_pronte(d);
+	return true;
+}
+
+/**
+ * @brief Funzione che instrada un'operazione gia' numerata: al figlio indicato dal suo id, ad uno libero, nelle code condivise o in attesa dei risultati da cui dipende.
+ *
+ *	Con la cache dei risultati (-M), un'operazione gia' svolta di recente non viene inviata:
+ *	il risultato si prende dalla cache (vedi dalla_cache()).
+ *
+ * @param d		distributore
+ * @param x		operazione da instradare
+ * @return		numero del figlio a cui e' andata (0 = code condivise o cache), -1 se attende un risultato
+*/
+
+static int instrada(dispatcher *d, lavoro *x){
+	char stampa[256];	//array di char per le stampe di sprintf
+	unsigned long long attesa=0;	//operazione di cui si attende il risultato (risolvi() lo imposta se restituisce -1)
+	int val=x->id;
+
+	if(x->rif!=0){
+		if((val=risolvi(d, x, &attesa))==-1){
+			attendi_risultato(d, x, attesa);
+			return -1;
+		}
+		//riferimenti ancora aperti: l'operazione segue nella stessa coda quella da cui dipende
+		if(x->rif!=0)
+			d->concatenate++;
+	}
+	if(x->rif==0 && d->a->memo!=NULL && dalla_cache(d, x))
+		return 0;
+	if(val==0 && d->furto){
+		invia_condivisa(d, x);
+		return 0;
+	}
+	if(val==0){
+		val=scegli_figlio(d);
+		if(d->verboso){
+			sprintf(stampa, "\tPADRE: ho cercato un processo libero. Ho trovato %d\n", val);
+			write(STDOUT, stampa, strlen(stampa));
+		}
+	}
+	//l'id indica sempre lo stesso slot: se il suo figlio non e' avviato lo si avvia
+	else if(!d->attivo[val-1])
+		avvia_figlio(d, val-1);
+
+	//se il figlio ha la coda piena (o altre operazioni in attesa) metto da parte l'operazione
+	if(d->att_testa[val-1]!=-1 || d->in_volo[val-1]==d->a->profondita){
+		if(d->verboso){
+			if(x->rif!=0)
+				sprintf(stampa, "\tPADRE: il figlio %d e' occupato, metto da parte il calcolo della riga %d\n", val, x->riga);
+			else
+				sprintf(stampa, "\tPADRE: il figlio %d e' occupato, metto da parte il calcolo %d%c%d\n", val, x->val1, x->op, x->val2);
+			write(STDOUT, stampa, strlen(stampa));
+		}
+		parcheggia(d, val-1, x);
+	}
+	else{
+		if(d->verboso){
+			//un operando ancora aperto contiene la distanza dall'operazione riferita, non il suo valore
+			if(x->rif!=0)
+				sprintf(stampa, "\tPADRE: assegno il calcolo della riga %d al figlio %d, dopo l'operazione da cui dipende\n", x->riga, val);
+			else
+				sprintf(stampa, "\tPADRE: assegno il calcolo %d%c%d al figlio %d\n", x->val1, x->op, x->val2, val);
+			write(STDOUT, stampa, strlen(stampa));
+		}
+		accoda(d, val-1, x);
+	}
+	return val;
+}
+
+/**
+ * @brief Funzione che instrada le operazioni i cui risultati attesi sono stati prelevati.
+ *
+ * @param d		distributore
+*/
+
+static void invia_pronte(dispatcher *d){
+	lavoro x;
+	int k;
+
+	d->inviando++;
+	while((k=d->pronte_testa)!=-1){
+		d->pronte_testa=d->succ[k];
+		if(d->pronte_testa==-1)
+			d->pronte_coda=-1;
+		x=d->deposito[k];
+		d->succ[k]=d->posto_libero;
+		d->posto_libero=k;
+		instrada(d, &x);
+	}
+	d->inviando--;
+}
+
+/**
+ * @brief Funzione che invia un'operazione al figlio indicato dal suo id (o ad uno libero se id e' 0).
+ *
+ *	Il padre non attende che il figlio abbia svolto l'operazione. Se la coda del figlio e' piena
+ *	l'operazione viene messa da parte e il padre continua a leggere e distribuire le operazioni
+ *	successive agli altri figli: si blocca solo quando le operazioni lette e non ancora consegnate
+ *	raggiungono la finestra, e nel frattempo preleva i risultati pronti. Con il furto di lavoro
+ *	le operazioni con id 0 non vengono assegnate dal padre ma messe nelle code condivise.
+ *	Un'operazione con riferimenti ($N) a risultati non ancora calcolati attende nel deposito, a
+ *	meno che non possa seguire nella stessa coda l'operazione da cui dipende (vedi risolvi()).
+ *	Un'operazione con un riferimento oltre la tabella dei valori viene rifiutata senza numerarla:
+ *	il chiamante deve interrompere il flusso da cui proviene.
+ *
+ * @param d		distributore
+ * @param l		operazione da inviare
+ * @return		0 in caso di successo, -1 se l'operazione e' stata rifiutata
+*/
+
+int disp_invia(dispatcher *d, const lavoro *l){
+	unsigned long long t0=TRACCIA_ORA(d->a);	//inizio dell'invio, per la traccia
+	lavoro x=*l;
+	int val;
+
+	if(x.rif!=0 && controlla_riferimenti(d, &x)==-1)
+		return -1;
+	//la finestra di lettura anticipata e' piena: attendo che il risultato piu' vecchio sia consegnato
+	while(d->inviati-d->consegnati>=d->finestra)
+		disp_raccogli(d, true);
+	x.seq=d->inviati++;
+	d->t_letto[x.seq%d->finestra]=orologio_ns();
+	d->dove[x.seq%d->finestra]=0;
+	d->pendenti++;
+
+	if(d->attivi>d->minimo)
+		ritira_inattivi(d);
+	if((val=instrada(d, &x))==-1){
+		d->dipendenti++;
+		val=0;
+	}
+	//operazioni rese pronte mentre l'invio attendeva spazio nelle code condivise
+	if(d->pronte_testa!=-1)
+		invia_pronte(d);
+	TRACCIA(d->a, 0, TR_INVIO, t0, val);
+	return 0;
+}
+
+/**
+ * @brief Funzione che attende che i figli abbiano svolto tutte le operazioni inviate.
+ *
+ * @param d		distributore
+*/
+
+void disp_svuota(dispatcher *d){
+	while(d->pendenti>0)
+		disp_raccogli(d, true);
+}
+
+/**
+ * @brief Funzione che invia a tutti i figli avviati il comando di terminazione 'K'.
+ *
+ *	Va chiamata dopo disp_svuota(), quando tutte le code dei figli sono vuote.
+ *
+ * @param d		distributore
+*/
+
+void disp_termina(dispatcher *d){
+	unsigned long long t0=TRACCIA_ORA(d->a);
+	lavoro k;
+	int j;
+
+	memset(&k, 0, sizeof(lavoro));
+	k.op='K';
+	for(j=0; j<d->a->num_proc; j++){
+		if(!d->attivo[j])
+			continue;
+		ring_inserisci(&d->a->slot[j].richieste, &k);
+		attesa_sveglia(&d->a->slot[j].attesa);
+	}
+	TRACCIA(d->a, 0, TR_TERMINA, t0, 0);
+}
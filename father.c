@@ -10,6 +10,15 @@
 #include <sys/shm.h>
 #include <sys/sem.h>
 #include <stdio.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/prctl.h>
+#include <dirent.h>
+#include <signal.h>
+#include <pthread.h>
 
 /**
  * @brief Programma in C che utilizzi le system call (IPC), ove possibile, per implementare un simulatore di calcolo parallelo.
@@ -60,352 +69,807 @@
  *		7. Libera eventuali risorse.
  *		8. Esce.
  *
+ *	Padre e figli comunicano attraverso due code circolari per figlio (operazioni e risultati),
+ *	cosi' il padre puo' accodare piu' operazioni senza attendere il figlio e il figlio le svolge
+ *	una dopo l'altra. La profondita' delle code si sceglie con l'opzione -r.
+ *
+ *	La sincronizzazione tra padre e figli si sceglie con l'opzione -s: "sysv" usa un semaforo
+ *	SysV per processo, "futex" usa un'attesa attiva limitata seguita da una futex sulla memoria
+ *	condivisa, senza alcun oggetto IPC.
+ *
+ *	Il costo di ogni operazione e' descritto da un modello (vedi costo.c): nullo, fisso in
+ *	nanosecondi per operatore, oppure estratto da una distribuzione indicata con le direttive
+ *	"#costo" nell'intestazione del file. L'opzione -c lo sovrascrive per tutti gli operatori o per
+ *	alcuni. Per default ogni operazione costa 1 secondo simulato: i figli sommano il costo al
+ *	loro tempo simulato senza attenderlo, a meno che non si usi -R. Alla fine il padre stampa sia il
+ *	tempo simulato (quello del figlio piu' carico) sia il tempo reale.
+ *
+ *	Per le operazioni con id 0 il figlio libero si cerca in una bitmap condivisa aggiornata dai
+ *	figli stessi: con -l primo si sceglie il primo libero, con -l giro si riparte ogni volta dal
+ *	figlio successivo all'ultimo scelto.
+ *
+ *	Con -w le operazioni con id 0 non vengono assegnate dal padre: finiscono in code condivise,
+ *	una per figlio, da cui ogni figlio senza lavoro prende da solo, rubando dalle code degli altri
+ *	quando la sua e' vuota. Le operazioni con id diverso da zero restano al loro figlio.
+ *
+ *	Se la coda di un figlio e' piena, le operazioni destinate a lui vengono messe da parte e il
+ *	padre continua a distribuire le successive agli altri figli, invece di bloccarsi sulla prima.
+ *	Le operazioni lette e non ancora consegnate sono al piu' quelle indicate con -f (4096 per
+ *	default), e i risultati vengono salvati nell'ordine delle operazioni nel file.
+ *
+ *	Le operazioni vengono lette man mano che arrivano, anche dallo standard input ("-" come nome
+ *	del file), e ogni risultato viene scritto non appena sono stati consegnati quelli delle
+ *	operazioni precedenti: la memoria usata dipende dalla finestra e non dalla lunghezza del file.
+ *	Con -o si sceglie il file dei risultati (Risultati.txt per default): con "-o -" i risultati
+ *	vanno sullo standard output e tutti i messaggi sullo standard error, cosi' il simulatore si
+ *	puo' usare in una pipeline. Con -n il numero di processi si passa dalla riga di comando e il
+ *	file non ha la prima riga.
+ *
+ *	Il file delle operazioni puo' essere anche nel formato binario a record fissi (vedi mylib.h),
+ *	riconosciuto dalla sua intestazione: il padre lo mappa in memoria e copia i record senza
+ *	alcuna conversione da testo. Con -B anche i risultati vengono scritti in binario. Il programma
+ *	convertitore trasforma i file di testo in binario e viceversa.
+ *
+ *	Ciascun operando puo' essere anche $N, il risultato dell'N-esima operazione del file (la riga
+ *	N del file dei risultati), purche' precedente: le dipendenze formano cosi' un grafo aciclico.
+ *	Il padre invia un'operazione appena sono calcolati i risultati da cui dipende, che legge
+ *	dalla tabella dei valori in cui li scrivono i figli; se invece l'operazione riferita e'
+ *	ancora nella coda di un figlio, quella che ne dipende la segue nella stessa coda e il figlio
+ *	legge da solo il risultato, senza passare dal padre. Nel frattempo le operazioni
+ *	indipendenti continuano a essere distribuite. Si puo' risalire al piu' di 2*finestra-1
+ *	operazioni (8191 con la finestra predefinita): un riferimento piu' lontano interrompe la
+ *	lettura, perche' il risultato non e' piu' disponibile, e il padre termina con stato 1 dopo
+ *	aver scritto i risultati delle operazioni precedenti. Per file con dipendenze lontane va
+ *	aumentata la finestra (-f).
+ *
+ *	Ogni figlio preleva dalla sua coda fino a LOTTO operazioni alla volta e le svolge insieme,
+ *	raggruppate per operatore, con le istruzioni vettoriali della CPU (SSE2 o AVX2, scelte
+ *	all'avvio) o con un kernel scalare. La divisione per zero da' risultato 0 e viene segnalata.
+ *
+ *	Con -b thread i figli non sono processi creati con fork() ma thread dello stesso processo,
+ *	che eseguono lo stesso ciclo sulla stessa regione e con lo stesso protocollo: l'avvio e la
+ *	terminazione sono molto piu' leggeri e il file dei risultati e' identico. Con -b processi
+ *	(il default) ogni figlio resta isolato nel suo processo.
+ *
+ *	Con -D il padre diventa un servizio: crea i figli una volta sola (il loro numero si passa
+ *	con -n) e accetta sul socket Unix indicato flussi di operazioni da piu' client insieme,
+ *	restituendo a ciascuno i suoi risultati sullo stesso socket (vedi servizio.c e il programma
+ *	cliente). Con SIGTERM o SIGINT serve i client connessi e poi termina come al solito.
+ *
+ *	Ogni figlio tiene nella regione condivisa i propri contatori (operazioni, lotti, tempo di
+ *	calcolo, di attesa e di inattivita') e il padre gli istogrammi della latenza di inoltro e di
+ *	completamento delle operazioni. Alla fine, o quando riceve SIGUSR1, il padre li stampa come
+ *	righe "STAT" chiave=valore (vedi statistiche.c). Con -q non si stampa nulla per le singole
+ *	operazioni e per i singoli figli.
+ *
+ *	Con -T padre e figli registrano gli eventi della simulazione (lettura, invio, scelta del
+ *	figlio, operazioni messe da parte, attese, raccolta dei risultati, calcoli, terminazione)
+ *	in anelli in memoria condivisa, uno per processo; alla fine il padre li riunisce nel file
+ *	indicato, nel formato JSON di Chrome (vedi traccia.c). Senza -T non si registra nulla.
+ *
+ *	Con -A il padre e ogni figlio vengono legati a una CPU: "compatta" tiene il padre e i figli
+ *	sulle CPU vicine (stesso nodo NUMA, stesso socket), "sparsa" li distribuisce tra i nodi e i
+ *	core, oppure si indica un elenco di CPU ("0,2,4-7": la prima e' del padre). Su una macchina
+ *	con piu' nodi NUMA le code di ogni figlio vengono allocate sul nodo della sua CPU (vedi
+ *	affinita.c); CPU e nodi effettivi compaiono nelle righe STAT.
+ *
+ *	Con -E min:max[:ms] i figli non sono fissi: ne partono min e il padre ne avvia altri, fino a
+ *	max, quando le operazioni con id 0 trovano occupati tutti i figli attivi per piu' di una coda
+ *	di fila, oppure quando arriva un'operazione per un id non ancora avviato. Un figlio oltre il
+ *	minimo che resta senza lavoro per ms millisecondi (100 per default) viene ritirato con 'K' e
+ *	il suo slot puo' essere riusato. max non puo' essere inferiore al numero di processi del file.
+ *
+ *	Con -M voci padre e figli condividono una cache dei risultati delle operazioni svolte di
+ *	recente, di almeno voci voci (vedi memo.c): ogni figlio vi inserisce le terne (val1, op, val2)
+ *	che svolge e il padre, prima di inviare un'operazione, la cerca nella cache e, se c'e', ne
+ *	consegna subito il risultato senza passare dai figli. Quando la cache e' piena si rimpiazza la
+ *	voce piu' vecchia del suo insieme. Le divisioni per zero non vengono mai messe nella cache.
+ *
+ *	Con -C intervallo, ogni intervallo operazioni consegnate, il padre scrive un punto di ripresa
+ *	nel file <uscita>.ripresa, mappato in memoria: la posizione nel file delle operazioni, i byte
+ *	validi del file dei risultati (portati prima su disco) e i risultati delle ultime operazioni,
+ *	per i riferimenti $N (vedi ripresa.c). Se il padre viene ucciso, rilanciandolo con -P sullo
+ *	stesso file riprende dall'ultimo punto: il file dei risultati viene troncato al punto e si
+ *	svolgono solo le operazioni successive. -P senza -C scrive i punti ogni RIPRESA_INTERVALLO
+ *	operazioni; a simulazione completata il file di ripresa viene rimosso. Servono un file delle
+ *	operazioni e un file dei risultati regolari (non con -D o "-").
+ *	I semafori lasciati da un'esecuzione uccisa (quelli di cui non e' vivo nessun processo)
+ *	vengono rimossi alla creazione dei nuovi, con o senza -P (vedi semaforo_crea()).
+ *
+ *	Con -L lettori il file delle operazioni (un file di testo regolare, mappato in memoria) viene
+ *	diviso in pezzi che terminano a fine riga, analizzati da lettori thread mentre il padre
+ *	distribuisce le operazioni dei pezzi gia' pronti, nell'ordine del file (vedi
+ *	parser_parallelo()): numeri di riga, righe malformate e riferimenti $N restano gli stessi.
+ *	Con un file binario o letto a blocchi (pipe, STDIN) -L viene ignorato.
+ *
+ *	Con -W soglia_kb[:fsync] i risultati vengono scritti da un thread (vedi uscita_asincrona()):
+ *	il padre accumula i risultati consegnati in un buffer di soglia_kb KB e, quando e' pieno, lo
+ *	passa al thread e continua sul secondo buffer, cosi' la scrittura del file si sovrappone al
+ *	calcolo. La politica di fsync puo' essere mai (il default), blocco (fdatasync dopo ogni
+ *	buffer scritto) o fine (una sola fdatasync alla chiusura del file).
+ *
+ *	Uso: father [-r profondita] [-s sysv|futex] [-c zero|ns|op=ns,...] [-R] [-l primo|giro] [-w] [-f finestra] [-n processi] [-o uscita] [-B] [-b processi|thread] [-D socket] [-q] [-T traccia] [-A compatta|sparsa|cpu,...] [-E min:max[:ms]] [-M voci] [-C intervallo] [-P] [-L lettori] [-W soglia_kb[:mai|blocco|fine]] [file|-]
+ *	(un riferimento $N puo' risalire al piu' di 2*finestra-1 operazioni)
+ *
+*/
+
+///Messaggio di uso del programma
+static const char uso[]="Uso: father [-r profondita] [-s sysv|futex] [-c zero|ns|op=ns,...] [-R] [-l primo|giro] [-w] [-f finestra] [-n processi] [-o uscita] [-B] [-b processi|thread] [-D socket] [-q] [-T traccia] [-A compatta|sparsa|cpu,...] [-E min:max[:ms]] [-M voci] [-C intervallo] [-P] [-L lettori] [-W soglia_kb[:mai|blocco|fine]] [file|-]\n\t(un riferimento $N puo' risalire al piu' di 2*finestra-1 operazioni)\n";
+
+/**
+ * @brief Funzione chiamata dal distributore per ogni risultato, nell'ordine delle operazioni: lo scrive sul file dei risultati.
+ *
+ * @param ctx		scrittore dei risultati (uscita)
+ * @param r		risultato prelevato
+*/
+
+static void salva_risultato(void *ctx, const risultato *r){
+	uscita_risultato((uscita *)ctx, r);
+}
+
+/**
+ * @brief Funzione chiamata dal distributore per ogni risultato con -C o -P: lo scrive sul file dei risultati e, quando serve, scrive un punto di ripresa.
+ *
+ * @param ctx		stato dei punti di ripresa (ripresa), con lo scrittore dei risultati
+ * @param r		risultato prelevato
+*/
+
+static void salva_con_ripresa(void *ctx, const risultato *r){
+	ripresa *rp=(ripresa *)ctx;
+
+	uscita_risultato(rp->u, r);
+	if(ripresa_consegnato(rp, r)==-1)
+		write(STDOUT, "Errore in scrittura del punto di ripresa\n", strlen("Errore in scrittura del punto di ripresa\n"));
+}
+
+///STRUTTURA CONTENENTE GLI ARGOMENTI DI UN FIGLIO ESEGUITO COME THREAD
+typedef struct argomenti{
+	///Regione condivisa
+	arena *a;
+	///Numero del figlio (da 1 a NUM_PROC)
+	int id;
+}figlio_thread;
+
+/**
+ * @brief Funzione eseguita da ciascun thread figlio con -b thread: lo stesso ciclo dei processi figlio.
+ *
+ * @param arg		argomenti del figlio (figlio_thread)
+ * @return		NULL
+*/
+
+static void *esegui_thread(void *arg){
+	figlio_thread *f=(figlio_thread *)arg;
+
+	esegui_figlio(f->a, f->id);
+	return NULL;
+}
+
+///STRUTTURA CONTENENTE I FIGLI DEL PADRE, PROCESSI O THREAD, UNO PER SLOT DELLA REGIONE
+typedef struct vivaio{
+	///Regione condivisa
+	arena *a;
+	///BACKEND_PROCESSI o BACKEND_THREAD
+	int backend;
+	///Booleano che indica se il padre e' un servizio (i processi figli ignorano SIGINT e SIGTERM)
+	bool servizio;
+	///Booleano che disabilita le stampe per ogni figlio
+	bool silenzioso;
+	///Processo o thread di ciascuno slot
+	pid_t *processi;
+	pthread_t *thread;
+	figlio_thread *argomenti;
+	///Booleani che indicano gli slot con un figlio avviato e non ancora atteso
+	bool *vivo;
+	///Attributi dei thread figli
+	pthread_attr_t attributi;
+}vivaio;
+
+/**
+ * @brief Funzione che attende la terminazione del figlio dello slot j, se c'e'.
+ *
+ * @param v		figli del padre
+ * @param j		indice dello slot
+*/
+
+static void attendi_figlio(vivaio *v, int j){
+	if(!v->vivo[j])
+		return;
+	if(v->backend==BACKEND_THREAD)
+		pthread_join(v->thread[j], NULL);
+	else
+		waitpid(v->processi[j], NULL, 0);
+	v->vivo[j]=false;
+}
+
+/**
+ * @brief Funzione che chiude tutti i file descriptor a partire da primo, senza richiedere closefrom().
+ *
+ *	I descrittori aperti si leggono da /proc/self/fd; se non e' disponibile si chiudono uno per
+ *	uno fino al limite del processo.
+ *
+ * @param primo		primo file descriptor da chiudere
+*/
+
+static void chiudi_da(int primo){
+	DIR *dir;
+	struct dirent *e;
+	long fd, max;
+
+	if((dir=opendir("/proc/self/fd"))!=NULL){
+		while((e=readdir(dir))!=NULL){
+			fd=strtol(e->d_name, NULL, 10);
+			if(e->d_name[0]!='.' && fd>=primo && fd!=dirfd(dir))
+				close((int)fd);
+		}
+		closedir(dir);
+		return;
+	}
+	if((max=sysconf(_SC_OPEN_MAX))==-1)
+		max=1024;
+	for(fd=primo; fd<max; fd++)
+		close((int)fd);
+}
+
+/**
+ * @brief Funzione che avvia il figlio j+1 (processo o thread) nello slot j.
+ *
+ *	Se lo slot ha ospitato un figlio ritirato, prima lo si attende: ha gia' ricevuto il 'K' e
+ *	termina subito. Usata sia all'avvio sia dal distributore con l'insieme elastico (-E).
+ *
+ * @param ctx		figli del padre (vivaio)
+ * @param j		indice dello slot
+*/
+
+static void avvia_figlio(void *ctx, int j){
+	vivaio *v=(vivaio *)ctx;
+	char stampa[256];	//array di char per le stampe di sprintf
+
+	attendi_figlio(v, j);
+	if(v->backend==BACKEND_THREAD){
+		//i thread figli condividono gia' tutta la memoria del padre: basta passare la regione
+		v->argomenti[j].a=v->a;
+		v->argomenti[j].id=j+1;
+		if(pthread_create(&v->thread[j], &v->attributi, esegui_thread, &v->argomenti[j])!=0){
+			write(STDOUT, "Creazione del thread fallita\n", strlen("Creazione del thread fallita\n"));
+			exit(1);
+		}
+	}
+	else{
+		v->processi[j]=fork();
+		if(v->processi[j]<0){		//fork() fallita
+			write(STDOUT, "Fork fallita\n", strlen("Fork fallita\n"));
+			exit(1);
+		}
+		else if(v->processi[j]==0){
+			//se il padre muore il figlio viene terminato, cosi' la regione condivisa viene liberata
+			prctl(PR_SET_PDEATHSIG, SIGKILL);
+			if(getppid()==1)
+				exit(1);
+			//nel servizio il Ctrl-C arriva a tutto il gruppo: lo gestisce solo il padre, che chiude i figli con 'K'
+			if(v->servizio){
+				signal(SIGINT, SIG_IGN);
+				signal(SIGTERM, SIG_IGN);
+			}
+			//le statistiche le stampa solo il padre
+			signal(SIGUSR1, SIG_IGN);
+			//al figlio basta la memoria condivisa: un figlio avviato con -E mentre il servizio ha
+			//client connessi non deve tenere aperti i loro socket, o i client non vedono mai la chiusura
+			chiudi_da(STDERR+1);
+			esegui_figlio(v->a, j+1);
+			exit(0);
+		}
+	}
+	v->vivo[j]=true;
+	if(!v->silenzioso){
+		sprintf(stampa, "\tPADRE: figlio %d creato correttamente\n", j+1);
+		write(STDOUT, stampa, strlen(stampa));
+	}
+}
+
+///STRUTTURA CONTENENTE GLI ARGOMENTI DELL'ATTESA DI NUOVI DATI DA LEGGERE
+typedef struct argomenti_attesa{
+	///Distributore
+	dispatcher *d;
+	///Scrittura dei risultati (d->ctx e' la ripresa con -C o -P)
+	uscita *u;
+}attesa_input;
+
+/**
+ * @brief Funzione chiamata dal parser quando non ci sono nuovi dati da leggere.
+ *
+ *	Preleva i risultati pronti e scrive quelli gia' consegnati, cosi' chi legge i risultati non
+ *	attende l'arrivo della prossima operazione. Con la scrittura asincrona (-W) i risultati
+ *	passano al thread di scrittura senza attendere che li scriva.
+ *
+ * @param ctx		distributore e scrittura dei risultati (attesa_input)
+ * @return		true se ci sono ancora operazioni in corso o risultati non ancora passati al thread
 */
 
-void main (void){
+static bool attendi_input(void *ctx){
+	attesa_input *x=(attesa_input *)ctx;
+	dispatcher *d=x->d;
 
-	int fd, r;		//file descriptor e lettura del file
+	disp_raccogli(d, false);
+	//il thread di scrittura e' occupato: i risultati rimasti passano alla prossima chiamata
+	if(uscita_inoltra(x->u)==1)
+		return true;
+	//con -E si continua a controllare anche senza operazioni in volo, per ritirare i figli inattivi
+	return d->pendenti>0 || d->attivi>d->minimo;
+}
+
+int main (int argc, char *argv[]){
+
+	int fd=-1;		//file descriptor del file dei risultati
 	int j=0, i=0;		//contatori
-	int righe=-2;		//escludo il primo e l'ultimo \n
+	int opt;		//opzione letta dalla riga di comando
 	int NUM_PROC=0;		//numero di processi da creare
+	unsigned profondita=PROFONDITA;	//profondita' delle code di ciascun figlio
+	int sincronizzazione=SYNC_SYSV;	//meccanismo di sincronizzazione tra padre e figli
+	const char *costo_cli=NULL;	//costo passato con -c, applicato dopo le direttive del file
+	bool costo_reale=false;		//i figli attendono davvero il costo delle operazioni
+	int politica=SCELTA_PRIMO;	//scelta del figlio libero per le operazioni con id 0
+	bool furto=false;		//furto di lavoro tra figli per le operazioni con id 0
+	long finestra=FINESTRA;		//operazioni lette e non ancora consegnate
+	int processi_cli=0;		//numero di processi passato con -n (il file non ha la prima riga)
+	const char *nome_uscita="Risultati.txt";	//file dei risultati ("-" = STDOUT)
+	bool uscita_binaria=false;	//risultati nel formato binario
+	int backend=BACKEND_PROCESSI;	//figli come processi o come thread
+	const char *percorso=NULL;	//socket del servizio (NULL = esecuzione di un solo file)
+	bool silenzioso=false;		//nessuna stampa per le singole operazioni
+	const char *nome_traccia=NULL;	//file della traccia (NULL = traccia disabilitata)
+	const char *affinita=NULL;	//posizione di padre e figli sulle CPU (NULL = decide lo scheduler)
+	int letto=0;			//esito dell'ultima lettura di un'operazione (-1 = lettura interrotta)
+	long memo=0;			//voci della cache dei risultati (0 = cache disabilitata)
+	unsigned long long intervallo=0;	//operazioni tra due punti di ripresa (0 = senza punti di ripresa)
+	bool riprendi=false;		//riprende dall'ultimo punto di ripresa
+	bool con_ripresa;		//scrive i punti di ripresa (-C o -P)
+	int lettori=0;			//thread di lettura parallela del file (0 = lettura normale)
+	long soglia=0;			//KB di risultati passati ogni volta al thread di scrittura (0 = scrittura dal padre)
+	int politica_fsync=FSYNC_MAI;	//fdatasync del file dei risultati con -W
+	char *nome_ripresa=NULL;	//file di ripresa: il file dei risultati con ".ripresa"
+	ripresa rp;			//stato dei punti di ripresa
+	attesa_input ai;		//argomenti di attendi_input()
+	unsigned long long seq;		//numero d'ordine di un'operazione gia' svolta
+	struct stat st;			//dimensione del file dei risultati da riprendere
+	const char *elastico=NULL;	//insieme elastico di figli "min:max[:ms]" (NULL = NUM_PROC figli fissi)
+	int minimo=0, massimo=0;	//figli sempre attivi e figli al piu' attivi con -E
+	long timeout=100;		//millisecondi di inattivita' dopo cui un figlio oltre il minimo viene ritirato
+	int capacita;			//slot della regione condivisa: NUM_PROC, o il massimo con -E
+	int iniziali;			//figli avviati subito
+	char *fine_num;			//fine dei numeri letti da -E
+	int *cpu=NULL, *nodo=NULL;	//CPU e nodo NUMA del padre (indice 0) e dei figli
+	int nodi=0;			//nodi NUMA usati dai figli
+	unsigned long long t0;		//inizio della lettura di un'operazione, per la traccia
+	long long persi;		//eventi della traccia sovrascritti
+	modello_costo costi;		//modello di costo delle operazioni
+	struct timespec inizio, fine;	//tempo reale della simulazione
+	struct timespec avvio;		//inizio della creazione dei figli
+	unsigned long long simulato=0;	//tempo simulato del figlio piu' carico
 	const char *file_name="file.txt";
-	char buffer[BUFLEN];	//buffer di lettura
-	char buf;		//carattere di lettura
-	char stampa[256];	//array di char per le stampe di sprintf
+	char stampa[512];	//array di char per le stampe di sprintf
+	char descrizione[256];	//descrizione del modello di costo
+	parser p;		//lettore del file di configurazione
+	lavoro l;		//operazione letta dal file
+	dispatcher d;		//stato del padre nella distribuzione delle operazioni
+	uscita u;		//scrittura bufferizzata dei risultati
+
+	while((opt=getopt(argc, argv, "r:s:c:Rl:wf:n:o:Bb:D:qT:A:E:M:C:PL:W:"))!=-1){
+		switch(opt){
+			case 'r':
+				profondita=atoi(optarg);
+				break;
+			case 's':
+				if(strcmp(optarg, "sysv")==0)
+					sincronizzazione=SYNC_SYSV;
+				else if(strcmp(optarg, "futex")==0)
+					sincronizzazione=SYNC_FUTEX;
+				else{
+					write(STDOUT, uso, strlen(uso));
+					exit(1);
+				}
+				break;
+			case 'c':
+				costo_cli=optarg;
+				break;
+			case 'R':
+				costo_reale=true;
+				break;
+			case 'w':
+				furto=true;
+				break;
+			case 'f':
+				finestra=atol(optarg);
+				break;
+			case 'n':
+				if((processi_cli=atoi(optarg))<1){
+					write(STDOUT, "Numero processi inferiore a 1\n", strlen("Numero processi inferiore a 1\n"));
+					exit(1);
+				}
+				break;
+			case 'o':
+				nome_uscita=optarg;
+				break;
+			case 'B':
+				uscita_binaria=true;
+				break;
+			case 'b':
+				if(strcmp(optarg, "processi")==0)
+					backend=BACKEND_PROCESSI;
+				else if(strcmp(optarg, "thread")==0)
+					backend=BACKEND_THREAD;
+				else{
+					write(STDOUT, uso, strlen(uso));
+					exit(1);
+				}
+				break;
+			case 'D':
+				percorso=optarg;
+				break;
+			case 'q':
+				silenzioso=true;
+				break;
+			case 'T':
+				nome_traccia=optarg;
+				break;
+			case 'A':
+				affinita=optarg;
+				break;
+			case 'E':
+				elastico=optarg;
+				minimo=(int)strtol(optarg, &fine_num, 10);
+				if(*fine_num==':')
+					massimo=(int)strtol(fine_num+1, &fine_num, 10);
+				if(*fine_num==':')
+					timeout=strtol(fine_num+1, &fine_num, 10);
+				if(*fine_num!='\0' || minimo<1 || massimo<minimo || timeout<1){
+					write(STDOUT, "Insieme elastico non valido\n", strlen("Insieme elastico non valido\n"));
+					exit(1);
+				}
+				break;
+			case 'M':
+				memo=strtol(optarg, &fine_num, 10);
+				if(*fine_num!='\0' || memo<1 || memo>(1l<<28)){
+					write(STDOUT, "Dimensione della cache non valida\n", strlen("Dimensione della cache non valida\n"));
+					exit(1);
+				}
+				break;
+			case 'C':
+				intervallo=strtoull(optarg, &fine_num, 10);
+				if(*fine_num!='\0' || intervallo<1){
+					write(STDOUT, "Intervallo dei punti di ripresa non valido\n", strlen("Intervallo dei punti di ripresa non valido\n"));
+					exit(1);
+				}
+				break;
+			case 'P':
+				riprendi=true;
+				break;
+			case 'W':
+				soglia=strtol(optarg, &fine_num, 10);
+				if(*fine_num==':'){
+					if(strcmp(fine_num+1, "blocco")==0)
+						politica_fsync=FSYNC_BLOCCO;
+					else if(strcmp(fine_num+1, "fine")==0)
+						politica_fsync=FSYNC_FINE;
+					else if(strcmp(fine_num+1, "mai")!=0)
+						soglia=0;	//politica non valida
+					fine_num+=strlen(fine_num);
+				}
+				if(*fine_num!='\0' || soglia<1 || soglia>(1l<<20)){
+					write(STDOUT, "Scrittura asincrona non valida\n", strlen("Scrittura asincrona non valida\n"));
+					exit(1);
+				}
+				break;
+			case 'L':
+				lettori=(int)strtol(optarg, &fine_num, 10);
+				if(*fine_num!='\0' || lettori<1 || lettori>64){
+					write(STDOUT, "Numero di thread di lettura non valido\n", strlen("Numero di thread di lettura non valido\n"));
+					exit(1);
+				}
+				break;
+			case 'l':
+				if(strcmp(optarg, "primo")==0)
+					politica=SCELTA_PRIMO;
+				else if(strcmp(optarg, "giro")==0)
+					politica=SCELTA_GIRO;
+				else{
+					write(STDOUT, uso, strlen(uso));
+					exit(1);
+				}
+				break;
+			default:
+				write(STDOUT, uso, strlen(uso));
+				exit(1);
+		}
+	}
+	if(optind<argc)
+		file_name=argv[optind];
+	//la profondita' delle code deve essere una potenza di 2
+	if(profondita<1 || profondita>(1u<<20)){
+		write(STDOUT, "Profondita' delle code non valida\n", strlen("Profondita' delle code non valida\n"));
+		exit(1);
+	}
+	while(profondita&(profondita-1))
+		profondita+=profondita&-profondita;
+	if(finestra<1 || finestra>(1l<<24)){
+		write(STDOUT, "Finestra non valida\n", strlen("Finestra non valida\n"));
+		exit(1);
+	}
+	//con i risultati sullo standard output, tutti i messaggi (anche quelli dei figli) vanno sullo standard error
+	if(strcmp(nome_uscita, "-")==0){
+		fd=dup(STDOUT);
+		dup2(STDERR, STDOUT);
+	}
 
+	//i punti di ripresa legano un file delle operazioni a un file dei risultati
+	con_ripresa=(intervallo>0 || riprendi);
+	if(con_ripresa && (percorso!=NULL || strcmp(nome_uscita, "-")==0)){
+		write(STDOUT, "Con -C e -P servono un file delle operazioni e un file dei risultati\n", strlen("Con -C e -P servono un file delle operazioni e un file dei risultati\n"));
+		exit(1);
+	}
 
+	//il servizio non ha un file di configurazione: il numero di processi va passato con -n
+	if(percorso!=NULL && processi_cli==0){
+		write(STDOUT, "Con -D il numero di processi va indicato con -n\n", strlen("Con -D il numero di processi va indicato con -n\n"));
+		exit(1);
+	}
 
-	//APERTURA DEL FILE
-	fd=open(file_name, O_RDONLY);
-	if(fd==-1){
+	//APERTURA DEL FILE (mappato in memoria se possibile, altrimenti letto a blocchi)
+	if(percorso==NULL && parser_apri(&p, file_name)==-1){
 		write(STDOUT, "Errore in apertura del file\n", strlen("Errore in apertura del file\n"));
 		exit(1);
 	}
 	
-	
-	// LEGGO IL NUMERO DI OPERAZIONI DA SVOLGERE
-	while(r!=0){
-		r=read(fd, &buf, 1);
-		if(r==-1){
-			write(STDOUT, "Errore in lettura del file\n", strlen("Errore in lettura del file\n"));
+//LETTURA DEL NUMERO DI PROCESSI DA CREARE E DEL MODELLO DI COSTO
+	//il numero di operazioni non viene piu' contato in anticipo: il parser le conta in un'unica passata
+	costo_init(&costi, COSTO_PREDEFINITO);
+	p.costi=&costi;
+	p.num_proc=processi_cli;
+	//un riferimento $N si risolve solo se il risultato e' ancora nella tabella dei valori (2*finestra risultati)
+	p.portata=2*(int)finestra-1;
+	NUM_PROC=(percorso==NULL) ? parser_intestazione(&p) : processi_cli;
+	if(NUM_PROC==-1){
+		write(STDOUT, "File vuoto o prima riga non valida\n", strlen("File vuoto o prima riga non valida\n"));
+		exit(1);
+	}
+
+	if (NUM_PROC < 1){
+		write(STDOUT, "Numero processi inferiore a 1\n", strlen("Numero processi inferiore a 1\n"));
+		exit(1);
+	}
+	if(costo_cli!=NULL && costo_imposta(&costi, costo_cli)==-1){
+		write(STDOUT, "Costo delle operazioni non valido\n", strlen("Costo delle operazioni non valido\n"));
+		exit(1);
+	}
+	//con -E gli id del file vanno da 1 a NUM_PROC: servono almeno NUM_PROC slot
+	if(elastico!=NULL && massimo<NUM_PROC){
+		write(STDOUT, "Con -E il massimo non puo' essere inferiore al numero di processi\n", strlen("Con -E il massimo non puo' essere inferiore al numero di processi\n"));
+		exit(1);
+	}
+	capacita=(elastico!=NULL) ? massimo : NUM_PROC;
+	iniziali=(elastico!=NULL) ? minimo : NUM_PROC;
+	costi.reale=costo_reale;
+	costo_descrivi(&costi, descrizione);
+	sprintf(stampa, "Modello di costo: %s\n", descrizione);
+	write(STDOUT, stampa, strlen(stampa));
+	//il kernel dei lotti si sceglie una volta sola, i figli ereditano la scelta
+	sprintf(stampa, "Kernel di calcolo: %s\n", kernel_nome(kernel_init(KERNEL_AUTO)));
+	write(STDOUT, stampa, strlen(stampa));
+
+	//POSIZIONE DI PADRE E FIGLI SULLE CPU (il padre si lega subito, i figli all'avvio)
+	if(affinita!=NULL){
+		cpu=(int *)malloc((capacita+1)*sizeof(int));
+		nodo=(int *)malloc((capacita+1)*sizeof(int));
+		if(cpu==NULL || nodo==NULL || (nodi=affinita_piano(affinita, capacita, cpu, nodo))==-1){
+			write(STDOUT, "Affinita' non valida\n", strlen("Affinita' non valida\n"));
 			exit(1);
 		}
-		if(buf=='\n')
-			righe++;
+		if(affinita_applica(cpu[0])==-1)
+			write(STDOUT, "Impossibile legare il padre alla sua CPU\n", strlen("Impossibile legare il padre alla sua CPU\n"));
+		sprintf(stampa, "Affinita': %s, padre sulla CPU %d, %d nodi NUMA%s\n", affinita, cpu[0], nodi, (nodi>1) ? ", code dei figli sul loro nodo" : "");
+		write(STDOUT, stampa, strlen(stampa));
 	}
-	// riposiziono il cursore ad inizio file
-	lseek(fd, 0, 0);
-	
-	
-//LETTURA DEL NUMERO DI PROCESSI DA CREARE
-	do{
-		r=read(fd, &buf, 1);
-		buffer[i]=buf;
-		if(r==-1){
-			write(STDOUT, "Errore in lettura del file\n", strlen("Errore in lettura del file\n"));
+
+	//PUNTO DI RIPRESA (la tabella dei valori della regione conserva 2*finestra risultati, vedi arena_crea())
+	if(con_ripresa){
+		nome_ripresa=(char *)malloc(strlen(nome_uscita)+strlen(".ripresa")+1);
+		if(nome_ripresa==NULL){
+			write(STDOUT, "Allocazione fallita\n", strlen("Allocazione fallita\n"));
 			exit(1);
 		}
-		if(r==0){
-			write(STDOUT, "File vuoto\n", strlen("File vuoto\n"));
-			exit(1);
+		sprintf(nome_ripresa, "%s.ripresa", nome_uscita);
+		switch(ripresa_apri(&rp, nome_ripresa, p.fd, uscita_binaria, (unsigned)finestra, 2*(unsigned)finestra, intervallo, riprendi)){
+			case -1:
+				write(STDOUT, "Errore nel file di ripresa (il file delle operazioni deve essere un file regolare)\n", strlen("Errore nel file di ripresa (il file delle operazioni deve essere un file regolare)\n"));
+				exit(1);
+			case -2:
+				write(STDOUT, "Il punto di ripresa e' di un altro file delle operazioni (o di un altro formato dei risultati)\n", strlen("Il punto di ripresa e' di un altro file delle operazioni (o di un altro formato dei risultati)\n"));
+				exit(1);
+		}
+		if(rp.ripreso.generazione>0){
+			if(parser_riprendi(&p, rp.ripreso.posizione, rp.ripreso.riga, (int)rp.ripreso.consegnati)==-1){
+				write(STDOUT, "Il file delle operazioni non arriva al punto di ripresa\n", strlen("Il file delle operazioni non arriva al punto di ripresa\n"));
+				exit(1);
+			}
+			sprintf(stampa, "Ripresa dopo %llu operazioni gia' svolte (riga %d)\n", (unsigned long long)rp.ripreso.consegnati, rp.ripreso.riga);
+			write(STDOUT, stampa, strlen(stampa));
 		}
-		i++;
+		else if(riprendi)
+			write(STDOUT, "Nessun punto di ripresa: la simulazione parte dall'inizio\n", strlen("Nessun punto di ripresa: la simulazione parte dall'inizio\n"));
 	}
-	while(buf!='\n');
-	NUM_PROC=calcolo_char(buffer, i-1);
 
-	if (NUM_PROC < 1){
-		write(STDOUT, "Numero processi inferiore a 1\n", strlen("Numero processi inferiore a 1\n"));
+	//CREAZIONE DEL FILE DEI RISULTATI (scritto man mano che i risultati vengono consegnati)
+	if(percorso!=NULL)
+		fd=-1;		//il servizio scrive i risultati sui socket dei client
+	else if(con_ripresa && rp.ripreso.generazione>0){
+		//i risultati oltre il punto di ripresa (scritti dopo l'ultimo punto) vengono scartati
+		if((fd=open(nome_uscita, O_WRONLY))==-1 || fstat(fd, &st)==-1 || st.st_size<rp.ripreso.dim_uscita || ftruncate(fd, rp.ripreso.dim_uscita)==-1 || lseek(fd, rp.ripreso.dim_uscita, SEEK_SET)==-1){
+			write(STDOUT, "Il file dei risultati non contiene i risultati del punto di ripresa\n", strlen("Il file dei risultati non contiene i risultati del punto di ripresa\n"));
+			exit(1);
+		}
+	}
+	else if(fd==-1 && (fd=creat(nome_uscita, 0777))==-1){
+		write(STDOUT, "Errore in apertura del file dei risultati\n", strlen("Errore in apertura del file dei risultati\n"));
+		exit(1);
+	}
+	//il file ripreso ha gia' l'intestazione binaria
+	if(percorso==NULL && uscita_apri(&u, fd, uscita_binaria, con_ripresa && rp.ripreso.generazione>0)==-1){
+		write(STDOUT, "Allocazione del buffer dei risultati fallita\n", strlen("Allocazione del buffer dei risultati fallita\n"));
 		exit(1);
 	}
+	if(con_ripresa)
+		rp.u=&u;
 	
 //###############################################################################################//
-//						MEMORIA CONDIVISA	    			 //
+//					SEMAFORI						 //
 //###############################################################################################//
 ///
 ///Breve schema riguardante lo svolgimento del programma
 ///
-///1- Creazione della memoria condivisa
-	share_mem * memoria[NUM_PROC];
-	int shm_id[NUM_PROC];
-	int memkey;
-	
-	for(j=0; j<NUM_PROC; j++){
-		memkey = ftok("father.c", j);
-		if((shm_id[j] = shmget(memkey, sizeof(share_mem), IPC_CREAT|0666))==-1){
-			write(STDOUT, "Allocazione memoria condivisa fallita\n", strlen("Allocazione memoria condivisa fallita\n"));
-        		exit(1);
-    		}
-    		//attacco la memoria alla zona dati del padre (verrà ereditata anche dai figli una volta creati)
-    		if((memoria[j] = shmat(shm_id[j], NULL, 0))==(share_mem *)-1){
-    			write(STDOUT, "Memoria non attaccata\n", strlen("Memoria non attaccata\n"));
-        		exit(1);
-        	}
-    	}
+///1- Creazione dell'array dei semafori
+	int semaforo=-1;
+	int semkey;
+	bool rimosso;		//rimosso un array di semafori lasciato da un'esecuzione interrotta
+
+	//con le futex non serve alcun semaforo: padre e figli dormono sulla memoria condivisa
+	if(sincronizzazione==SYNC_SYSV){
+		semkey = ftok("father.c", capacita);
+		
+		// Semaforo j=figlio j+1 (attende operazioni)	Semaforo capacita=padre (attende risultati)
+		//tutti i semafori partono da 0: vengono incrementati solo per svegliare chi dorme
+		if((semaforo = semaforo_crea(semkey, capacita+1, &rimosso))==-1){
+			write(STDOUT, "Creazione semaforo non riuscita\n", strlen("Creazione semaforo non riuscita\n"));
+	       		exit(1);
+		}
+		if(rimosso)
+			write(STDOUT, "Rimossi i semafori lasciati da un'esecuzione interrotta\n", strlen("Rimossi i semafori lasciati da un'esecuzione interrotta\n"));
+	    	
+	    	write(STDOUT, "Semafori creati correttamente\n\n", strlen("Semafori creati correttamente\n\n"));
+	}
     	
-    	write(STDOUT, "\nMemoria condivisa allocata e attaccata correttamente\n\n", strlen("\nMemoria condivisa allocata e attaccata correttamente\n\n"));
-	
 //###############################################################################################//
-//					SEMAFORI						 //
+//						MEMORIA CONDIVISA	    			 //
 //###############################################################################################//
-///2- Creazione dell'array dei semafori
-    	// creo lo spazio per 2 operazioni sull'array di semafori
-    	struct sembuf * sops = (struct sembuf *) malloc (2*sizeof(struct sembuf));
-    
-	int semaforo;
-	int semkey;
-
-	semkey = ftok("father.c", j);
+///2- Creazione della memoria condivisa
+	arena *regione;
 	
-	// Semafori dispari=padre	Semafori pari=figli
-	if((semaforo = semget(semkey, (2*NUM_PROC)+1, IPC_CREAT | IPC_EXCL | 0666))==-1){
-		write(STDOUT, "Creazione semaforo non riuscita\n", strlen("Creazione semaforo non riuscita\n"));
-       		exit(1);
+	//un'unica regione anonima per tutti i figli, con le code di ciascuno: nessun segmento lasciato indietro in caso di crash
+	//con un solo nodo NUMA non c'e' nulla da scegliere: la regione resta compatta
+	if((regione=arena_crea(capacita, profondita, (unsigned)finestra, sincronizzazione, semaforo, &costi, (nodi>1) ? nodo+1 : NULL))==NULL){
+		write(STDOUT, "Allocazione memoria condivisa fallita\n", strlen("Allocazione memoria condivisa fallita\n"));
+		if(semaforo!=-1)
+			semctl(semaforo, 0, IPC_RMID, 0);
+		exit(1);
 	}
-	
-	//inizializzo a 1 i semafori dei figli che attenderanno di essere sbloccati dal padre quando passerà loro i calcoli da svolgere
-	for(j=0; j<NUM_PROC; j++){
-		sops[0].sem_num = 2*j;
-    		sops[0].sem_op = 1;
-    		sops[0].sem_flg = 0;
-    		semop(semaforo, sops, 1);
+	regione->furto=furto;
+	for(i=0; cpu!=NULL && i<capacita; i++)
+		regione->slot[i].cpu=cpu[i+1];
+	free(cpu);
+	free(nodo);
+	regione->verboso=!silenzioso;
+	//gli anelli della traccia vanno creati prima dei figli, che li ereditano
+	if(nome_traccia!=NULL && traccia_crea(regione)==-1){
+		write(STDOUT, "Allocazione della traccia fallita\n", strlen("Allocazione della traccia fallita\n"));
+		exit(1);
+	}
+	//anche la cache dei risultati
+	if(memo>0 && memo_crea(regione, (unsigned)memo)==-1){
+		write(STDOUT, "Allocazione della cache dei risultati fallita\n", strlen("Allocazione della cache dei risultati fallita\n"));
+		exit(1);
 	}
-	
-	//semaforo intero inizializzato a NUM_PROC per controllare se ci sono figli liberi (inizialmente tutti liberi)
-	sops[0].sem_num = 2*NUM_PROC;
-    	sops[0].sem_op = NUM_PROC;
-    	sops[0].sem_flg = 0;
-    	semop(semaforo, sops, 1);
-    	
-    	write(STDOUT, "Semafori creati correttamente\n\n", strlen("Semafori creati correttamente\n\n"));
     	
-    		
+    	write(STDOUT, "\nMemoria condivisa allocata e attaccata correttamente\n\n", strlen("\nMemoria condivisa allocata e attaccata correttamente\n\n"));
 	
 //###############################################################################################//
 //					CREAZIONE DEI PROCESSI FIGLI				 //
 //###############################################################################################//
 ///3- Creazione dei processi figli
 	
-	int id=0;
-	pid_t processi[NUM_PROC];
-	//solo il padre deve continuare a rimanere nel ciclo (i figli non devono fare fork());
-	for(i=0; i<NUM_PROC; i++){
-		processi[i]=fork();
-		if(processi[i]<0){		//fork() fallita
-			write(STDOUT, "Fork fallita\n", strlen("Fork fallita\n"));
-			exit(1);
-		}
-		//assegno un ID=i+1 a ciascun figlio i. Il padre sarà l'unico ad avere ID=0. Il figlio poi esce dal ciclo.
-		else if(processi[i]==0){
-			id=i+1;
-			break;
-		}
-		else{		//codice del padre
-			sprintf(stampa, "\tPADRE: figlio %d creato correttamente\n", i+1);
-			write(STDOUT, stampa, strlen(stampa));
-		}
-	}	//fine ciclo for, figli creati correttamente
-	
-	int val, op1, op2;	//processo che svolgerà l'operazione e operandi
-	char oper1[BUFLEN];	//buffer per la lettura del primo operando
-	char oper2[BUFLEN];	//buffer per la lettura del secondo operando
-	char res[BUFLEN];	//buffer per la lettura del risultato dell'operazione
-	char calc;		//operazione da svolgere
-	int counter=0;		//contatore per l'array dei risultati
-	char *risultati[righe];	//array dei risultati
-	
-	//allocazione della memoria per l'array dei risultati
-	for(j=0; j<righe; j++)
-		risultati[j]=(char *)malloc(32*sizeof(char));
-		
-		
+	vivaio v;
+
+	clock_gettime(CLOCK_MONOTONIC, &avvio);
+	memset(&v, 0, sizeof(v));
+	v.a=regione;
+	v.backend=backend;
+	v.servizio=(percorso!=NULL);
+	v.silenzioso=silenzioso;
+	v.vivo=(bool *)calloc(capacita, sizeof(bool));
+	if(backend==BACKEND_THREAD){
+		v.thread=(pthread_t *)malloc(capacita*sizeof(pthread_t));
+		v.argomenti=(figlio_thread *)malloc(capacita*sizeof(figlio_thread));
+		pthread_attr_init(&v.attributi);
+		pthread_attr_setstacksize(&v.attributi, 1<<18);
+	}
+	else
+		v.processi=(pid_t *)malloc(capacita*sizeof(pid_t));
+	if(v.vivo==NULL || (backend==BACKEND_THREAD && (v.thread==NULL || v.argomenti==NULL)) || (backend==BACKEND_PROCESSI && v.processi==NULL)){
+		write(STDOUT, "Allocazione dei figli fallita\n", strlen("Allocazione dei figli fallita\n"));
+		exit(1);
+	}
+	//solo il padre crea i figli (i figli non devono fare fork()); con -E si parte dal minimo
+	for(i=0; i<iniziali; i++)
+		avvia_figlio(&v, i);
+	clock_gettime(CLOCK_MONOTONIC, &inizio);
+	sprintf(stampa, "\tPADRE: %d figli (%s) avviati in %.6f s\n", iniziali, (backend==BACKEND_THREAD) ? "thread" : "processi", (inizio.tv_sec-avvio.tv_sec)+(inizio.tv_nsec-avvio.tv_nsec)*1e-9);
+	write(STDOUT, stampa, strlen(stampa));
 	
 //###############################################################################################//
 //					PADRE (ID=0)						 //
 //###############################################################################################//
-///4- Assegnazione ai figli delle operazioni da svolgere
+///5- Assegnazione ai figli delle operazioni da svolgere
 	
-	if(id==0){
-		int space=0;	//contatore per gli spazi tra campi dell'operazione da svolgere
-		do{
-			i=0;	//contatore per il buffer di lettura
-			space=0;
-			do{
-				r=read(fd, &buf, 1);
-				if(r==-1){
-					write(STDOUT, "Errore in lettura del file\n", strlen("Errore in lettura del file\n"));
-					exit(1);
-				}
-
-				//controllo se sono alla fine del file (doppio \n)
-				if(space==0 && buf=='\n')
-					break;
-				
-				if(buf=='\n'){
-					op2=calcolo_char(buffer, i);
-					i=0;
-				}
-
-				// verifico se c'è uno spazio
-				if(buf!=' '){
-					buffer[i]=buf;
-					i++;
-				}
-				else{
-					switch(space){
-						case 0:	//al primo spazio sto leggendo il numero del processo
-							val=calcolo_char(buffer, i);
-							break;
-						case 1:	//al secondo spazio sto leggendo il primo operando
-							op1=calcolo_char(buffer, i);
-							break;
-						case 2:	//al terzo spazio sto leggendo il calcolo da eseguire
-							calc=buffer[0];
-							break;			
-						default://al quarto spazio sto leggendo il secondo operando (già letto sopra)
-							break;
-					}
-					i=0;
-					space++;
-				}
-			} while(buf!='\n' && r>0);
-			
-			//se sono alla fine del file (doppio \n) interrompo il ciclo
-			if(space==0 && buf=='\n')
-				break;
-			
-			//verifico che ci siano figli liberi (decremento semaforo intero)
-			sops[0].sem_num = 2*NUM_PROC;
-    			sops[0].sem_op = -1;
-    			sops[0].sem_flg = 0;
-    			semop(semaforo, sops, 1);
-    			
-    			//ricerca del primo processo libero se VAL=0
-    			if (val==0){	//verifico il primo processo libero guardando i valori dei semafori (con il flag IPC_NOWAIT)
-    				for(j=0; j<NUM_PROC; j++){
-	    				sops[0].sem_num = (2*j)+1;
-	    				sops[0].sem_op = 0;
-	    				sops[0].sem_flg = IPC_NOWAIT;
-	    				if (semop(semaforo, sops, 1) != -1)
-	    					break;
-	    			}
-	    			val=j+1;
-	    			
-	    			sprintf(stampa, "\tPADRE: ho cercato un processo libero. Ho trovato %d\n", val);
-				write(STDOUT, stampa, strlen(stampa));
-    			}	
-			
-			sprintf(stampa, "\tPADRE: assegno il calcolo %d%c%d al figlio %d\n", op1, calc, op2, val);
-			write(STDOUT, stampa, strlen(stampa));
-			
-			//attendo che il figlio abbia finito di calcolare eventuali operazioni precedenti
-			sops[0].sem_num = 2*(val-1)+1;
-			sops[0].sem_op = 0;
-			sops[0].sem_flg = 0;
-			sops[1].sem_num = 2*(val-1)+1;
-			sops[1].sem_op = 1;  		// mette a 1 il suo semaforo così non rientra subito
-			sops[1].sem_flg = 0;
-			semop(semaforo, sops, 2);
-	
-			
-			//se il figlio ha già fatto dei calcoli, prelevo il risultato
-			if(memoria[val-1]->finish==true){
-				itoa(memoria[val-1]->res, res);
-				itoa(memoria[val-1]->val1, oper1);
-				itoa(memoria[val-1]->val2, oper2);
-	
-				strcat(risultati[counter], oper1);
-				strcat(risultati[counter], &(memoria[val-1]->op));
-				strcat(risultati[counter], oper2);
-				strcat(risultati[counter], "=");
-				strcat(risultati[counter], res);
-				strcat(risultati[counter], "\n");
-				counter++;
-				memoria[val-1]->finish=false;
-				
-				sprintf(stampa, "\tPADRE: ho prelevato il risultato: %d%c%d=%d del figlio %d\n", memoria[val-1]->val1, memoria[val-1]->op, memoria[val-1]->val2, memoria[val-1]->res, val);
-				write(STDOUT, stampa, strlen(stampa));
-				sprintf(stampa, "\tPADRE: assegno il calcolo %d%c%d al figlio %d\n", op1, calc, op2, val);
-				write(STDOUT, stampa, strlen(stampa));
-			}
-			
-			//passo operandi e operazione al figlio
-			memoria[val-1]->val1=op1;
-			memoria[val-1]->op=calc;
-			memoria[val-1]->val2=op2;
-			
-			//libero il figlio che era in attesa sul semaforo
-			sops[0].sem_num = 2*(val-1);  	// semaforo val-1
-        		sops[0].sem_op = -1;
-		        sops[0].sem_flg = 0;
-        		semop(semaforo, sops, 1);
-        		
-		} while(r>0);
+	clock_gettime(CLOCK_MONOTONIC, &inizio);
+	if(con_ripresa)
+		disp_init(&d, regione, (unsigned)finestra, salva_con_ripresa, &rp);
+	else
+		disp_init(&d, regione, (unsigned)finestra, salva_risultato, &u);
+	if(con_ripresa && rp.ripreso.generazione>0){
+		//le operazioni gia' svolte mantengono il loro numero d'ordine, e i loro risultati servono ai riferimenti $N
+		disp_riprendi(&d, rp.ripreso.consegnati);
+		for(seq=(rp.ripreso.consegnati>regione->num_valori) ? rp.ripreso.consegnati-regione->num_valori : 0; seq<rp.ripreso.consegnati; seq++)
+			arena_scrivi_valore(regione, seq, rp.valori[seq%rp.num_valori]);
+	}
+	d.politica=politica;
+	d.furto=furto;
+	d.verboso=!silenzioso;
+	if(elastico!=NULL)
+		disp_elastico(&d, minimo, timeout*1000000ULL, profondita, avvia_figlio, &v);
+	stat_installa(&d);
+	if(percorso!=NULL){
+		//servizio: le operazioni arrivano dai client finche' non arriva SIGTERM o SIGINT
+		if(servizio_esegui(&d, percorso)==-1)
+			write(STDOUT, "Il servizio non e' stato avviato\n", strlen("Il servizio non e' stato avviato\n"));
 	}
-	
-//###############################################################################################//
-//					FIGLI							 //
-//###############################################################################################//
-///5- Svolgimento delle operazioni da parte dei figli
-	
 	else{
-		//i figli non usciranno mai da questo while fino alla terminazione
-		//il codice successivo al while è visibile solo dal padre
-		while(true){
-			
-			sops[0].sem_num = 2*(id-1);
-        		sops[0].sem_op = 0;  		// attende che il semaforo valga zero
-        		sops[0].sem_flg = 0;
-        		sops[1].sem_num = 2*(id-1);
-        		sops[1].sem_op = 1;		// mette a 1 il suo semaforo così non rientra subito
-        		sops[1].sem_flg = 0;
-        		semop(semaforo, sops, 2);
-
-			sleep(1);
-			
-			//lettura di operazione e operandi
-			op1=memoria[id-1]->val1;
-			calc=memoria[id-1]->op;
-			op2=memoria[id-1]->val2;
-			
-			//svolgimento del calcolo o terminazione in caso di calc='K'
-			switch(calc){
-				case '+':
-					memoria[id-1]->res=op1+op2;
-					break;
-				case '-':
-					memoria[id-1]->res=op1-op2;
-					break;
-				case '*':
-					memoria[id-1]->res=op1*op2;
-					break;
-				case '/':
-					memoria[id-1]->res=op1/op2;
-					break;
-				case 'K':
-					sprintf(stampa, "Figlio %d: TERMINO\n", id);
-					write(STDOUT, stampa, strlen(stampa));
-					exit(0);
-				default:
-					write(STDOUT, "Operazione non consentita\n", strlen("Operazione non consentita\n"));
+		//mentre si attendono nuove operazioni (pipe o terminale) si consegnano i risultati pronti
+		ai.d=&d;
+		ai.u=&u;
+		p.attesa=attendi_input;
+		p.ctx=&ai;
+		if(soglia>0 && uscita_asincrona(&u, (size_t)soglia<<10, politica_fsync)==-1)
+			write(STDOUT, "Scrittura asincrona non disponibile: i risultati li scrive il padre\n", strlen("Scrittura asincrona non disponibile: i risultati li scrive il padre\n"));
+		if(lettori>0){
+			if(parser_parallelo(&p, lettori)==-1)
+				write(STDOUT, "Lettura parallela non disponibile (serve un file di testo regolare): lettura normale\n", strlen("Lettura parallela non disponibile (serve un file di testo regolare): lettura normale\n"));
+			else if(!silenzioso){
+				sprintf(stampa, "\tPADRE: lettura del file con %d thread\n", lettori);
+				write(STDOUT, stampa, strlen(stampa));
 			}
-			memoria[id-1]->finish=true;
-			sprintf(stampa, "Figlio %d: ho svolto il calcolo %d%c%d=%d\n", id, op1, calc, op2, memoria[id-1]->res);
-			write(STDOUT, stampa, strlen(stampa));
-			
-			//segnala al padre il termine delle sue operazioni
-			sops[0].sem_num = 2*(id-1)+1;
-        		sops[0].sem_op = -1;
-		        sops[0].sem_flg = 0;
-        		semop(semaforo, sops, 1);
-        		
-        		//incremento il semaforo intero perchè c'è un altro figlio libero dopo il calcolo
-        		sops[0].sem_num = 2*NUM_PROC;
-    			sops[0].sem_op = 1;
-    			sops[0].sem_flg = 0;
-    			semop(semaforo, sops, 1);
-			
 		}
+		for(t0=TRACCIA_ORA(regione); (letto=parser_prossimo(&p, &l))==1; t0=TRACCIA_ORA(regione)){
+			TRACCIA(regione, 0, TR_LETTURA, t0, 0);
+			if(con_ripresa){
+				//il posto dell'operazione nella finestra si libera quando quella di finestra operazioni prima e' consegnata
+				while(d.inviati-d.consegnati>=d.finestra)
+					disp_raccogli(&d, true);
+				ripresa_segna(&rp, d.inviati, parser_posizione(&p), l.riga);
+			}
+			//un riferimento che il distributore non puo' risolvere interrompe la lettura, come nel parser
+			if(disp_invia(&d, &l)==-1){
+				letto=-1;
+				break;
+			}
+		}
+		parser_chiudi(&p);
 	}
 	
 //###############################################################################################//
@@ -413,171 +877,89 @@ void main (void){
 //###############################################################################################//
 ///6- Prelievo dei risultati, salvataggio su file e invio del segnale di terminazione
 	
-	//il padre attenderà la terminazione dei calcoli da parte di ogni figlio per andare poi a prelevare i risultati
-	for(j=0; j<NUM_PROC; j++){
-		sops[0].sem_num = 2*NUM_PROC;	// P semaforo intero
-    		sops[0].sem_op = -1;
-    		sops[0].sem_flg = 0;
-    		semop(semaforo, sops, 1);
-			
-		sops[0].sem_num = 2*(j)+1;
-		sops[0].sem_op = 0;  		// attende che il semaforo valga zero (figlio termina i calcoli)
-		sops[0].sem_flg = 0;
-		sops[1].sem_num = 2*(j)+1;
-		sops[1].sem_op = 1;  		// mette a 1 il suo semaforo così non rientra subito
-		sops[1].sem_flg = 0;
-		semop(semaforo, sops, 2);
-	
-			
-		//controllo se il figlio ha svolto operazioni delle quali non ho ancora prelevato il risultato, in tal caso lo prelevo
-		if(memoria[j]->finish==true){	
-			itoa(memoria[j]->res, res);
-			itoa(memoria[j]->val1, oper1);
-			itoa(memoria[j]->val2, oper2);
-
-			strcat(risultati[counter], oper1);
-			strcat(risultati[counter], &(memoria[j]->op));
-			strcat(risultati[counter], oper2);
-			strcat(risultati[counter], "=");
-			strcat(risultati[counter], res);
-			strcat(risultati[counter], "\n");
-			counter++;
-			memoria[j]->finish=false;
-			
-			sprintf(stampa, "\tPADRE: ho prelevato il risultato: %s del figlio %d e gli invio il segnale di terminazione\n", risultati[counter-1], val);
-			write(STDOUT, stampa, strlen(stampa));
-		}
-		//invio del segnale di terminazione tramite memoria condivisa
-		memoria[j]->op='K';
-	
-		//libera il figlio che andrà a leggere il segnale K e terminerà
-		sops[0].sem_num = 2*(j);
-        	sops[0].sem_op = -1;
-	        sops[0].sem_flg = 0;
-        	semop(semaforo, sops, 1);
-       
-	}	
+	//il padre attende che i figli abbiano svolto tutte le operazioni in coda, prelevando i risultati
+	disp_svuota(&d);
+	//invio del segnale di terminazione tramite le code dei figli
+	disp_termina(&d);
 		
-///7- Attesa della terminazione di ciascun figlio
-	for(j=0; j<NUM_PROC; j++)
-		wait(NULL);
+///7- Attesa della terminazione di ciascun figlio (anche di quelli ritirati e non ancora attesi)
+	for(j=0; j<capacita; j++)
+		attendi_figlio(&v, j);
+	clock_gettime(CLOCK_MONOTONIC, &fine);
+	if(backend==BACKEND_THREAD)
+		pthread_attr_destroy(&v.attributi);
+	free(v.thread);
+	free(v.argomenti);
+	free(v.processi);
+	free(v.vivo);
 	write(STDOUT, "\tPADRE: i figlio sono tutti terminati\n", strlen("\tPADRE: i figlio sono tutti terminati\n"));
+
+	//il tempo simulato della macchina parallela e' quello del figlio che ha lavorato di piu'
+	for(j=0; j<capacita; j++)
+		if(regione->slot[j].tempo_simulato>simulato)
+			simulato=regione->slot[j].tempo_simulato;
+	sprintf(stampa, "\tPADRE: tempo simulato %.9f s, tempo reale %.9f s\n", simulato*1e-9, (fine.tv_sec-inizio.tv_sec)+(fine.tv_nsec-inizio.tv_nsec)*1e-9);
+	write(STDOUT, stampa, strlen(stampa));
+	if(percorso==NULL && p.errori>0){
+		sprintf(stampa, "\tPADRE: %d righe malformate scartate\n", p.errori);
+		write(STDOUT, stampa, strlen(stampa));
+	}
+	if(letto==-1)
+		write(STDOUT, "\tPADRE: lettura delle operazioni interrotta: i risultati sono incompleti\n", strlen("\tPADRE: lettura delle operazioni interrotta: i risultati sono incompleti\n"));
+	if(memo>0){
+		sprintf(stampa, "\tPADRE: cache dei risultati: %llu operazioni trovate, %llu non trovate (%.1f%%)\n", d.memo_successi, d.memo_mancati, (d.memo_successi+d.memo_mancati>0) ? 100.0*d.memo_successi/(d.memo_successi+d.memo_mancati) : 0.0);
+		write(STDOUT, stampa, strlen(stampa));
+	}
+	if(percorso==NULL && u.as!=NULL){
+		//i risultati restanti vengono scritti subito, per contare anche l'ultimo blocco
+		uscita_svuota(&u);
+		sprintf(stampa, "\tPADRE: scrittura asincrona: %llu blocchi scritti, %.3f ms di attesa del padre\n", u.as->blocchi, u.as->ns_attesa*1e-6);
+		write(STDOUT, stampa, strlen(stampa));
+	}
+	stat_stampa(&d);
+	disp_chiudi(&d);
+	if(nome_traccia!=NULL){
+		if((persi=traccia_scrivi(regione, nome_traccia))==-1)
+			write(STDOUT, "Errore in scrittura della traccia\n", strlen("Errore in scrittura della traccia\n"));
+		else{
+			sprintf(stampa, "\tPADRE: traccia scritta su %s (%lld eventi piu' vecchi sovrascritti)\n", nome_traccia, persi);
+			write(STDOUT, stampa, strlen(stampa));
+		}
+		traccia_distruggi(regione);
+	}
+	memo_distruggi(regione);
 		
-	//padre stacca la memoria condivisa dalla sua zona dati
-	for(j=0; j<NUM_PROC; j++)
-		shmdt(memoria[j]);
+	//padre stacca la memoria condivisa dalla sua zona dati (la regione anonima viene cosi' rimossa)
+	arena_distruggi(regione);
 	write(STDOUT, "\tPADRE: memoria staccata\n", strlen("\tPADRE: memoria staccata\n"));
 		
-	//STAMPA DEI RISULTATI SU FILE
-	file_name="Risultati.txt";	//nome del file da creare
-	fd=creat(file_name, 0777);	//creazione del file
-	if(fd==-1){
-		write(STDOUT, "Errore in apertura del file\n", strlen("Errore in apertura del file\n"));
-		exit(1);
+	//i risultati sono gia' stati scritti man mano: resta da svuotare il buffer (il servizio ha gia' chiuso i socket dei client)
+	if(percorso==NULL){
+		if(uscita_chiudi(&u)==-1){
+			write(STDOUT, "Errore in scrittura dei risultati\n", strlen("Errore in scrittura dei risultati\n"));
+			//il file di ripresa resta: si puo' riprendere dall'ultimo punto
+			if(con_ripresa)
+				ripresa_chiudi(&rp, false);
+		}
+		else{
+			write(STDOUT, "\tPADRE: risultati scritti su file\n", strlen("\tPADRE: risultati scritti su file\n"));
+			if(con_ripresa){
+				sprintf(stampa, "\tPADRE: %llu punti di ripresa scritti, %s %s\n", rp.scritti, nome_ripresa, (letto!=-1) ? "rimosso" : "conservato");
+				write(STDOUT, stampa, strlen(stampa));
+				ripresa_chiudi(&rp, letto!=-1);
+			}
+		}
+		free(nome_ripresa);
 	}
-	//scrittura su file di ciascuna entry dell'array dei risultati
-	for(j=0; j<righe; j++)
-		write(fd, risultati[j], strlen(risultati[j]));
-	write(STDOUT, "\tPADRE: risultati scritti su file\n", strlen("\tPADRE: risultati scritti su file\n"));
-	
-	//eliminazione memoria condivisa
-	for(j=0; j<NUM_PROC; j++)
-        	if (shmctl(shm_id[j], IPC_RMID, NULL) == -1)
-            		write(STDOUT, "Non posso rimuovere la memorica condivisa\n", strlen("Non posso rimuovere la memorica condivisa\n"));
-	write(STDOUT, "\tPADRE: memoria condivisa rimossa\n", strlen("\tPADRE: memoria condivisa rimossa\n"));
 
         //rimozione dei semafori
-	if (semctl(semaforo, 0, IPC_RMID, 0) == -1)
-		write(STDOUT, "I semafori non sono stati rimossi\n", strlen("I semafori non sono stati rimossi\n"));
-	write(STDOUT, "\tPADRE: semafori rimossi\n", strlen("\tPADRE: semafori rimossi\n"));
-		
-	//libero la memoria allocata per l'array dei risultati e per le 2 operazioni sull'array dei semafori
-	free(sops);
-	for(j=0; j<righe; j++)
-		free(risultati[j]);
+	if(semaforo!=-1){
+		if (semctl(semaforo, 0, IPC_RMID, 0) == -1)
+			write(STDOUT, "I semafori non sono stati rimossi\n", strlen("I semafori non sono stati rimossi\n"));
+		write(STDOUT, "\tPADRE: semafori rimossi\n", strlen("\tPADRE: semafori rimossi\n"));
+	}
         
 ///8- Terminazione del padre
         write(STDOUT, "\tPADRE: Termino anche io!\n", strlen("\tPADRE: Termino anche io!\n"));
-	exit(0);
+	exit((letto==-1) ? 1 : 0);
 }
-
-
-
-
-
-/**
- * @brief Funzione che riceve come input un array di cifre in char e ritorna il corrispondente intero.
- *La funzione trasforma ciascun char dell'array in intero e attraverso la moltiplicazione del 10
- *restituisce il rispettivo valore intero
- *
- * @param array[]	array di char
- * @param i		contatore dell'array di char
- * @return 		valore intero corrispondente alle cifre espresse in char nell'array ricevuto come input
-*/
-	
-int calcolo_char(char array[], int i){
-
-	int j, t, k, res=0;	//contatori e risultato
-	int s=i;
-	for(j=0; j<i; j++){
-		t=(array[j]-'0');
-		for(k=s-1; k>0; k--)
-			t=t*10;
-		s--;
-		res+=t;
-	}
-	return res;
-}
-
-/**
- * @brief Funzione che riceve come input un valore intero e salva nella stringa ricevuta come input il corrispondente array di char.
- *
- *	La funzione trasforma il valore intero e attraverso la moltiplicazione del 10 e la chiamata
- *	alla funzione "reverse" restituisce il rispettivo array di char.
- *
- * @param n		valore intero
- * @param s[]		array di char nel quale verrà salvato il risultato
- *
-*/
-
-void itoa(int n, char s[]){
-	int i, sign;
-	if((sign=n)<0)
-		n=-n;
-	i=0;
-	do{
-		s[i++]=n%10+'0';
-	}while((n/=10)>0);
-	if(sign<0)
-		s[i++]='-';
-	s[i]='\0';
-	reverse(s);
-}
-
-/**
- * @brief Funzione che riceve come input un array di char e lo modifica invertendo la posizione dei caratteri.
- *
- *	La funzione fa uso di una variabile ausiliaria per poter scambiare la posizione dei char e ottenere
- *	così la stringa invertita.
- *
- * @param s[]		array di char che verrà invertita
-*/
-
-void reverse(char s[]){
-	int i, j;
-	char c;
-	for(i=0, j=strlen(s)-1; i<j; i++, j--){
-		c=s[i];
-		s[i]=s[j];
-		s[j]=c;
-	}
-}
-
-
-
-
-
-
-
-
-
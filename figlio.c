@@ -0,0 +1,275 @@
+/**
+ * @file figlio.c
+ * @author Marco Colognese
+*/
+
+#include "mylib.h"
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sched.h>
+
+/**
+ * @brief Funzione che svolge un lotto di operazioni e ne deposita i risultati nella coda dei risultati del figlio.
+ *
+ *	I calcoli del lotto sono svolti insieme da kernel_lotto(), raggruppati per operatore. Il costo
+ *	di ogni operazione e' estratto dal modello di costo della regione e sommato al tempo simulato
+ *	del figlio; solo con il modello "reale" il figlio attende davvero il costo dell'intero lotto.
+ *	Il padre viene svegliato una sola volta, dopo aver depositato tutti i risultati.
+ *
+ * @param a		regione condivisa
+ * @param id		numero del figlio
+ * @param l		operazioni da svolgere
+ * @param n		numero di operazioni (al piu' LOTTO)
+ * @param seme		stato del generatore casuale del figlio
+*/
+
+static void svolgi(arena *a, int id, const lavoro *l, int n, unsigned long long *seme){
+	share_mem *m=&a->slot[id-1];
+	char stampa[256];	//array di char per le stampe di sprintf
+	int res[LOTTO];		//risultati del lotto
+	risultato r;		//risultato da restituire
+	long long ns=0;		//costo del lotto
+	long long c;		//costo di un'operazione
+	int i;
+
+	for(i=0; i<n; i++){
+		c=costo_campiona(&a->costi, l[i].op, seme);
+		m->tempo_simulato+=c;
+		ns+=c;
+	}
+	if(a->costi.reale && ns>0)
+		costo_attendi(ns);
+
+	//svolgimento dei calcoli
+	kernel_lotto(l, res, n);
+
+	for(i=0; i<n; i++){
+		r.riga=l[i].riga;
+		r.id=l[i].id;
+		r.val1=l[i].val1;
+		r.op=l[i].op;
+		r.val2=l[i].val2;
+		r.res=res[i];
+		r.figlio=id;
+		r.seq=l[i].seq;
+		if(costo_indice(r.op)==-1)
+			write(STDOUT, "Operazione non consentita\n", strlen("Operazione non consentita\n"));
+		else if(r.op=='/' && r.val2==0){
+			sprintf(stampa, "Figlio %d: divisione per zero nel calcolo %d/%d, il risultato vale 0\n", id, r.val1, r.val2);
+			write(STDOUT, stampa, strlen(stampa));
+		}
+		if(a->verboso){
+			sprintf(stampa, "Figlio %d: ho svolto il calcolo %d%c%d=%d\n", id, r.val1, r.op, r.val2, r.res);
+			write(STDOUT, stampa, strlen(stampa));
+		}
+		//restituisco il risultato, pubblicandolo prima nella tabella dei valori per chi ne dipende
+		arena_scrivi_valore(a, r.seq, r.res);
+		//le divisioni per zero restano fuori dalla cache, cosi' vengono sempre segnalate
+		if(a->memo!=NULL && !(r.op=='/' && r.val2==0))
+			memo_inserisci(a, r.val1, r.op, r.val2, r.res, (unsigned)r.seq);
+		ring_inserisci(&m->risultati, &r);
+	}
+	//segnalo al padre il termine dei calcoli
+	attesa_sveglia(&a->padre);
+}
+
+/**
+ * @brief Funzione che sostituisce negli operandi di un'operazione i risultati delle operazioni riferite, se sono gia' nella tabella dei valori.
+ *
+ * @param a		regione condivisa
+ * @param l		operazione (gli operandi con un riferimento contengono la distanza dall'operazione riferita)
+ * @return		true se non restano riferimenti aperti
+*/
+
+static bool risolvi_operandi(arena *a, lavoro *l){
+	if((l->rif&RIF_VAL1) && arena_valore(a, l->seq-(unsigned)l->val1, &l->val1))
+		l->rif&=~RIF_VAL1;
+	if((l->rif&RIF_VAL2) && arena_valore(a, l->seq-(unsigned)l->val2, &l->val2))
+		l->rif&=~RIF_VAL2;
+	return l->rif==0;
+}
+
+/**
+ * @brief Funzione che svolge un lotto in cui alcune operazioni possono dipendere da risultati non ancora calcolati.
+ *
+ *	Il padre accoda un'operazione con un riferimento aperto solo dietro a quella da cui dipende,
+ *	nella stessa coda: il risultato e' gia' nella tabella dei valori oppure e' di un'operazione
+ *	precedente dello stesso lotto. In quest'ultimo caso il lotto viene spezzato: si svolge prima
+ *	la parte che precede l'operazione, che cosi' trova il risultato nella tabella. Un'operazione
+ *	non parte mai con un riferimento aperto: se il risultato non e' ancora nella tabella il
+ *	figlio lo attende, invece di calcolare con la distanza al posto dell'operando.
+ *
+ * @param a		regione condivisa
+ * @param id		numero del figlio
+ * @param l		operazioni da svolgere
+ * @param n		numero di operazioni (al piu' LOTTO)
+ * @param seme		stato del generatore casuale del figlio
+*/
+
+static void svolgi_lotto(arena *a, int id, lavoro *l, int n, unsigned long long *seme){
+	int inizio=0, i;
+
+	for(i=0; i<n; i++)
+		if(l[i].rif!=0 && !risolvi_operandi(a, &l[i])){
+			if(i>inizio){
+				svolgi(a, id, l+inizio, i-inizio, seme);
+				inizio=i;
+			}
+			while(!risolvi_operandi(a, &l[i]))
+				sched_yield();
+		}
+	svolgi(a, id, l+inizio, n-inizio, seme);
+}
+
+/**
+ * @brief Funzione che prende un'operazione con id 0 dalla propria coda condivisa o, se vuota, da quella di un altro figlio.
+ *
+ *	Il figlio prende un'operazione condivisa solo se nella sua coda dei risultati ci sono meno di
+ *	profondita risultati non ancora prelevati: l'altra meta' della coda e' riservata alle
+ *	operazioni assegnate dal padre, cosi' l'inserimento del risultato non fallisce mai.
+ *
+ * @param a		regione condivisa
+ * @param id		numero del figlio
+ * @param l		operazione presa
+ * @return		1 se ha preso un'operazione, 0 se non c'e' nulla da prendere, -1 se la coda dei risultati e' troppo piena
+*/
+
+static int prendi_condivisa(arena *a, int id, lavoro *l){
+	share_mem *m=&a->slot[id-1];
+	int k, j;
+
+	if(ring_occupati(&m->risultati)>=a->profondita)
+		return -1;
+	if(spmc_estrai(&m->condivise, l))
+		return 1;
+	//furto: scorro gli altri figli partendo dal successivo
+	for(k=1, j=id; k<a->num_proc; k++, j++){
+		if(j==a->num_proc)
+			j=0;
+		if(spmc_estrai(&a->slot[j].condivise, l))
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Funzione che verifica se in qualche coda condivisa c'e' ancora un'operazione da prendere.
+ *
+ * @param a		regione condivisa
+ * @return		true se almeno una coda condivisa non e' vuota
+*/
+
+static bool lavoro_condiviso(arena *a){
+	int j;
+
+	for(j=0; j<a->num_proc; j++)
+		if(!spmc_vuota(&a->slot[j].condivise))
+			return true;
+	return false;
+}
+
+/**
+ * @brief Funzione eseguita da ciascun figlio: svolge le operazioni ricevute dal padre fino al comando 'K'.
+ *
+ *	Il figlio preleva dalla propria coda di richieste fino a LOTTO operazioni alla volta, le
+ *	svolge insieme senza alcuna system call e deposita i risultati nella propria coda dei
+ *	risultati svegliando il padre se sta aspettando. Con il furto di lavoro abilitato,
+ *	quando la coda delle richieste e' vuota prende le operazioni con id 0 dalla propria coda
+ *	condivisa e poi da quelle degli altri figli, senza passare dal padre. Solo quando non c'e'
+ *	nulla da fare si addormenta sul proprio semaforo. Non serve controllare che la coda dei
+ *	risultati abbia spazio per le operazioni delle richieste: il padre non ne invia mai piu' di
+ *	quante ne possa contenere.
+ *
+ *	Il figlio tiene aggiornato il proprio bit nella bitmap dei figli liberi: lo spegne quando
+ *	riprende a lavorare e lo riaccende quando non ha nulla da fare, prima di addormentarsi.
+ *
+ * @param a		regione condivisa
+ * @param id		numero del figlio (da 1 a NUM_PROC)
+*/
+
+void esegui_figlio(arena *a, int id){
+	share_mem *m=&a->slot[id-1];
+	char stampa[256];	//array di char per le stampe di sprintf
+	lavoro l[LOTTO];	//operazioni ricevute
+	unsigned long long seme=0x9E3779B97F4A7C15ULL*id;	//stato del generatore casuale
+	bool libero=true;	//stato del bit del figlio nella bitmap dei figli liberi
+	bool fine;		//ricevuto il comando di terminazione 'K'
+	int n;			//numero di operazioni del lotto
+	int preso;		//esito della ricerca di un'operazione condivisa
+	unsigned long long t0;	//inizio del calcolo o dell'attesa, per i contatori
+
+	//il figlio si lega alla CPU scelta dal padre (-A) e annota dove sta girando
+	if(m->cpu>=0 && affinita_applica(m->cpu)==-1){
+		sprintf(stampa, "Figlio %d: impossibile legarsi alla CPU %d\n", id, m->cpu);
+		write(STDOUT, stampa, strlen(stampa));
+	}
+	affinita_dove(&m->stat.cpu, &m->stat.nodo);
+	m->stat.ns_inizio=m->stat.ns_ultimo=orologio_ns();
+	m->stat.ns_fine=0;
+	while(true){
+		//prima le operazioni assegnate dal padre, poi quelle condivise
+		n=0;
+		preso=0;
+		fine=false;
+		while(n<LOTTO && ring_estrai(&m->richieste, &l[n])){
+			if(l[n].op=='K'){
+				fine=true;
+				break;
+			}
+			n++;
+		}
+		if(n==0 && !fine && a->furto && (preso=prendi_condivisa(a, id, &l[0]))==1){
+			n=1;
+			m->stat.condivise++;
+		}
+
+		if(n>0){
+			if(libero){
+				arena_occupa(a, id-1);
+				libero=false;
+			}
+			t0=orologio_ns();
+			svolgi_lotto(a, id, l, n, &seme);
+			m->stat.ns_ultimo=orologio_ns();
+			m->stat.ns_calcolo+=m->stat.ns_ultimo-t0;
+			m->stat.lavori+=n;
+			m->stat.lotti++;
+			TRACCIA(a, id, TR_CALCOLO, t0, n);
+		}
+		if(fine){
+			if(a->verboso){
+				sprintf(stampa, "Figlio %d: TERMINO\n", id);
+				write(STDOUT, stampa, strlen(stampa));
+			}
+			m->stat.ns_fine=orologio_ns();
+			TRACCIA(a, id, TR_TERMINA, 0, 0);
+			return;
+		}
+		if(n>0)
+			continue;
+		if(preso==-1){
+			//troppi risultati non prelevati: lascio girare il padre
+			attesa_sveglia(&a->padre);
+			sched_yield();
+			continue;
+		}
+
+		//nulla da fare: mi segno libero e mi addormento, ricontrollando le code dopo l'annuncio per non perdere risvegli
+		if(!libero){
+			arena_libera(a, id-1);
+			libero=true;
+		}
+		attesa_prepara(&m->attesa);
+		if(!ring_vuoto(&m->richieste) || (a->furto && lavoro_condiviso(a))){
+			attesa_annulla(&m->attesa);
+			continue;
+		}
+		m->stat.addormentamenti++;
+		t0=orologio_ns();
+		if(attesa_dormi(&m->attesa)==-1)
+			return;		//semafori rimossi: il padre non c'e' piu'
+		m->stat.ns_attesa+=orologio_ns()-t0;
+		TRACCIA(a, id, TR_ATTESA, t0, 0);
+	}
+}
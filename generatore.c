@@ -0,0 +1,309 @@
+/**
+ * @file generatore.c
+ * @author Marco Colognese
+*/
+
+#include "mylib.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * @brief Programma che genera file di operazioni sintetici, di qualunque lunghezza, per i benchmark.
+ *
+ *	Si possono scegliere:
+ *		1. il numero di operazioni (-n) e di processi (-p);
+ *		2. la frazione di operazioni con id 0, assegnate al primo figlio libero (-z, tra 0 e 1);
+ *		3. l'asimmetria degli id delle altre operazioni (-k): con 0 gli id sono uniformi, con
+ *		   k>0 l'id i ha probabilita' proporzionale a 1/i^k (legge di Zipf), cosi' i primi figli
+ *		   ricevono piu' lavoro;
+ *		4. la miscela degli operatori (-m), come pesi relativi, ad esempio "+=3,*=1" (gli
+ *		   operatori non indicati hanno peso 0);
+ *		5. l'intervallo del primo (-a) e del secondo operando (-b), come min:max;
+ *		6. la frazione di operazioni il cui primo operando e' il risultato di un'operazione
+ *		   precedente ($N), a distanza uniforme da 1 a distanza (-d frazione[:distanza], 1 per
+ *		   default: catene di operazioni consecutive).
+ *	Lo stesso seme (-s) produce sempre lo stesso file. Con -B il file e' nel formato binario.
+ *
+ *	Uso: generatore [-n operazioni] [-p processi] [-z frazione] [-k asimmetria] [-m op=peso,...] [-a min:max] [-b min:max] [-d frazione[:distanza]] [-s seme] [-B] [uscita|-]
+*/
+
+///Messaggio di uso del programma
+static const char uso[]="Uso: generatore [-n operazioni] [-p processi] [-z frazione] [-k asimmetria] [-m op=peso,...] [-a min:max] [-b min:max] [-d frazione[:distanza]] [-s seme] [-B] [uscita|-]\n";
+
+///Operatori, nell'ordine dei pesi della miscela
+static const char operatori[]="+-*/";
+
+/**
+ * @brief Funzione che estrae un numero casuale a 64 bit (xorshift, come in costo.c).
+ *
+ * @param seme		stato del generatore (diverso da 0)
+ * @return		numero casuale
+*/
+
+static unsigned long long casuale(unsigned long long *seme){
+	unsigned long long x=*seme;
+
+	x^=x<<13;
+	x^=x>>7;
+	x^=x<<17;
+	*seme=x;
+	return x;
+}
+
+/**
+ * @brief Funzione che estrae un numero casuale uniforme in [0,1).
+ *
+ * @param seme		stato del generatore
+ * @return		numero casuale
+*/
+
+static double uniforme(unsigned long long *seme){
+	return (casuale(seme)>>11)*(1.0/9007199254740992.0);
+}
+
+/**
+ * @brief Funzione che legge un intervallo "min:max".
+ *
+ * @param s		stringa da leggere
+ * @param min		estremo inferiore
+ * @param max		estremo superiore
+ * @return		0 in caso di successo, -1 se l'intervallo non e' valido
+*/
+
+static int leggi_intervallo(const char *s, long *min, long *max){
+	char *fine;
+
+	*min=strtol(s, &fine, 10);
+	if(*fine!=':')
+		return -1;
+	*max=strtol(fine+1, &fine, 10);
+	if(*fine!='\0' || *min>*max || *min<-2147483647L-1 || *max>2147483647L)
+		return -1;
+	return 0;
+}
+
+/**
+ * @brief Funzione che legge la miscela degli operatori "op=peso,...".
+ *
+ * @param s		stringa da leggere
+ * @param pesi		peso di ciascun operatore, nell'ordine + - * /
+ * @return		0 in caso di successo, -1 se la miscela non e' valida
+*/
+
+static int leggi_miscela(const char *s, double pesi[4]){
+	const char *op;
+	double totale=0;
+	char *fine;
+	int i;
+
+	for(i=0; i<4; i++)
+		pesi[i]=0;
+	while(*s!='\0'){
+		if((op=strchr(operatori, *s))==NULL || s[1]!='=')
+			return -1;
+		pesi[op-operatori]=strtod(s+2, &fine);
+		if(fine==s+2 || pesi[op-operatori]<0 || (*fine!=',' && *fine!='\0'))
+			return -1;
+		s=(*fine==',') ? fine+1 : fine;
+	}
+	for(i=0; i<4; i++)
+		totale+=pesi[i];
+	return (totale>0) ? 0 : -1;
+}
+
+/**
+ * @brief Funzione che estrae un indice da una distribuzione cumulata (ricerca binaria).
+ *
+ * @param cumulata	probabilita' cumulate, crescenti, l'ultima vale 1
+ * @param n		numero di elementi
+ * @param u		numero casuale in [0,1)
+ * @return		indice estratto, da 0 a n-1
+*/
+
+static int estrai(const double *cumulata, int n, double u){
+	int basso=0, alto=n-1, medio;
+
+	while(basso<alto){
+		medio=(basso+alto)/2;
+		if(u<cumulata[medio])
+			alto=medio;
+		else
+			basso=medio+1;
+	}
+	return basso;
+}
+
+int main(int argc, char *argv[]){
+	long long n=1000000;		//numero di operazioni
+	int num_proc=4;			//numero di processi
+	double liberi=0.5;		//frazione di operazioni con id 0
+	double k=0;			//asimmetria degli id (esponente di Zipf)
+	double pesi[4]={1, 1, 1, 1};	//miscela degli operatori
+	double cum_op[4];		//miscela cumulata
+	double *cum_id;			//distribuzione cumulata degli id
+	long a_min=-1000, a_max=1000;	//intervallo del primo operando
+	long b_min=1, b_max=100;	//intervallo del secondo operando
+	double dipendenti=0;		//frazione di operazioni con il primo operando $N
+	long distanza=1;		//distanza massima del riferimento
+	unsigned long long seme=1;	//stato del generatore casuale
+	bool binario=false;
+	const char *nome="-";
+	intestazione_lavori t;
+	record_lavoro b;
+	char riga[4*BUFLEN+8];
+	double totale;
+	uscita u;
+	long long i;
+	int opt, fd, j, id, val1, val2;
+	char op, rif, *s, *fine;
+
+	while((opt=getopt(argc, argv, "n:p:z:k:m:a:b:d:s:B"))!=-1){
+		switch(opt){
+			case 'n':
+				n=atoll(optarg);
+				break;
+			case 'p':
+				num_proc=atoi(optarg);
+				break;
+			case 'z':
+				liberi=atof(optarg);
+				break;
+			case 'k':
+				k=atof(optarg);
+				break;
+			case 'm':
+				if(leggi_miscela(optarg, pesi)==-1){
+					write(STDOUT, "Miscela degli operatori non valida\n", strlen("Miscela degli operatori non valida\n"));
+					exit(1);
+				}
+				break;
+			case 'a':
+				if(leggi_intervallo(optarg, &a_min, &a_max)==-1){
+					write(STDOUT, "Intervallo del primo operando non valido\n", strlen("Intervallo del primo operando non valido\n"));
+					exit(1);
+				}
+				break;
+			case 'b':
+				if(leggi_intervallo(optarg, &b_min, &b_max)==-1){
+					write(STDOUT, "Intervallo del secondo operando non valido\n", strlen("Intervallo del secondo operando non valido\n"));
+					exit(1);
+				}
+				break;
+			case 'd':
+				dipendenti=strtod(optarg, &fine);
+				if(*fine==':')
+					distanza=strtol(fine+1, &fine, 10);
+				if(*fine!='\0' || dipendenti<0 || dipendenti>1 || distanza<1){
+					write(STDOUT, "Dipendenze non valide\n", strlen("Dipendenze non valide\n"));
+					exit(1);
+				}
+				break;
+			case 's':
+				seme=strtoull(optarg, NULL, 10);
+				break;
+			case 'B':
+				binario=true;
+				break;
+			default:
+				write(STDOUT, uso, strlen(uso));
+				exit(1);
+		}
+	}
+	if(optind<argc)
+		nome=argv[optind];
+	if(n<0 || num_proc<1 || liberi<0 || liberi>1 || k<0){
+		write(STDOUT, uso, strlen(uso));
+		exit(1);
+	}
+	//lo stato dello xorshift non deve mai valere 0
+	seme=seme*0x9E3779B97F4A7C15ULL+1;
+	if(seme==0)
+		seme=1;
+
+	//distribuzioni cumulate degli id (Zipf, uniforme con k=0) e degli operatori
+	if((cum_id=(double *)malloc(num_proc*sizeof(double)))==NULL){
+		write(STDOUT, "Allocazione fallita\n", strlen("Allocazione fallita\n"));
+		exit(1);
+	}
+	for(j=0, totale=0; j<num_proc; j++)
+		totale+=cum_id[j]=1.0/pow(j+1, k);
+	for(j=0; j<num_proc; j++)
+		cum_id[j]=((j>0) ? cum_id[j-1] : 0)+cum_id[j]/totale;
+	cum_id[num_proc-1]=1;
+	for(j=0, totale=0; j<4; j++)
+		totale+=pesi[j];
+	for(j=0; j<4; j++)
+		cum_op[j]=((j>0) ? cum_op[j-1] : 0)+pesi[j]/totale;
+	cum_op[3]=1;
+
+	if(strcmp(nome, "-")==0)
+		fd=STDOUT;
+	else if((fd=creat(nome, 0666))==-1){
+		write(STDOUT, "Errore in creazione del file\n", strlen("Errore in creazione del file\n"));
+		exit(1);
+	}
+	if(uscita_apri(&u, fd, false, false)==-1){
+		write(STDOUT, "Allocazione del buffer fallita\n", strlen("Allocazione del buffer fallita\n"));
+		exit(1);
+	}
+
+	//intestazione: la prima riga con il numero di processi, o l'intestazione binaria senza tabella dei costi
+	if(binario){
+		memset(&t, 0, sizeof(t));
+		memcpy(t.magia, MAGIA_LAVORI, 4);
+		t.versione=FORMATO_VERSIONE;
+		t.dim_record=sizeof(record_lavoro);
+		t.num_proc=num_proc;
+		uscita_scrivi(&u, (const char *)&t, sizeof(t));
+	}
+	else{
+		s=riga+scrivi_intero(riga, num_proc);
+		*s++='\n';
+		uscita_scrivi(&u, riga, s-riga);
+	}
+
+	memset(&b, 0, sizeof(b));
+	for(i=0; i<n; i++){
+		id=(uniforme(&seme)<liberi) ? 0 : estrai(cum_id, num_proc, uniforme(&seme))+1;
+		op=operatori[estrai(cum_op, 4, uniforme(&seme))];
+		val1=(int)(a_min+(long long)(casuale(&seme)%(unsigned long long)(a_max-a_min+1)));
+		val2=(int)(b_min+(long long)(casuale(&seme)%(unsigned long long)(b_max-b_min+1)));
+		//riferimento al risultato di una delle operazioni precedenti (numerate da 1)
+		rif=0;
+		if(i>0 && dipendenti>0 && uniforme(&seme)<dipendenti){
+			rif=RIF_VAL1;
+			val1=(int)(i-(long long)(casuale(&seme)%(unsigned long long)((i<distanza) ? i : distanza)));
+		}
+		if(binario){
+			b.id=id;
+			b.val1=val1;
+			b.val2=val2;
+			b.op=op;
+			b.rif=rif;
+			uscita_scrivi(&u, (const char *)&b, sizeof(b));
+		}
+		else{
+			s=riga+scrivi_intero(riga, id);
+			*s++=' ';
+			if(rif)
+				*s++='$';
+			s+=scrivi_intero(s, val1);
+			*s++=' ';
+			*s++=op;
+			*s++=' ';
+			s+=scrivi_intero(s, val2);
+			*s++='\n';
+			uscita_scrivi(&u, riga, s-riga);
+		}
+	}
+	free(cum_id);
+	if(uscita_chiudi(&u)==-1){
+		write(STDOUT, "Errore in scrittura del file\n", strlen("Errore in scrittura del file\n"));
+		exit(1);
+	}
+	exit(0);
+}
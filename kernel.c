@@ -0,0 +1,257 @@
+/**
+ * @file kernel.c
+ * @author Marco Colognese
+*/
+
+#include "mylib.h"
+#include <limits.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNEL_X86
+#endif
+
+///Funzione che svolge un operatore su n coppie di operandi contigue
+typedef void (*kernel_op)(const int *a, const int *b, int *r, int n);
+
+/**
+ * @brief Funzioni scalari, usate quando la macchina non ha istruzioni vettoriali e per le code dei lotti.
+ *
+ *	Somma, differenza e prodotto sono calcolati sugli unsigned, cosi' in caso di overflow il
+ *	risultato e' quello (definito) in complemento a 2, identico alle istruzioni vettoriali.
+*/
+
+static void somma_scalare(const int *a, const int *b, int *r, int n){
+	int i;
+
+	for(i=0; i<n; i++)
+		r[i]=(int)((unsigned)a[i]+(unsigned)b[i]);
+}
+
+static void differenza_scalare(const int *a, const int *b, int *r, int n){
+	int i;
+
+	for(i=0; i<n; i++)
+		r[i]=(int)((unsigned)a[i]-(unsigned)b[i]);
+}
+
+static void prodotto_scalare(const int *a, const int *b, int *r, int n){
+	int i;
+
+	for(i=0; i<n; i++)
+		r[i]=(int)((unsigned)a[i]*(unsigned)b[i]);
+}
+
+/**
+ * @brief Funzione che svolge le divisioni: non esiste una divisione intera vettoriale, resta scalare per tutti i kernel.
+ *
+ *	La divisione per zero restituisce 0 e INT_MIN/-1 restituisce INT_MIN, invece di far
+ *	terminare il figlio con SIGFPE.
+*/
+
+static void quoziente(const int *a, const int *b, int *r, int n){
+	int i;
+
+	for(i=0; i<n; i++){
+		if(b[i]==0)
+			r[i]=0;
+		else if(b[i]==-1)
+			r[i]=(int)(0u-(unsigned)a[i]);
+		else
+			r[i]=a[i]/b[i];
+	}
+}
+
+#ifdef KERNEL_X86
+
+/**
+ * @brief Funzioni SSE2: quattro operazioni per istruzione.
+ *
+ *	SSE2 non ha la moltiplicazione a 32 bit: si moltiplicano separatamente le corsie pari e
+ *	dispari a 64 bit e si ricompongono le parti basse.
+*/
+
+__attribute__((target("sse2")))
+static void somma_sse2(const int *a, const int *b, int *r, int n){
+	int i;
+
+	for(i=0; i+4<=n; i+=4)
+		_mm_storeu_si128((__m128i *)(r+i), _mm_add_epi32(_mm_loadu_si128((const __m128i *)(a+i)), _mm_loadu_si128((const __m128i *)(b+i))));
+	somma_scalare(a+i, b+i, r+i, n-i);
+}
+
+__attribute__((target("sse2")))
+static void differenza_sse2(const int *a, const int *b, int *r, int n){
+	int i;
+
+	for(i=0; i+4<=n; i+=4)
+		_mm_storeu_si128((__m128i *)(r+i), _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(a+i)), _mm_loadu_si128((const __m128i *)(b+i))));
+	differenza_scalare(a+i, b+i, r+i, n-i);
+}
+
+__attribute__((target("sse2")))
+static void prodotto_sse2(const int *a, const int *b, int *r, int n){
+	__m128i x, y, pari, dispari;
+	int i;
+
+	for(i=0; i+4<=n; i+=4){
+		x=_mm_loadu_si128((const __m128i *)(a+i));
+		y=_mm_loadu_si128((const __m128i *)(b+i));
+		pari=_mm_mul_epu32(x, y);
+		dispari=_mm_mul_epu32(_mm_srli_epi64(x, 32), _mm_srli_epi64(y, 32));
+		_mm_storeu_si128((__m128i *)(r+i), _mm_unpacklo_epi32(_mm_shuffle_epi32(pari, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(dispari, _MM_SHUFFLE(0, 0, 2, 0))));
+	}
+	prodotto_scalare(a+i, b+i, r+i, n-i);
+}
+
+/**
+ * @brief Funzioni AVX2: otto operazioni per istruzione, compilate solo per queste funzioni e scelte a runtime.
+*/
+
+__attribute__((target("avx2")))
+static void somma_avx2(const int *a, const int *b, int *r, int n){
+	int i;
+
+	for(i=0; i+8<=n; i+=8)
+		_mm256_storeu_si256((__m256i *)(r+i), _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(a+i)), _mm256_loadu_si256((const __m256i *)(b+i))));
+	somma_scalare(a+i, b+i, r+i, n-i);
+}
+
+__attribute__((target("avx2")))
+static void differenza_avx2(const int *a, const int *b, int *r, int n){
+	int i;
+
+	for(i=0; i+8<=n; i+=8)
+		_mm256_storeu_si256((__m256i *)(r+i), _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(a+i)), _mm256_loadu_si256((const __m256i *)(b+i))));
+	differenza_scalare(a+i, b+i, r+i, n-i);
+}
+
+__attribute__((target("avx2")))
+static void prodotto_avx2(const int *a, const int *b, int *r, int n){
+	int i;
+
+	for(i=0; i+8<=n; i+=8)
+		_mm256_storeu_si256((__m256i *)(r+i), _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *)(a+i)), _mm256_loadu_si256((const __m256i *)(b+i))));
+	prodotto_scalare(a+i, b+i, r+i, n-i);
+}
+
+#endif
+
+///Kernel di ciascun tipo, nell'ordine dei KERNEL_* e degli operatori + - * /
+static const kernel_op tabelle[3][4]={
+	{somma_scalare, differenza_scalare, prodotto_scalare, quoziente},
+#ifdef KERNEL_X86
+	{somma_sse2, differenza_sse2, prodotto_sse2, quoziente},
+	{somma_avx2, differenza_avx2, prodotto_avx2, quoziente},
+#else
+	{somma_scalare, differenza_scalare, prodotto_scalare, quoziente},
+	{somma_scalare, differenza_scalare, prodotto_scalare, quoziente},
+#endif
+};
+
+///Nomi dei kernel, nell'ordine dei KERNEL_*
+static const char *nomi[]={"scalare", "sse2", "avx2"};
+
+///Kernel scelto (NULL = non ancora scelto)
+static const kernel_op *scelto=NULL;
+
+/**
+ * @brief Funzione che sceglie il kernel di calcolo.
+ *
+ *	Con KERNEL_AUTO si sceglie il migliore supportato dalla CPU; un kernel non supportato viene
+ *	sostituito dal migliore disponibile. Va chiamata prima di creare i figli, che ereditano la
+ *	scelta; altrimenti il kernel viene scelto al primo lotto.
+ *
+ * @param tipo		KERNEL_AUTO, KERNEL_SCALARE, KERNEL_SSE2 o KERNEL_AVX2
+ * @return		kernel scelto
+*/
+
+int kernel_init(int tipo){
+	int massimo=KERNEL_SCALARE;
+
+#ifdef KERNEL_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("sse2"))
+		massimo=KERNEL_SSE2;
+	if(__builtin_cpu_supports("avx2"))
+		massimo=KERNEL_AVX2;
+#endif
+	if(tipo==KERNEL_AUTO || tipo>massimo)
+		tipo=massimo;
+	scelto=tabelle[tipo];
+	return tipo;
+}
+
+/**
+ * @brief Funzione che restituisce il nome di un kernel, per le stampe.
+ *
+ * @param tipo		KERNEL_SCALARE, KERNEL_SSE2 o KERNEL_AVX2
+ * @return		nome del kernel
+*/
+
+const char *kernel_nome(int tipo){
+	return nomi[tipo];
+}
+
+/**
+ * @brief Funzione che svolge un operatore su n coppie di operandi contigue (a[i] op b[i]).
+ *
+ * @param op		operatore ('+', '-', '*', '/')
+ * @param a		primi operandi
+ * @param b		secondi operandi
+ * @param r		risultati
+ * @param n		numero di operazioni
+*/
+
+void kernel_calcola(char op, const int *a, const int *b, int *r, int n){
+	if(scelto==NULL)
+		kernel_init(KERNEL_AUTO);
+	scelto[costo_indice(op)](a, b, r, n);
+}
+
+/**
+ * @brief Funzione che svolge un lotto di operazioni, raggruppandole per operatore.
+ *
+ *	Gli operandi vengono copiati, ordinati per operatore, in array contigui; ogni gruppo viene
+ *	svolto dal kernel del suo operatore e i risultati vengono riportati nell'ordine del lotto.
+ *	Le operazioni con un operatore non valido (compreso 'K') hanno risultato 0.
+ *
+ * @param l		operazioni del lotto
+ * @param res		risultati, nello stesso ordine di l
+ * @param n		numero di operazioni (al piu' LOTTO)
+*/
+
+void kernel_lotto(const lavoro *l, int *res, int n){
+	int a[LOTTO], b[LOTTO], r[LOTTO];
+	int pos[LOTTO];		//posizione nel lotto dell'operazione j-esima dopo il raggruppamento
+	int inizio[6]={0};	//inizio del gruppo di ciascun operatore (4 = operatore non valido)
+	int cursore[5];
+	int i, k, j;
+
+	if(scelto==NULL)
+		kernel_init(KERNEL_AUTO);
+
+	for(i=0; i<n; i++){
+		k=costo_indice(l[i].op);
+		inizio[(k==-1 ? 4 : k)+1]++;
+	}
+	for(k=0; k<5; k++){
+		inizio[k+1]+=inizio[k];
+		cursore[k]=inizio[k];
+	}
+	for(i=0; i<n; i++){
+		k=costo_indice(l[i].op);
+		j=cursore[k==-1 ? 4 : k]++;
+		pos[j]=i;
+		a[j]=l[i].val1;
+		b[j]=l[i].val2;
+	}
+
+	for(k=0; k<4; k++)
+		if(inizio[k+1]>inizio[k])
+			scelto[k](a+inizio[k], b+inizio[k], r+inizio[k], inizio[k+1]-inizio[k]);
+	for(j=inizio[4]; j<n; j++)
+		r[j]=0;
+
+	for(j=0; j<n; j++)
+		res[pos[j]]=r[j];
+}
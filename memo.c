@@ -0,0 +1,167 @@
+/**
+ * @file memo.c
+ * @author Marco Colognese
+*/
+
+#include "mylib.h"
+#include <string.h>
+#include <sys/mman.h>
+
+///Bit del campo stato di una voce della cache
+#define MEMO_SCRITTURA 1u
+#define MEMO_VALIDA 8u
+
+/**
+ * @brief Funzione che abilita la cache dei risultati: una tabella condivisa di almeno voci voci, a insiemi di MEMO_VIE.
+ *
+ *	Come gli anelli della traccia, la tabella sta in una mappatura anonima condivisa a parte,
+ *	creata prima dei figli che la ereditano; senza cache il costo e' un solo confronto di
+ *	a->memo con NULL. Il numero di insiemi viene arrotondato alla potenza di 2 successiva.
+ *
+ * @param a		regione condivisa
+ * @param voci		numero minimo di voci della cache
+ * @return		0 in caso di successo, -1 in caso di errore
+*/
+
+int memo_crea(arena *a, unsigned voci){
+	insieme_memo *m;
+	unsigned insiemi=1;
+
+	while(insiemi*MEMO_VIE<voci && insiemi<(1u<<26))
+		insiemi<<=1;
+	m=(insieme_memo *)mmap(NULL, (size_t)insiemi*sizeof(insieme_memo), PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+	if(m==(insieme_memo *)MAP_FAILED)
+		return -1;
+	a->memo=m;
+	a->memo_maschera=insiemi-1;
+	return 0;
+}
+
+/**
+ * @brief Funzione che restituisce l'insieme della cache in cui puo' stare la terna (val1, op, val2).
+ *
+ * @param a		regione condivisa
+ * @param val1		primo operando
+ * @param op		operatore
+ * @param val2		secondo operando
+ * @return		insieme della terna
+*/
+
+static insieme_memo *insieme(const arena *a, int val1, char op, int val2){
+	unsigned long long h=((unsigned long long)(unsigned)val1<<32|(unsigned)val2)*0x9E3779B97F4A7C15ULL;
+
+	h^=(unsigned long long)(unsigned char)op*0xC2B2AE3D27D4EB4FULL;
+	h^=h>>29;
+	return &a->memo[(unsigned)(h>>32)&a->memo_maschera];
+}
+
+/**
+ * @brief Funzione che cerca nella cache il risultato della terna (val1, op, val2).
+ *
+ *	Ogni voce e' protetta dal suo stato come da un seqlock: si legge lo stato, poi la voce, e la
+ *	voce vale solo se lo stato non e' cambiato nel frattempo e non indicava una scrittura in corso.
+ *	La lettura non scrive mai sulla linea dell'insieme.
+ *
+ * @param a		regione condivisa
+ * @param val1		primo operando
+ * @param op		operatore
+ * @param val2		secondo operando
+ * @param res		risultato trovato
+ * @return		true se la terna e' nella cache
+*/
+
+bool memo_cerca(const arena *a, int val1, char op, int val2, int *res){
+	insieme_memo *m=insieme(a, val1, op, val2);
+	unsigned s, tipo=MEMO_VALIDA|((unsigned)costo_indice(op)<<1);
+	int w, v1, v2, r;
+
+	if(costo_indice(op)==-1)
+		return false;
+	for(w=0; w<MEMO_VIE; w++){
+		s=atomic_load_explicit(&m->via[w].stato, memory_order_acquire);
+		if((s&(MEMO_VALIDA|6u|MEMO_SCRITTURA))!=tipo)
+			continue;
+		v1=atomic_load_explicit(&m->via[w].val1, memory_order_relaxed);
+		v2=atomic_load_explicit(&m->via[w].val2, memory_order_relaxed);
+		r=atomic_load_explicit(&m->via[w].res, memory_order_relaxed);
+		atomic_thread_fence(memory_order_acquire);
+		if(atomic_load_explicit(&m->via[w].stato, memory_order_relaxed)!=s)
+			continue;
+		if(v1==val1 && v2==val2){
+			*res=r;
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * @brief Funzione che inserisce nella cache il risultato della terna (val1, op, val2), calcolato dall'operazione seq.
+ *
+ *	Se la terna e' gia' nell'insieme non si scrive nulla. Altrimenti si usa una voce vuota o, se
+ *	l'insieme e' pieno, quella scritta dall'operazione piu' vecchia (rimpiazzo FIFO, senza
+ *	scritture sulle letture). Piu' figli possono scrivere sullo stesso insieme: la voce si prende
+ *	con una CAS sullo stato e, se un altro figlio la sta gia' scrivendo, l'inserimento si salta.
+ *
+ * @param a		regione condivisa
+ * @param val1		primo operando
+ * @param op		operatore
+ * @param val2		secondo operando
+ * @param res		risultato
+ * @param seq		numero d'ordine dell'operazione (ne contano i 28 bit meno significativi)
+*/
+
+void memo_inserisci(arena *a, int val1, char op, int val2, int res, unsigned seq){
+	insieme_memo *m=insieme(a, val1, op, val2);
+	unsigned s, vittima_s=0, eta, eta_max=0, tipo=MEMO_VALIDA|((unsigned)costo_indice(op)<<1);
+	int w, vittima=-1;
+
+	if(costo_indice(op)==-1)
+		return;
+	for(w=0; w<MEMO_VIE; w++){
+		s=atomic_load_explicit(&m->via[w].stato, memory_order_relaxed);
+		if(s&MEMO_SCRITTURA)
+			return;
+		if(!(s&MEMO_VALIDA)){
+			if(vittima==-1 || eta_max!=~0u){
+				vittima=w;
+				vittima_s=s;
+				eta_max=~0u;
+			}
+			continue;
+		}
+		if((s&7u)==(tipo&7u) && atomic_load_explicit(&m->via[w].val1, memory_order_relaxed)==val1 && atomic_load_explicit(&m->via[w].val2, memory_order_relaxed)==val2)
+			return;
+		//eta' della voce: operazioni trascorse da quella che l'ha scritta (modulo 2^28); i figli
+		//svolgono le operazioni fuori ordine, e una voce scritta da un'operazione successiva a seq
+		//(differenza di almeno 2^27) e' la piu' giovane, non la piu' vecchia
+		eta=(seq-(s>>4))&0x0FFFFFFFu;
+		if(eta>=0x08000000u)
+			eta=0;
+		if(vittima==-1 || eta>eta_max){
+			vittima=w;
+			vittima_s=s;
+			eta_max=eta;
+		}
+	}
+	if(!atomic_compare_exchange_strong_explicit(&m->via[vittima].stato, &vittima_s, vittima_s|MEMO_SCRITTURA, memory_order_relaxed, memory_order_relaxed))
+		return;
+	atomic_thread_fence(memory_order_release);
+	atomic_store_explicit(&m->via[vittima].val1, val1, memory_order_relaxed);
+	atomic_store_explicit(&m->via[vittima].val2, val2, memory_order_relaxed);
+	atomic_store_explicit(&m->via[vittima].res, res, memory_order_relaxed);
+	atomic_store_explicit(&m->via[vittima].stato, (seq<<4)|tipo, memory_order_release);
+}
+
+/**
+ * @brief Funzione che rimuove la cache dei risultati.
+ *
+ * @param a		regione condivisa
+*/
+
+void memo_distruggi(arena *a){
+	if(a->memo==NULL)
+		return;
+	munmap(a->memo, (size_t)(a->memo_maschera+1)*sizeof(insieme_memo));
+	a->memo=NULL;
+}
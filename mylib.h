@@ -6,30 +6,881 @@
 #ifndef MYLIB
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
 #define MYLIB
 
 
 
-#define BUFLEN 10
+#define BUFLEN 12
 #define STDIN 0
 #define STDOUT 1
+#define STDERR 2
 
-///STRUTTURA CONTENENTE I CAMPI DEI MESSAGGI SCAMBIATI TRA PADRE E FIGLIO
-typedef struct messaggio{
+///Dimensione di una linea di cache
+#define CACHE_LINE 64
+
+///Dimensione dei blocchi letti dal parser quando il file non puo' essere mappato in memoria
+#define PARSER_BLOCCO (1<<16)
+
+///Dimensione dei pezzi del file analizzati da ciascun thread nella lettura parallela (-L)
+#define PEZZO_LETTURA (1<<18)
+
+///Dimensione del buffer in cui vengono accumulati i risultati prima di scriverli
+#define USCITA_BLOCCO (1<<16)
+///Lunghezza massima di una riga del file dei risultati: tre interi, l'operatore, '=' e '\n'
+#define USCITA_RIGA (3*(BUFLEN-1)+3)
+
+///Politiche di fsync della scrittura asincrona dei risultati (-W): mai, dopo ogni blocco, solo alla chiusura
+#define FSYNC_MAI 0
+#define FSYNC_BLOCCO 1
+#define FSYNC_FINE 2
+
+///Profondita' predefinita delle code tra padre e figlio
+#define PROFONDITA 64
+
+///Numero massimo di operazioni prelevate e svolte insieme da un figlio
+#define LOTTO 64
+
+///Kernel di calcolo dei lotti (KERNEL_AUTO = il migliore supportato dalla CPU)
+#define KERNEL_AUTO -1
+#define KERNEL_SCALARE 0
+#define KERNEL_SSE2 1
+#define KERNEL_AVX2 2
+
+///Numero di operazioni che ciascun client puo' avere in attesa di essere inviate ai figli (modalita' servizio)
+#define CODA_CLIENTE 1024
+///Byte di risultati che un client del servizio puo' lasciare non letti prima di essere scollegato
+#define LIMITE_CLIENTE (16<<20)
+
+///Numero predefinito di operazioni lette dal padre e non ancora consegnate in ordine
+#define FINESTRA 4096
+
+///Figli eseguiti come processi creati con fork()
+#define BACKEND_PROCESSI 0
+///Figli eseguiti come thread del padre
+#define BACKEND_THREAD 1
+
+///Sincronizzazione con i semafori SysV
+#define SYNC_SYSV 0
+///Sincronizzazione con attesa attiva limitata e futex in memoria condivisa
+#define SYNC_FUTEX 1
+
+///Limiti dei giri di attesa attiva prima di addormentarsi sulla futex
+#define SPIN_MAX 4096
+#define SPIN_MIN 16
+
+///Secondi dopo cui un array di semafori mai usato, con la stessa chiave, si considera abbandonato
+#define ABBANDONO_S 10
+
+///Tipi di costo di un'operazione
+#define COSTO_ZERO 0
+#define COSTO_FISSO 1
+#define COSTO_UNIFORME 2
+#define COSTO_ESPONENZIALE 3
+
+///Costo predefinito di un'operazione in nanosecondi (il vecchio sleep(1))
+#define COSTO_PREDEFINITO 1000000000LL
+
+///STRUTTURA CONTENENTE IL COSTO DI UN OPERATORE
+typedef struct costo{
+	///Tipo di costo (COSTO_ZERO, COSTO_FISSO, COSTO_UNIFORME, COSTO_ESPONENZIALE)
+	int tipo;
+	///Costo fisso, minimo dell'uniforme o media dell'esponenziale, in nanosecondi
+	long long a;
+	///Massimo dell'uniforme, in nanosecondi
+	long long b;
+}costo_op;
+
+///STRUTTURA CONTENENTE IL MODELLO DI COSTO DEI FIGLI
+typedef struct modello{
+	///Costo di ciascun operatore, nell'ordine + - * /
+	costo_op op[4];
+	///Booleano che indica se i figli devono attendere davvero il costo o solo simularlo
+	bool reale;
+}modello_costo;
+
+///STRUTTURA CONTENENTE UN PUNTO DI ATTESA: UN PROCESSO CHE DORME FINCHE' UN ALTRO NON LO SVEGLIA
+typedef struct __attribute__((aligned(CACHE_LINE))) attesa{
+	///Stato (atomico) del processo: 0 sveglio, 1 sta per addormentarsi, 2 addormentato sulla futex
+	_Atomic int dorme;
+	///Meccanismo di sincronizzazione (SYNC_SYSV o SYNC_FUTEX)
+	int modo;
+	///Id dell'array di semafori
+	int semaforo;
+	///Semaforo su cui il processo si addormenta
+	int sem_num;
+	///Giri di attesa attiva prima di addormentarsi, adattati ad ogni attesa
+	unsigned giri;
+}punto_attesa;
+
+///STRUTTURA CONTENENTE UNA CODA CIRCOLARE A SINGOLO PRODUTTORE E SINGOLO CONSUMATORE
+typedef struct __attribute__((aligned(CACHE_LINE))) anello{
+	///Indice del prossimo elemento da estrarre (scritto solo dal consumatore)
+	_Atomic unsigned testa;
+	///Ultimo valore di coda letto dal consumatore
+	unsigned coda_vista;
+	///Indice del prossimo elemento da inserire (scritto solo dal produttore)
+	_Atomic unsigned coda __attribute__((aligned(CACHE_LINE)));
+	///Ultimo valore di testa letto dal produttore
+	unsigned testa_vista;
+	///Capacita' della coda meno uno (la capacita' e' una potenza di 2)
+	unsigned maschera __attribute__((aligned(CACHE_LINE)));
+	///Dimensione di un elemento
+	unsigned dim_elem;
+	///Elementi della coda
+	char *dati;
+}spsc;
+
+///Formato binario dei file di operazioni e di risultati (interi nell'ordine dei byte della macchina)
+#define MAGIA_LAVORI "SPCL"
+#define MAGIA_RISULTATI "SPCR"
+#define MAGIA_RIPRESA "SPCK"
+#define FORMATO_VERSIONE 1
+
+///Operazioni consegnate tra due punti di ripresa, se non indicate con -C
+#define RIPRESA_INTERVALLO 65536
+
+///STRUTTURA CONTENENTE IL COSTO DI UN OPERATORE NEL FILE BINARIO DELLE OPERAZIONI
+typedef struct costo_bin{
+	///Tipo di costo (COSTO_*)
+	int32_t tipo;
+	///Riservato, vale 0
+	int32_t riservato;
+	///Parametri del costo in nanosecondi (vedi costo_op)
+	int64_t a, b;
+}costo_bin;
+
+///STRUTTURA CONTENENTE L'INTESTAZIONE DEL FILE BINARIO DELLE OPERAZIONI
+typedef struct intestazione_lavori{
+	///MAGIA_LAVORI, senza terminatore
+	char magia[4];
+	///FORMATO_VERSIONE
+	uint16_t versione;
+	///Dimensione di ciascun record (sizeof(record_lavoro))
+	uint16_t dim_record;
+	///Numero di processi (NUM_PROC)
+	int32_t num_proc;
+	///Booleano che indica se la tabella dei costi e' valida (sostituisce le direttive #costo)
+	int32_t con_costi;
+	///Costo di ciascun operatore, nell'ordine + - * /
+	costo_bin costi[4];
+}intestazione_lavori;
+
+///STRUTTURA CONTENENTE UN RECORD DEL FILE BINARIO DELLE OPERAZIONI
+typedef struct record_lavoro{
+	///Processo a cui assegnare l'operazione (0 = primo libero)
+	int32_t id;
+	///Primo operando
+	int32_t val1;
+	///Secondo operando
+	int32_t val2;
+	///Operazione da svolgere ('+', '-', '*', '/')
+	char op;
+	///Operandi che sono riferimenti (RIF_VAL1, RIF_VAL2): l'operando e' il numero N di $N
+	char rif;
+	///Riservato, vale 0
+	char riservato[2];
+}record_lavoro;
+
+///STRUTTURA CONTENENTE L'INTESTAZIONE DEL FILE BINARIO DEI RISULTATI
+typedef struct intestazione_risultati{
+	///MAGIA_RISULTATI, senza terminatore
+	char magia[4];
+	///FORMATO_VERSIONE
+	uint16_t versione;
+	///Dimensione di ciascun record (sizeof(record_risultato))
+	uint16_t dim_record;
+	///Riservato, vale 0
+	int32_t riservato[2];
+}intestazione_risultati;
+
+///STRUTTURA CONTENENTE UN RECORD DEL FILE BINARIO DEI RISULTATI
+typedef struct record_risultato{
+	///Primo operando
+	int32_t val1;
+	///Secondo operando
+	int32_t val2;
+	///Risultato
+	int32_t res;
+	///Operazione svolta
+	char op;
+	///Riservato, vale 0
+	char riservato[3];
+}record_risultato;
+
+///STRUTTURA CONTENENTE UN PUNTO DI RIPRESA: LO STATO DELLA SIMULAZIONE DOPO LE PRIME consegnati OPERAZIONI
+typedef struct punto{
+	///Numero progressivo del salvataggio (0 = punto mai scritto): vale il punto con il numero piu' alto
+	uint64_t generazione;
+	///Operazioni consegnate e scritte nel file dei risultati
+	uint64_t consegnati;
+	///Posizione nel file delle operazioni dopo l'ultima operazione consegnata
+	int64_t posizione;
+	///Byte validi del file dei risultati
+	int64_t dim_uscita;
+	///Riga (o record) dell'ultima operazione consegnata
+	int32_t riga;
+	///Riservato, vale 0
+	int32_t riservato;
+}punto_ripresa;
+
+///STRUTTURA CONTENENTE L'INTESTAZIONE DEL FILE DI RIPRESA, SEGUITA DAI RISULTATI DI CIASCUN PUNTO (2*num_valori int32_t)
+typedef struct intestazione_ripresa{
+	///MAGIA_RIPRESA, senza terminatore
+	char magia[4];
+	///FORMATO_VERSIONE
+	uint16_t versione;
+	///Booleano che indica se il file dei risultati e' nel formato binario
+	uint16_t binario;
+	///Identita' del file delle operazioni: dispositivo, i-node, dimensione e istante dell'ultima modifica
+	uint64_t dispositivo, inode;
+	int64_t dimensione, modifica_ns;
+	///Numero di risultati salvati in ciascun punto: quelli delle ultime num_valori operazioni, per i riferimenti $N
+	uint32_t num_valori;
+	///Riservato, vale 0
+	uint32_t riservato;
+	///I due punti di ripresa, scritti a turno: se un salvataggio si interrompe resta valido l'altro
+	punto_ripresa punto[2];
+}intestazione_ripresa;
+
+///STRUTTURA CONTENENTE UN'OPERAZIONE LETTA DAL FILE DI CONFIGURAZIONE
+typedef struct operazione{
+	///Riga del file in cui si trova l'operazione
+	int riga;
+	///Processo a cui assegnare l'operazione (0 = primo libero)
+	int id;
+	///Primo operando
+	int val1;
+	///Operazione da svolgere ('K' = terminazione)
+	char op;
+	///Operandi che sono riferimenti al risultato di un'altra operazione (RIF_VAL1, RIF_VAL2): l'operando
+	///contiene la distanza dall'operazione riferita, il cui numero d'ordine e' seq meno la distanza
+	char rif;
+	///Secondo operando
+	int val2;
+	///Numero d'ordine dell'operazione, assegnato dal padre all'invio
+	unsigned long long seq;
+}lavoro;
+
+///Operandi di un'operazione che sono riferimenti ($N) al risultato di un'altra
+#define RIF_VAL1 1
+#define RIF_VAL2 2
+
+///STRUTTURA CONTENENTE IL RISULTATO DI UN'OPERAZIONE NELLA TABELLA DEI VALORI (SCRITTO DAL FIGLIO CHE LA SVOLGE)
+typedef struct valore{
+	///Risultato
+	int res;
+	///Numero d'ordine dell'operazione piu' uno (0 = nessun risultato)
+	_Atomic unsigned long long seq;
+}valore;
+
+///STRUTTURA CONTENENTE IL RISULTATO DI UN'OPERAZIONE, RESTITUITO DAL FIGLIO AL PADRE
+typedef struct esito{
+	///Riga del file in cui si trova l'operazione
+	int riga;
 	///Primo operando
 	int val1;
-	///Operazione da svolgere
+	///Operazione svolta
 	char op;
 	///Secondo operando
 	int val2;
 	///Risultato
 	int res;
-	///Booleano per segnalare il termine di un calcolo al padre
-	bool finish;
+	///Id dell'operazione (0 = non assegnata ad un figlio preciso)
+	int id;
+	///Figlio che ha svolto il calcolo
+	int figlio;
+	///Numero d'ordine dell'operazione (copiato da lavoro.seq)
+	unsigned long long seq;
+}risultato;
+
+///STRUTTURA CONTENENTE UNA CODA DI OPERAZIONI A SINGOLO PRODUTTORE E PIU' CONSUMATORI (FURTO DI LAVORO)
+typedef struct __attribute__((aligned(CACHE_LINE))) furto{
+	///Indice della prossima operazione da estrarre (conteso dai figli con una CAS)
+	_Atomic unsigned testa;
+	///Indice della prossima operazione da inserire (scritto solo dal padre)
+	_Atomic unsigned coda __attribute__((aligned(CACHE_LINE)));
+	///Ultimo valore di testa letto dal padre
+	unsigned testa_vista;
+	///Capacita' della coda meno uno (la capacita' e' una potenza di 2)
+	unsigned maschera __attribute__((aligned(CACHE_LINE)));
+	///Operazioni della coda
+	lavoro *dati;
+}spmc;
+
+///Numero di classi degli istogrammi di latenza (classe k = latenze da 2^k a 2^(k+1)-1 ns)
+#define ISTO_CLASSI 64
+
+///STRUTTURA CONTENENTE UN ISTOGRAMMA DI LATENZE IN NANOSECONDI, A CLASSI DI POTENZE DI 2
+typedef struct istogramma{
+	///Numero di latenze in ciascuna classe
+	unsigned long long classi[ISTO_CLASSI];
+	///Numero totale di latenze
+	unsigned long long n;
+	///Somma delle latenze
+	unsigned long long somma;
+	///Latenza massima
+	unsigned long long massimo;
+}istogramma;
+
+///STRUTTURA CONTENENTE I CONTATORI DI UN FIGLIO (SCRITTI SOLO DAL FIGLIO, LETTI DAL PADRE)
+typedef struct contatori{
+	///Operazioni svolte
+	unsigned long long lavori;
+	///Lotti svolti
+	unsigned long long lotti;
+	///Operazioni prese dalle code condivise (furto di lavoro)
+	unsigned long long condivise;
+	///Volte in cui il figlio si e' addormentato
+	unsigned long long addormentamenti;
+	///Tempo speso nei calcoli e nella consegna dei risultati, in nanosecondi
+	unsigned long long ns_calcolo;
+	///Tempo speso bloccato sul punto di attesa, in nanosecondi
+	unsigned long long ns_attesa;
+	///Istante di avvio e di terminazione del figlio (0 = ancora attivo)
+	unsigned long long ns_inizio, ns_fine;
+	///Istante in cui il figlio ha finito l'ultimo lotto (o e' stato avviato)
+	unsigned long long ns_ultimo;
+	///CPU e nodo NUMA su cui il figlio girava all'avvio (-1 = non disponibile)
+	int cpu, nodo;
+}contatori;
+
+///Numero di eventi di ciascun anello della traccia (a giro: si conservano gli ultimi)
+#define TRACCIA_EVENTI (1<<15)
+
+///Tipi di evento della traccia
+#define TR_LETTURA 0
+#define TR_INVIO 1
+#define TR_SCELTA 2
+#define TR_PARCHEGGIO 3
+#define TR_ATTESA 4
+#define TR_RACCOLTA 5
+#define TR_CALCOLO 6
+#define TR_TERMINA 7
+
+///STRUTTURA CONTENENTE UN EVENTO DELLA TRACCIA: UN INTERVALLO DI TEMPO (DURATA 0 = ISTANTANEO)
+typedef struct evento{
+	///Istante di inizio, in nanosecondi (orologio_ns)
+	unsigned long long inizio;
+	///Durata, in nanosecondi
+	unsigned long long durata;
+	///Argomento dell'evento (figlio scelto, operazioni del lotto, risultati prelevati)
+	unsigned arg;
+	///Tipo dell'evento (TR_*)
+	unsigned tipo;
+}evento;
+
+///STRUTTURA CONTENENTE L'ANELLO DEGLI EVENTI DI UN PROCESSO (UN SOLO PRODUTTORE, LETTO ALLA FINE)
+typedef struct __attribute__((aligned(CACHE_LINE))) traccia{
+	///Eventi scritti dall'inizio (l'evento k e' in ev[k%TRACCIA_EVENTI])
+	unsigned long long scritti;
+	///Eventi
+	evento ev[TRACCIA_EVENTI];
+}traccia;
+
+///Numero di voci di ciascun insieme della cache dei risultati (un insieme per linea di cache)
+#define MEMO_VIE 4
+
+///STRUTTURA CONTENENTE UNA VOCE DELLA CACHE DEI RISULTATI: (val1, op, val2) -> res
+typedef struct voce_memo{
+	///Bit 0: scrittura in corso; bit 1-2: operatore (costo_indice); bit 3: voce valida; bit 4-31: numero d'ordine dell'operazione che
+	///l'ha scritta, modulo 2^28. Serve solo a scegliere la voce piu' vecchia da rimpiazzare: l'eta' si calcola modulo 2^28 (vedi
+	///memo_inserisci()), quindi una voce rimasta per piu' di 2^27 operazioni sembra giovane. Il rimpiazzo e' meno preciso, i
+	///risultati restano giusti perche' la voce si riconosce dalla terna (val1, op, val2)
+	_Atomic unsigned stato;
+	///Operandi e risultato
+	_Atomic int val1, val2, res;
+}voce_memo;
+
+///STRUTTURA CONTENENTE UN INSIEME DELLA CACHE DEI RISULTATI (MEMO_VIE VOCI IN UNA LINEA DI CACHE)
+typedef struct __attribute__((aligned(CACHE_LINE))) insieme_memo{
+	voce_memo via[MEMO_VIE];
+}insieme_memo;
+
+///STRUTTURA CONTENENTE I CAMPI SCAMBIATI TRA PADRE E FIGLIO (ALLINEATA ALLA LINEA DI CACHE)
+typedef struct __attribute__((aligned(CACHE_LINE))) messaggio{
+	///Operazioni inviate dal padre al figlio
+	spsc richieste;
+	///Risultati restituiti dal figlio al padre (capacita' doppia: ospitano anche le operazioni rubate)
+	spsc risultati;
+	///Operazioni con id 0 assegnate al figlio, che gli altri figli possono rubare
+	spmc condivise;
+	///Punto di attesa del figlio quando non ha operazioni da svolgere
+	punto_attesa attesa;
+	///Tempo simulato speso dal figlio nei calcoli, in nanosecondi (scritto solo dal figlio)
+	unsigned long long tempo_simulato __attribute__((aligned(CACHE_LINE)));
+	///Contatori delle prestazioni del figlio (scritti solo dal figlio)
+	contatori stat;
+	///CPU a cui il figlio si lega all'avvio (-1 = nessuna) e nodo NUMA delle sue code (-1 = nessuno)
+	int cpu, nodo;
+	///Inizio delle code del figlio nella regione (per leggere il nodo NUMA delle pagine)
+	void *code;
 }share_mem;
 
-int calcolo_char(char array[], int i);
-void itoa(int i, char s[]);
-void reverse(char s[]);
+///STRUTTURA CONTENENTE L'UNICA REGIONE DI MEMORIA CONDIVISA: INTESTAZIONE E SLOT DEI FIGLI
+typedef struct regione{
+	///Numero di processi figli
+	int num_proc;
+	///Profondita' delle code di ciascun figlio
+	unsigned profondita;
+	///Dimensione totale della regione
+	size_t dim;
+	///Booleano che indica se la regione e' un segmento SysV invece di una mmap anonima
+	bool sysv;
+	///Modello di costo delle operazioni svolte dai figli
+	modello_costo costi;
+	///Booleano che abilita le stampe dei figli per ogni operazione
+	bool verboso;
+	///Booleano che abilita il furto di lavoro tra figli per le operazioni con id 0
+	bool furto;
+	///Bitmap dei figli liberi (bit j = figlio j+1 con la coda vuota), nella regione dopo le code
+	_Atomic unsigned long long *liberi;
+	///Numero di parole da 64 bit della bitmap
+	int parole;
+	///Tabella dei risultati delle ultime operazioni, indicizzata da seq%num_valori (due finestre), nella regione dopo la bitmap
+	valore *valori;
+	unsigned num_valori;
+	///Punto di attesa del padre quando aspetta dei risultati
+	punto_attesa padre;
+	///Anelli della traccia, in una mappatura condivisa a parte (0 = padre, j = figlio j; NULL = traccia disabilitata)
+	traccia *tracce;
+	///Cache dei risultati, in una mappatura condivisa a parte (NULL = cache disabilitata), e numero di insiemi meno uno
+	insieme_memo *memo;
+	unsigned memo_maschera;
+	///Slot dei figli, uno per linea di cache (le code seguono l'array degli slot)
+	share_mem slot[];
+}arena;
+
+///Politiche di scelta del figlio libero per le operazioni con id 0
+#define SCELTA_PRIMO 0
+#define SCELTA_GIRO 1
+
+///STRUTTURA CONTENENTE LO STATO DEL PADRE NELLA DISTRIBUZIONE DELLE OPERAZIONI
+typedef struct distributore{
+	///Regione condivisa con i figli
+	arena *a;
+	///Politica di scelta del figlio libero (SCELTA_PRIMO o SCELTA_GIRO)
+	int politica;
+	///Posizione da cui riprendere la ricerca con SCELTA_GIRO
+	int cursore;
+	///Numero di operazioni inviate e non ancora raccolte, per ciascun figlio
+	unsigned *in_volo;
+	///Numero totale di operazioni inviate e non ancora raccolte
+	long pendenti;
+	///Booleano che abilita il furto di lavoro (le operazioni con id 0 vanno nelle code condivise)
+	bool furto;
+	///Booleano che abilita le stampe per ogni operazione
+	bool verboso;
+	///Funzione chiamata per ogni risultato, nell'ordine delle operazioni
+	void (*consegna)(void *ctx, const risultato *r);
+	///Argomento passato a consegna
+	void *ctx;
+	///Numero massimo di operazioni inviate e non ancora consegnate
+	unsigned finestra;
+	///Numero d'ordine della prossima operazione da inviare
+	unsigned long long inviati;
+	///Numero d'ordine del prossimo risultato da consegnare
+	unsigned long long consegnati;
+	///Buffer di riordino dei risultati, indicizzato da seq%finestra
+	risultato *ordine;
+	///Booleani che indicano i posti di ordine occupati da un risultato non ancora consegnato
+	bool *pronto;
+	///Deposito delle operazioni messe da parte perche' la coda del figlio era piena
+	lavoro *deposito;
+	///Posto successivo nella lista (di un figlio o dei posti liberi) di ciascun posto del deposito
+	int *succ;
+	///Primo posto libero del deposito (-1 = nessuno)
+	int posto_libero;
+	///Prima e ultima operazione messa da parte per ciascun figlio (-1 = nessuna)
+	int *att_testa;
+	int *att_coda;
+	///Istante di lettura di ciascuna operazione nella finestra, indicizzato da seq%finestra
+	unsigned long long *t_letto;
+	///Figlio (piu' uno) nella cui coda, o tra le cui operazioni messe da parte, si trova ciascuna operazione della finestra (0 = altrove)
+	int *dove;
+	///Prima operazione del deposito in attesa del risultato di ciascuna operazione della finestra (-1 = nessuna)
+	int *dip_testa;
+	///Prima e ultima operazione del deposito con i risultati attesi ormai pronti, da inviare (-1 = nessuna)
+	int pronte_testa, pronte_coda;
+	///Operazioni che hanno atteso il risultato di un'altra e operazioni accodate allo stesso figlio di quella da cui dipendono
+	unsigned long long dipendenti, concatenate;
+	///Invii in corso (invia_pronte() o l'attesa di spazio nelle code condivise): finche' e' >0 le operazioni pronte restano nella lista, senza annidare invia_pronte()
+	int inviando;
+	///Operazioni trovate e non trovate nella cache dei risultati
+	unsigned long long memo_successi, memo_mancati;
+	///Latenza tra la lettura di un'operazione e il suo inserimento nella coda di un figlio
+	istogramma inoltro;
+	///Latenza tra la lettura di un'operazione e la consegna del suo risultato
+	istogramma completamento;
+	///Operazioni messe da parte perche' la coda del figlio era piena
+	unsigned long long parcheggiate;
+	///Tempo speso dal padre bloccato in attesa dei risultati, in nanosecondi
+	unsigned long long ns_attesa;
+	///Booleani che indicano i figli avviati e numero di figli avviati
+	bool *attivo;
+	int attivi;
+	///Funzione che avvia il figlio j+1 (NULL = insieme dei figli fisso) e suo argomento
+	void (*avvia)(void *ctx, int j);
+	void *ctx_avvia;
+	///Figli che restano sempre avviati; gli altri si ritirano dopo timeout ns senza lavoro
+	int minimo;
+	unsigned long long timeout;
+	///Operazioni con id 0 inviate a figli occupati dall'ultimo avvio; a soglia si avvia un figlio
+	unsigned arretrato, soglia;
+	///Istante del prossimo controllo dei figli senza lavoro
+	unsigned long long prossimo_controllo;
+	///Figli avviati e ritirati durante l'esecuzione
+	unsigned long long avvii, ritiri;
+}dispatcher;
+
+///STRUTTURA CONTENENTE UNA RIGA ANALIZZATA DA UN THREAD DI LETTURA PARALLELA: UN'OPERAZIONE O UNA RIGA MALFORMATA
+typedef struct letta{
+	///Operazione: i riferimenti contengono ancora N e la riga e' contata dall'inizio del pezzo
+	lavoro l;
+	///Descrizione dell'errore se la riga e' malformata, NULL se e' un'operazione
+	const char *motivo;
+	///Fine della riga (dopo il '\n'), dall'inizio del pezzo
+	unsigned fine;
+}riga_letta;
+
+///STRUTTURA CONTENENTE UN PEZZO DEL FILE, DELIMITATO DA FINE RIGA, CON LE SUE RIGHE GIA' ANALIZZATE
+typedef struct pezzo{
+	///Indice del pezzo nel file (-1 = posto mai usato)
+	long long indice;
+	///Booleano che indica che l'analisi del pezzo e' terminata
+	bool pronto;
+	///Booleano che indica che l'analisi e' fallita per mancanza di memoria
+	bool errore;
+	///Booleano che indica che il pezzo contiene la riga vuota che termina le operazioni (le righe successive non sono analizzate)
+	bool vuota;
+	///Inizio e fine del pezzo nel file (con vuota, la fine e' dopo la riga vuota)
+	size_t inizio, fine;
+	///Numero di righe del pezzo
+	int righe;
+	///Righe analizzate (operazioni e righe malformate), in un array che cresce se non bastano
+	riga_letta *v;
+	int n, cap;
+}pezzo_letto;
+
+///STRUTTURA CONTENENTE LO STATO DELLA LETTURA PARALLELA DI UN FILE MAPPATO IN MEMORIA
+typedef struct lettura{
+	///Thread di lettura
+	pthread_t *thread;
+	int num_thread;
+	///Pezzi in analisi o analizzati e non ancora consumati, nel posto indice%num_pezzi
+	pezzo_letto *pezzi;
+	int num_pezzi;
+	///Inizio delle operazioni nel file (dopo l'intestazione) e numero di pezzi del file
+	size_t origine;
+	long long totale;
+	///Prossimo pezzo da assegnare a un thread e pezzi gia' consumati dal padre
+	long long prossimo, consumati;
+	///Pezzo che il padre sta consumando (NULL = nessuno) e prossima riga da consumare
+	pezzo_letto *attuale;
+	int k;
+	///Riga del file che precede il pezzo attuale
+	int riga_base;
+	///Booleano che indica che le operazioni sono finite (riga vuota)
+	bool finite;
+	///Booleano che indica ai thread di terminare
+	bool basta;
+	///Mutex e condition variable dei pezzi (posto libero, pezzo pronto)
+	pthread_mutex_t m;
+	pthread_cond_t libero, pronto;
+	///File mappato e numero di processi, per l'analisi delle righe
+	const char *base;
+	size_t len;
+	int num_proc;
+}lettura_parallela;
+
+///STRUTTURA CONTENENTE LO STATO DELLA LETTURA DEL FILE DI CONFIGURAZIONE
+typedef struct lettore{
+	///File descriptor del file
+	int fd;
+	///Byte del file (mappati in memoria o letti nel buffer)
+	char *base;
+	///Numero di byte validi in base
+	size_t len;
+	///Posizione del prossimo carattere da leggere
+	size_t pos;
+	///Byte del file gia' scartati dal buffer in lettura a blocchi (il byte base[0] e' il byte scartati del file)
+	long long scartati;
+	///Capacita' del buffer in lettura a blocchi
+	size_t cap;
+	///Booleano che indica se il file e' mappato in memoria
+	bool mappato;
+	///Booleano che indica se e' stata raggiunta la fine del file
+	bool eof;
+	///Booleano che indica se il file e' nel formato binario (record_lavoro)
+	bool binario;
+	///Booleano che indica che la prossima riga e' gia' stata letta (in s_inizio, s_fine)
+	bool sospesa;
+	///Riga letta in anticipo dopo l'intestazione
+	const char *s_inizio, *s_fine;
+	///Modello di costo in cui salvare le direttive #costo dell'intestazione (puo' essere NULL)
+	modello_costo *costi;
+	///Funzione chiamata quando la lettura si bloccherebbe: restituisce true se ha ancora lavoro da fare (puo' essere NULL)
+	bool (*attesa)(void *ctx);
+	///Argomento passato ad attesa
+	void *ctx;
+	///Numero di processi letto dalla prima riga (se e' gia' positivo la prima riga non c'e')
+	int num_proc;
+	///Numero di righe lette
+	int riga;
+	///Numero di operazioni valide lette
+	int lavori;
+	///Numero di righe malformate
+	int errori;
+	///Distanza massima di un riferimento $N, fissata dalla tabella dei valori del distributore (0 = nessun limite)
+	int portata;
+	///Lettura parallela (NULL = le righe si analizzano una alla volta)
+	lettura_parallela *par;
+}parser;
+
+///STRUTTURA CONTENENTE LO STATO DEL THREAD DI SCRITTURA ASINCRONA DEI RISULTATI (DOPPIO BUFFER)
+typedef struct asincrona{
+	///Thread di scrittura
+	pthread_t thread;
+	///Mutex e condition variable: blocco da scrivere consegnato, blocco scritto
+	pthread_mutex_t m;
+	pthread_cond_t consegnato, scritto;
+	///Secondo buffer: quello in scrittura dal thread, o libero per lo scambio
+	char *altro;
+	///Byte del blocco consegnato al thread (0 = il thread non ha nulla da scrivere)
+	size_t da_scrivere;
+	///Politica di fsync (FSYNC_MAI, FSYNC_BLOCCO o FSYNC_FINE)
+	int fsync;
+	///Booleano che indica al thread di terminare
+	bool basta;
+	///Booleano che indica che una scrittura del thread e' fallita
+	bool errore;
+	///Blocchi scritti dal thread e tempo passato dal chiamante ad attendere che il thread finisse il blocco precedente
+	unsigned long long blocchi, ns_attesa;
+}scrittura_asincrona;
+
+///STRUTTURA CONTENENTE LO STATO DELLA SCRITTURA BUFFERIZZATA DEI RISULTATI
+typedef struct scrittore{
+	///File descriptor su cui scrivere
+	int fd;
+	///Buffer dei byte non ancora scritti
+	char *buf;
+	///Numero di byte nel buffer
+	size_t len;
+	///Capacita' del buffer
+	size_t cap;
+	///Booleano che indica se i risultati vanno scritti nel formato binario (record_risultato)
+	bool binario;
+	///Booleano che indica se una scrittura e' fallita
+	bool errore;
+	///Scrittura asincrona (NULL = le write() le fa il chiamante)
+	scrittura_asincrona *as;
+	///Scrittura non bloccante su un socket: byte che il buffer puo' contenere al piu' (0 = scrittura bloccante)
+	size_t limite;
+}uscita;
+
+///STRUTTURA CONTENENTE LO STATO DEI PUNTI DI RIPRESA DI UNA SIMULAZIONE
+typedef struct salvataggio{
+	///Nome del file di ripresa
+	const char *nome;
+	///File di ripresa e sua mappatura in memoria
+	int fd;
+	intestazione_ripresa *m;
+	size_t dim;
+	///Risultati salvati in ciascuno dei due punti (num_valori ciascuno, indice seq%num_valori)
+	int32_t *salvati[2];
+	///Numero di risultati da salvare (la dimensione della tabella dei valori della regione)
+	unsigned num_valori;
+	///Operazioni consegnate tra due punti di ripresa
+	unsigned long long intervallo;
+	///Finestra del distributore, cioe' il numero di elementi di posizione e riga
+	unsigned finestra;
+	///Posizione nel file delle operazioni e riga dopo ciascuna operazione inviata (indice seq%finestra)
+	long long *posizione;
+	int *riga;
+	///Risultati delle ultime num_valori operazioni consegnate (indice seq%num_valori)
+	int *valori;
+	///Scrittore dei risultati, svuotato prima di ogni punto di ripresa
+	uscita *u;
+	///Punto da cui riprende questa esecuzione (generazione 0 = dall'inizio del file)
+	punto_ripresa ripreso;
+	///Numero di punti di ripresa scritti da questa esecuzione
+	unsigned long long scritti;
+}ripresa;
+
+///STRUTTURA CONTENENTE UN CLIENT CONNESSO AL SERVIZIO
+typedef struct connessione{
+	///Socket del client: le operazioni arrivano e i risultati ripartono da qui
+	int fd;
+	///Numero progressivo del client, per le stampe
+	int num;
+	///Thread che legge le operazioni dal socket
+	pthread_t lettore;
+	///Lettore delle operazioni del client
+	parser p;
+	///Modello di costo in cui finiscono (ignorate) le direttive #costo del client
+	modello_costo costi;
+	///Operazioni lette e non ancora inviate ai figli (coda circolare di CODA_CLIENTE elementi)
+	lavoro *coda;
+	///Posizione della prossima operazione da inviare e numero di operazioni in coda
+	unsigned testa, quante;
+	///Mutex e condition variable della coda (il lettore attende quando e' piena)
+	pthread_mutex_t m;
+	pthread_cond_t spazio;
+	///Booleano che indica che il lettore ha finito (fine del flusso o errore)
+	bool finito;
+	///Booleano che indica che il lettore si e' fermato per un errore (il client non ricevera' tutti i risultati)
+	bool interrotto;
+	///Booleano che indica che il client e' stato scollegato perche' non legge i risultati (o la connessione e' caduta)
+	bool staccato;
+	///Numero di operazioni inviate ai figli e di risultati consegnati al client
+	unsigned long inviati, consegnati;
+	///Numero d'ordine nel distributore delle ultime operazioni inviate, indicizzato da inviati%finestra (per i riferimenti $N)
+	unsigned long long *seq;
+	///Scrittura bufferizzata dei risultati sul socket
+	uscita u;
+	///Servizio a cui appartiene il client
+	struct servizio *s;
+	///Client successivo nella lista
+	struct connessione *succ;
+}cliente;
+
+///STRUTTURA CONTENENTE LO STATO DEL SERVIZIO SU SOCKET UNIX
+typedef struct servizio{
+	///Distributore (e regione) condiviso da tutti i client
+	dispatcher *d;
+	///Percorso del socket
+	const char *percorso;
+	///Socket in ascolto
+	int ascolto;
+	///Thread che accetta le connessioni
+	pthread_t accettatore;
+	///Mutex della lista dei nuovi client
+	pthread_mutex_t m;
+	///Client accettati e non ancora presi in carico dal padre
+	cliente *nuovi;
+	///Client presi in carico dal padre
+	cliente *attivi;
+	///Client di ciascuna operazione nella finestra, indicizzato da seq%finestra
+	cliente **canale;
+	///Contatore degli eventi (nuovi client, nuove operazioni, fine di un client) per non perdere risvegli
+	_Atomic unsigned long eventi;
+	///Booleano che indica che il servizio deve chiudere dopo aver servito i client connessi
+	_Atomic bool chiusura;
+	///Booleano che indica che il thread di accettazione ha terminato
+	_Atomic bool accettatore_finito;
+	///Numero di client accettati
+	int clienti;
+}servizio;
+
+void attesa_init(punto_attesa *p, int modo, int semaforo, int sem_num);
+void attesa_prepara(punto_attesa *p);
+void attesa_annulla(punto_attesa *p);
+int attesa_dormi(punto_attesa *p);
+void attesa_sveglia(punto_attesa *p);
+int semaforo_crea(key_t chiave, int n, bool *rimosso);
+
+void ring_init(spsc *r, void *dati, unsigned capacita, unsigned dim_elem);
+bool ring_inserisci(spsc *r, const void *e);
+bool ring_estrai(spsc *r, void *e);
+bool ring_vuoto(spsc *r);
+unsigned ring_occupati(spsc *r);
+void spmc_init(spmc *q, lavoro *dati, unsigned capacita);
+bool spmc_inserisci(spmc *q, const lavoro *l);
+bool spmc_estrai(spmc *q, lavoro *l);
+bool spmc_vuota(spmc *q);
+
+arena *arena_crea(int num_proc, unsigned profondita, unsigned finestra, int modo, int semaforo, const modello_costo *costi, const int *nodi);
+void arena_distruggi(arena *a);
+
+int affinita_piano(const char *spec, int num_proc, int *cpu, int *nodo);
+int affinita_applica(int cpu);
+void affinita_dove(int *cpu, int *nodo);
+int affinita_lega_memoria(void *ind, size_t dim, int nodo);
+int affinita_nodo_memoria(const void *ind);
+void arena_libera(arena *a, int j);
+void arena_occupa(arena *a, int j);
+int arena_cerca_libero(arena *a, int da);
+void arena_scrivi_valore(arena *a, unsigned long long seq, int res);
+bool arena_valore(const arena *a, unsigned long long seq, int *res);
+
+void esegui_figlio(arena *a, int id);
+
+int kernel_init(int tipo);
+const char *kernel_nome(int tipo);
+void kernel_calcola(char op, const int *a, const int *b, int *r, int n);
+void kernel_lotto(const lavoro *l, int *res, int n);
+
+int costo_indice(char op);
+void costo_init(modello_costo *m, long long ns);
+int costo_imposta(modello_costo *m, const char *spec);
+int costo_direttiva(modello_costo *m, const char *s, const char *fine);
+long long costo_campiona(const modello_costo *m, char op, unsigned long long *seme);
+void costo_attendi(long long ns);
+void costo_descrivi(const modello_costo *m, char s[]);
+void costo_scrivi(const modello_costo *m, int i, char s[]);
+
+void disp_init(dispatcher *d, arena *a, unsigned finestra, void (*consegna)(void *ctx, const risultato *r), void *ctx);
+int disp_invia(dispatcher *d, const lavoro *l);
+int disp_raccogli(dispatcher *d, bool attendi);
+void disp_svuota(dispatcher *d);
+void disp_termina(dispatcher *d);
+void disp_chiudi(dispatcher *d);
+void disp_riprendi(dispatcher *d, unsigned long long consegnati);
+void disp_elastico(dispatcher *d, int minimo, unsigned long long timeout, unsigned soglia, void (*avvia)(void *ctx, int j), void *ctx);
+
+unsigned long long orologio_ns(void);
+void isto_aggiungi(istogramma *h, unsigned long long ns);
+unsigned long long isto_percentile(const istogramma *h, double q);
+void stat_installa(dispatcher *d);
+void stat_controlla(dispatcher *d);
+void stat_stampa(const dispatcher *d);
+
+///Registra un evento nella traccia di chi (0 = padre, j = figlio j), solo se la traccia e' abilitata
+#define TRACCIA(a, chi, tipo, inizio, arg) do{ if((a)->tracce!=NULL) traccia_evento((a), (chi), (tipo), (inizio), (arg)); }while(0)
+///Istante corrente se la traccia e' abilitata, 0 altrimenti (nessuna lettura dell'orologio)
+#define TRACCIA_ORA(a) (((a)->tracce!=NULL) ? orologio_ns() : 0)
+
+int traccia_crea(arena *a);
+void traccia_evento(arena *a, int chi, int tipo, unsigned long long inizio, unsigned arg);
+long long traccia_scrivi(const arena *a, const char *nome);
+void traccia_distruggi(arena *a);
+
+int memo_crea(arena *a, unsigned voci);
+bool memo_cerca(const arena *a, int val1, char op, int val2, int *res);
+void memo_inserisci(arena *a, int val1, char op, int val2, int res, unsigned seq);
+void memo_distruggi(arena *a);
+
+int ripresa_apri(ripresa *r, const char *nome, int ingresso, bool binario, unsigned finestra, unsigned num_valori, unsigned long long intervallo, bool riprendi);
+void ripresa_segna(ripresa *r, unsigned long long seq, long long posizione, int riga);
+int ripresa_consegnato(ripresa *r, const risultato *x);
+int ripresa_salva(ripresa *r, unsigned long long consegnati);
+void ripresa_chiudi(ripresa *r, bool completata);
+
+int parser_apri(parser *p, const char *file_name);
+int parser_apri_fd(parser *p, int fd);
+int parser_intestazione(parser *p);
+int parser_prossimo(parser *p, lavoro *l);
+long long parser_posizione(const parser *p);
+int parser_riprendi(parser *p, long long posizione, int riga, int lavori);
+int parser_parallelo(parser *p, int num_thread);
+void parser_chiudi(parser *p);
+const char *leggi_intero(const char *s, const char *fine, int *val);
+
+int servizio_esegui(dispatcher *d, const char *percorso);
+
+int uscita_apri(uscita *u, int fd, bool binario, bool intestato);
+void uscita_scrivi(uscita *u, const char *s, size_t n);
+int uscita_svuota(uscita *u);
+int uscita_inoltra(uscita *u);
+int uscita_asincrona(uscita *u, size_t soglia, int fsync);
+void uscita_non_bloccante(uscita *u, size_t limite);
+void uscita_risultato(uscita *u, const risultato *r);
+size_t scrivi_intero(char *s, int n);
+int uscita_chiudi(uscita *u);
+
 
 #endif
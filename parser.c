@@ -0,0 +1,936 @@
+/**
+ * @file parser.c
+ * @author Marco Colognese
+*/
+
+#include "mylib.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <poll.h>
+
+///Esiti dell'analisi di una riga delle operazioni (analizza_riga())
+#define RIGA_MALFORMATA -1
+#define RIGA_OPERAZIONE 0
+#define RIGA_COMMENTO 1
+#define RIGA_VUOTA 2
+
+/**
+ * @brief Funzione che apre il file di configurazione e prepara la vista sui suoi byte.
+ *
+ *	Se il file e' regolare viene mappato in memoria con mmap(), cosi' la lettura non richiede
+ *	alcuna system call per byte. In caso contrario (pipe, mmap non riuscita) il file viene letto
+ *	a blocchi di PARSER_BLOCCO byte in un buffer che cresce solo se una riga non ci sta.
+ *	Il nome "-" indica lo standard input.
+ *
+ * @param p		parser da inizializzare
+ * @param file_name	nome del file da aprire ("-" = STDIN)
+ * @return		0 in caso di successo, -1 se il file non puo' essere aperto
+*/
+
+int parser_apri(parser *p, const char *file_name){
+	int fd=(strcmp(file_name, "-")==0) ? STDIN : open(file_name, O_RDONLY);
+
+	if(fd==-1)
+		return -1;
+	return parser_apri_fd(p, fd);
+}
+
+/**
+ * @brief Funzione che prepara il parser su un file descriptor gia' aperto (file, pipe o socket).
+ *
+ *	Il file descriptor passa al parser, che lo chiude in parser_chiudi() (tranne STDIN).
+ *
+ * @param p		parser da inizializzare
+ * @param fd		file descriptor da cui leggere
+ * @return		0 in caso di successo, -1 se il buffer non puo' essere allocato
+*/
+
+int parser_apri_fd(parser *p, int fd){
+	struct stat st;
+
+	memset(p, 0, sizeof(parser));
+	p->fd=fd;
+
+	if(fstat(p->fd, &st)==0 && S_ISREG(st.st_mode) && st.st_size>0){
+		p->base=mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, p->fd, 0);
+		if(p->base!=MAP_FAILED){
+			madvise(p->base, st.st_size, MADV_SEQUENTIAL);
+			p->len=st.st_size;
+			p->mappato=true;
+			p->eof=true;	//tutto il file e' gia' visibile
+			return 0;
+		}
+	}
+
+	//lettura a blocchi
+	p->cap=PARSER_BLOCCO;
+	if((p->base=(char *)malloc(p->cap))==NULL){
+		if(p->fd!=STDIN)
+			close(p->fd);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Funzione che libera le risorse del parser.
+ *
+ * @param p		parser da chiudere
+*/
+
+void parser_chiudi(parser *p){
+	lettura_parallela *lp=p->par;
+	int i;
+
+	if(lp!=NULL){
+		pthread_mutex_lock(&lp->m);
+		lp->basta=true;
+		pthread_cond_broadcast(&lp->libero);
+		pthread_mutex_unlock(&lp->m);
+		for(i=0; i<lp->num_thread; i++)
+			pthread_join(lp->thread[i], NULL);
+		for(i=0; i<lp->num_pezzi; i++)
+			free(lp->pezzi[i].v);
+		pthread_mutex_destroy(&lp->m);
+		pthread_cond_destroy(&lp->libero);
+		pthread_cond_destroy(&lp->pronto);
+		free(lp->pezzi);
+		free(lp->thread);
+		free(lp);
+		p->par=NULL;
+	}
+	if(p->mappato)
+		munmap(p->base, p->len);
+	else
+		free(p->base);
+	if(p->fd!=STDIN)
+		close(p->fd);
+	p->base=NULL;
+}
+
+/**
+ * @brief Funzione che legge dal file un nuovo blocco, spostando in testa al buffer la riga incompleta.
+ *
+ *	Se i dati non sono ancora disponibili (pipe o terminale) e il parser ha una funzione di
+ *	attesa, questa viene chiamata finche' ha lavoro da fare, controllando ogni millisecondo se
+ *	sono arrivati nuovi dati: cosi' il padre puo' consegnare i risultati pronti invece di
+ *	bloccarsi nella read().
+ *
+ * @param p		parser in modalita' a blocchi
+ * @return		numero di byte letti, 0 a fine file, -1 in caso di errore
+*/
+
+static int riempi(parser *p){
+	ssize_t r;
+
+	if(p->pos>0){
+		memmove(p->base, p->base+p->pos, p->len-p->pos);
+		p->scartati+=p->pos;
+		p->len-=p->pos;
+		p->pos=0;
+	}
+	//la riga corrente non sta nel buffer: lo raddoppio
+	if(p->len==p->cap){
+		char *nuovo=(char *)realloc(p->base, 2*p->cap);
+		if(nuovo==NULL)
+			return -1;
+		p->base=nuovo;
+		p->cap*=2;
+	}
+	if(p->attesa!=NULL){
+		struct pollfd pf={p->fd, POLLIN, 0};
+		while(poll(&pf, 1, 0)==0 && p->attesa(p->ctx))
+			poll(&pf, 1, 1);
+	}
+	do{
+		r=read(p->fd, p->base+p->len, p->cap-p->len);
+		//un segnale (es. SIGUSR1) interrompe l'attesa: il chiamante puo' gestirlo prima di tornare a leggere
+		if(r==-1 && errno==EINTR && p->attesa!=NULL)
+			p->attesa(p->ctx);
+	}while(r==-1 && errno==EINTR);
+	if(r==-1)
+		return -1;
+	if(r==0)
+		p->eof=true;
+	p->len+=r;
+	return r;
+}
+
+/**
+ * @brief Funzione che restituisce la prossima riga del file, senza il carattere '\n' finale.
+ *
+ * @param p		parser
+ * @param inizio	puntatore al primo carattere della riga
+ * @param fine		puntatore al carattere successivo all'ultimo della riga
+ * @return		1 se e' stata letta una riga, 0 a fine file, -1 in caso di errore
+*/
+
+static int prossima_riga(parser *p, const char **inizio, const char **fine){
+	char *nl;
+
+	if(p->sospesa){
+		*inizio=p->s_inizio;
+		*fine=p->s_fine;
+		p->sospesa=false;
+		return 1;
+	}
+	for(;;){
+		nl=(char *)memchr(p->base+p->pos, '\n', p->len-p->pos);
+		if(nl!=NULL){
+			*inizio=p->base+p->pos;
+			*fine=nl;
+			p->pos=nl-p->base+1;
+			break;
+		}
+		if(p->eof){
+			if(p->pos==p->len)
+				return 0;
+			//ultima riga senza '\n'
+			*inizio=p->base+p->pos;
+			*fine=p->base+p->len;
+			p->pos=p->len;
+			break;
+		}
+		if(riempi(p)==-1)
+			return -1;
+	}
+	p->riga++;
+	if(*fine>*inizio && (*fine)[-1]=='\r')
+		(*fine)--;
+	return 1;
+}
+
+/**
+ * @brief Funzione che garantisce che nel buffer ci siano almeno n byte non ancora letti.
+ *
+ * @param p		parser
+ * @param n		numero di byte richiesti
+ * @return		1 se i byte ci sono, 0 se il file finisce prima, -1 in caso di errore
+*/
+
+static int disponibili(parser *p, size_t n){
+	while(p->len-p->pos<n && !p->eof)
+		if(riempi(p)==-1)
+			return -1;
+	return p->len-p->pos>=n;
+}
+
+/**
+ * @brief Funzione che salta spazi e tabulazioni.
+ *
+ * @param s		posizione corrente
+ * @param fine		fine della riga
+ * @return		primo carattere che non e' uno spazio
+*/
+
+static const char *salta_spazi(const char *s, const char *fine){
+	while(s<fine && (*s==' ' || *s=='\t'))
+		s++;
+	return s;
+}
+
+/**
+ * @brief Funzione che legge un intero con segno dalla riga, sostituendo il vecchio calcolo_char().
+ *
+ *	Accetta un segno '-' o '+' opzionale seguito da almeno una cifra, e controlla che il valore
+ *	stia in un int.
+ *
+ * @param s		posizione del primo carattere dell'intero
+ * @param fine		fine della riga
+ * @param val		intero letto
+ * @return		puntatore al carattere successivo all'intero, NULL se l'intero non e' valido
+*/
+
+const char *leggi_intero(const char *s, const char *fine, int *val){
+	long long v=0;
+	bool neg=false;
+	const char *cifre;
+
+	if(s<fine && (*s=='-' || *s=='+')){
+		neg=(*s=='-');
+		s++;
+	}
+	cifre=s;
+	while(s<fine && (unsigned)(*s-'0')<10){
+		v=v*10+(*s-'0');
+		if(v>(long long)INT_MAX+1)
+			return NULL;
+		s++;
+	}
+	if(s==cifre)
+		return NULL;
+	if(neg)
+		v=-v;
+	if(v>INT_MAX)
+		return NULL;
+	*val=(int)v;
+	return s;
+}
+
+/**
+ * @brief Funzione che trasforma il riferimento $N di un operando nella distanza dall'operazione corrente.
+ *
+ *	N e' il numero dell'operazione di cui si usa il risultato, contando le operazioni valide del
+ *	file da 1 (il risultato e' la riga N del file dei risultati). Si puo' fare riferimento solo
+ *	alle operazioni precedenti, cosi' le dipendenze non formano mai un ciclo.
+ *
+ *	Il distributore conserva solo i risultati delle ultime operazioni: un riferimento che risale
+ *	piu' indietro di p->portata operazioni non puo' essere risolto. Non basta scartare la riga,
+ *	perche' cambierebbe la numerazione dei riferimenti successivi: la lettura si interrompe.
+ *
+ * @param p		parser, con p->lavori operazioni gia' lette
+ * @param val		N, sostituito dalla distanza (da 1 a p->lavori)
+ * @return		0 in caso di successo, -1 se il riferimento non e' valido, -2 se e' oltre la portata
+*/
+
+static int riferimento(parser *p, int *val){
+	if(*val<1 || *val>p->lavori)
+		return -1;
+	if(p->portata>0 && p->lavori+1-*val>p->portata)
+		return -2;
+	*val=p->lavori+1-*val;
+	return 0;
+}
+
+/**
+ * @brief Funzione che legge un operando dalla riga: un intero oppure un riferimento $N al risultato di un'operazione precedente.
+ *
+ *	Il riferimento viene solo letto: la distanza si calcola con riferimento(), quando si conosce
+ *	il numero delle operazioni precedenti.
+ *
+ * @param s		posizione del primo carattere dell'operando
+ * @param fine		fine della riga
+ * @param val		intero letto, o N
+ * @param rif		riferimenti dell'operazione, a cui si aggiunge bit se l'operando e' un riferimento
+ * @param bit		RIF_VAL1 o RIF_VAL2
+ * @return		puntatore al carattere successivo all'operando, NULL se l'operando non e' valido
+*/
+
+static const char *leggi_operando(const char *s, const char *fine, int *val, char *rif, int bit){
+	if(s<fine && *s=='$'){
+		if(s+1==fine || (unsigned)(s[1]-'0')>=10 || (s=leggi_intero(s+1, fine, val))==NULL)
+			return NULL;
+		*rif|=bit;
+		return s;
+	}
+	return leggi_intero(s, fine, val);
+}
+
+/**
+ * @brief Funzione che segnala su STDOUT una riga malformata del file di configurazione.
+ *
+ * @param p		parser
+ * @param motivo	descrizione dell'errore
+*/
+
+static void segnala_riga(parser *p, const char *motivo){
+	char stampa[256];
+
+	p->errori++;
+	if(p->binario)
+		sprintf(stampa, "Record %d malformato: %s\n", p->riga, motivo);
+	else
+		sprintf(stampa, "Riga %d malformata: %s\n", p->riga, motivo);
+	write(STDOUT, stampa, strlen(stampa));
+}
+
+/**
+ * @brief Funzione che segnala su STDOUT un riferimento $N oltre la portata della finestra, che interrompe la lettura.
+ *
+ * @param p		parser
+*/
+
+static void segnala_portata(parser *p){
+	char stampa[256];
+
+	sprintf(stampa, "%s %d: riferimento $N oltre %d operazioni, la portata della finestra: serve una finestra piu' grande (-f)\n", p->binario ? "Record" : "Riga", p->riga, p->portata);
+	write(STDOUT, stampa, strlen(stampa));
+}
+
+/**
+ * @brief Funzione che verifica se la riga e' una direttiva #costo.
+ *
+ * @param s		inizio della riga
+ * @param fine		fine della riga
+ * @return		true se la riga inizia con "#costo"
+*/
+
+static bool direttiva_costo(const char *s, const char *fine){
+	return fine-s>=6 && memcmp(s, "#costo", 6)==0;
+}
+
+/**
+ * @brief Funzione che legge l'intestazione di un file di operazioni nel formato binario.
+ *
+ *	La tabella dei costi dell'intestazione, se presente, prende il posto delle direttive #costo.
+ *
+ * @param p		parser, posizionato all'inizio del file
+ * @return		NUM_PROC, oppure -1 se l'intestazione non e' valida
+*/
+
+static int intestazione_binaria(parser *p){
+	intestazione_lavori t;
+	int i;
+
+	if(disponibili(p, sizeof(t))!=1){
+		segnala_riga(p, "intestazione incompleta");
+		return -1;
+	}
+	memcpy(&t, p->base+p->pos, sizeof(t));
+	p->pos+=sizeof(t);
+	if(t.versione!=FORMATO_VERSIONE || t.dim_record!=sizeof(record_lavoro)){
+		segnala_riga(p, "versione del formato non supportata");
+		return -1;
+	}
+	if(t.con_costi && p->costi!=NULL){
+		for(i=0; i<4; i++){
+			if(t.costi[i].tipo<COSTO_ZERO || t.costi[i].tipo>COSTO_ESPONENZIALE || t.costi[i].a<0 || t.costi[i].b<0){
+				segnala_riga(p, "costo non valido");
+				return -1;
+			}
+			p->costi->op[i].tipo=t.costi[i].tipo;
+			p->costi->op[i].a=t.costi[i].a;
+			p->costi->op[i].b=t.costi[i].b;
+		}
+	}
+	if(p->num_proc<=0)
+		p->num_proc=t.num_proc;
+	return p->num_proc;
+}
+
+/**
+ * @brief Funzione che legge un'operazione da un file nel formato binario.
+ *
+ *	Il record viene copiato direttamente dal file mappato (o dal buffer), senza alcuna
+ *	conversione da testo.
+ *
+ * @param p		parser
+ * @param l		operazione letta
+ * @return		1 se e' stata letta un'operazione, 0 a fine file, -1 in caso di errore di lettura
+*/
+
+static int prossimo_binario(parser *p, lavoro *l){
+	record_lavoro b;
+	int r, e=0;
+
+	while((r=disponibili(p, sizeof(b)))==1){
+		memcpy(&b, p->base+p->pos, sizeof(b));
+		p->pos+=sizeof(b);
+		p->riga++;
+		if(b.id<0 || b.id>p->num_proc){
+			segnala_riga(p, "id fuori intervallo");
+			continue;
+		}
+		if(costo_indice(b.op)==-1){
+			segnala_riga(p, "operazione non valida");
+			continue;
+		}
+		if(((b.rif&RIF_VAL1) && (e=riferimento(p, &b.val1))!=0) || ((b.rif&RIF_VAL2) && (e=riferimento(p, &b.val2))!=0)){
+			if(e==-2){
+				segnala_portata(p);
+				return -1;
+			}
+			segnala_riga(p, "riferimento non valido");
+			continue;
+		}
+		l->riga=p->riga;
+		l->id=b.id;
+		l->val1=b.val1;
+		l->op=b.op;
+		l->rif=b.rif&(RIF_VAL1|RIF_VAL2);
+		l->val2=b.val2;
+		p->lavori++;
+		return 1;
+	}
+	if(r==0 && p->pos<p->len){
+		p->riga++;
+		segnala_riga(p, "record incompleto");
+	}
+	if(r==-1)
+		write(STDOUT, "Errore in lettura del file\n", strlen("Errore in lettura del file\n"));
+	return r;
+}
+
+/**
+ * @brief Funzione che legge l'intestazione del file: il numero di processi NUM_PROC e le direttive.
+ *
+ *	Se p->num_proc e' gia' positivo (passato dalla riga di comando) la prima riga con il numero
+ *	di processi puo' mancare, e il file inizia direttamente con le direttive o con le operazioni;
+ *	se c'e' (una riga con il solo numero) viene ignorata.
+ *	Se il file inizia con MAGIA_LAVORI e' nel formato binario (vedi intestazione_binaria()).
+ *	Dopo la prima riga possono seguire righe di commento (che iniziano con '#') e direttive
+ *	"#costo" che descrivono il costo degli operatori (vedi costo_direttiva()); queste ultime
+ *	vengono salvate in p->costi, se presente. La prima riga che non inizia con '#' viene tenuta
+ *	da parte per parser_prossimo().
+ *
+ * @param p		parser
+ * @return		NUM_PROC, oppure -1 se il file e' vuoto o l'intestazione non e' valida
+*/
+
+int parser_intestazione(parser *p){
+	const char *s, *fine, *inizio;
+	int n, r;
+
+	if(disponibili(p, 4)==1 && memcmp(p->base+p->pos, MAGIA_LAVORI, 4)==0){
+		p->binario=true;
+		return intestazione_binaria(p);
+	}
+	if(p->num_proc>0){
+		n=p->num_proc;
+		if((r=prossima_riga(p, &s, &fine))!=1)
+			return (r==-1) ? -1 : n;
+		inizio=s;
+		s=leggi_intero(salta_spazi(s, fine), fine, &r);
+		if(s==NULL || salta_spazi(s, fine)!=fine){
+			p->sospesa=true;
+			p->s_inizio=inizio;
+			p->s_fine=fine;
+		}
+	}
+	else{
+		if(prossima_riga(p, &s, &fine)!=1)
+			return -1;
+		s=leggi_intero(salta_spazi(s, fine), fine, &n);
+		if(s==NULL || salta_spazi(s, fine)!=fine){
+			segnala_riga(p, "numero di processi non valido");
+			return -1;
+		}
+		p->num_proc=n;
+	}
+
+	while((r=prossima_riga(p, &s, &fine))==1){
+		if(s==fine || s[0]!='#'){
+			p->sospesa=true;
+			p->s_inizio=s;
+			p->s_fine=fine;
+			break;
+		}
+		if(direttiva_costo(s, fine) && (p->costi==NULL || costo_direttiva(p->costi, s, fine)==-1)){
+			segnala_riga(p, "direttiva di costo non valida");
+			return -1;
+		}
+	}
+	return (r==-1) ? -1 : n;
+}
+
+/**
+ * @brief Funzione che analizza una riga delle operazioni nel formato <id> <num1> <op> <num2>.
+ *
+ *	Non usa lo stato del parser, per poter essere chiamata anche dai thread di lettura
+ *	parallela: i riferimenti $N restano da trasformare con riferimenti().
+ *
+ * @param s		inizio della riga
+ * @param fine		fine della riga
+ * @param num_proc	numero di processi (gli id vanno da 0 a num_proc)
+ * @param l		operazione letta (senza numero di riga)
+ * @param motivo	descrizione dell'errore, se la riga e' malformata
+ * @return		RIGA_OPERAZIONE, RIGA_COMMENTO, RIGA_VUOTA o RIGA_MALFORMATA
+*/
+
+static int analizza_riga(const char *s, const char *fine, int num_proc, lavoro *l, const char **motivo){
+	s=salta_spazi(s, fine);
+	if(s==fine)
+		return RIGA_VUOTA;
+	if(*s=='#'){
+		//le direttive valgono solo nell'intestazione, i commenti sono ammessi ovunque
+		if(direttiva_costo(s, fine)){
+			*motivo="direttiva di costo dopo le operazioni";
+			return RIGA_MALFORMATA;
+		}
+		return RIGA_COMMENTO;
+	}
+
+	if((s=leggi_intero(s, fine, &l->id))==NULL){
+		*motivo="id non valido";
+		return RIGA_MALFORMATA;
+	}
+	if(l->id<0 || l->id>num_proc){
+		*motivo="id fuori intervallo";
+		return RIGA_MALFORMATA;
+	}
+	l->rif=0;
+	if((s=leggi_operando(salta_spazi(s, fine), fine, &l->val1, &l->rif, RIF_VAL1))==NULL){
+		*motivo="primo operando non valido";
+		return RIGA_MALFORMATA;
+	}
+	s=salta_spazi(s, fine);
+	if(s==fine || (*s!='+' && *s!='-' && *s!='*' && *s!='/') || (s+1<fine && s[1]!=' ' && s[1]!='\t')){
+		*motivo="operazione non valida";
+		return RIGA_MALFORMATA;
+	}
+	l->op=*s++;
+	if((s=leggi_operando(salta_spazi(s, fine), fine, &l->val2, &l->rif, RIF_VAL2))==NULL || salta_spazi(s, fine)!=fine){
+		*motivo="secondo operando non valido";
+		return RIGA_MALFORMATA;
+	}
+	return RIGA_OPERAZIONE;
+}
+
+/**
+ * @brief Funzione che trasforma i riferimenti $N di un'operazione appena letta nelle distanze, segnalando quelli non validi.
+ *
+ * @param p		parser, con p->lavori operazioni gia' lette e p->riga riga dell'operazione
+ * @param l		operazione
+ * @return		0 in caso di successo, -1 se un riferimento non e' valido (riga da scartare), -2 se e' oltre la portata (lettura da interrompere)
+*/
+
+static int riferimenti(parser *p, lavoro *l){
+	int r;
+
+	if((l->rif&RIF_VAL1) && (r=riferimento(p, &l->val1))!=0){
+		if(r==-2)
+			segnala_portata(p);
+		else
+			segnala_riga(p, "primo operando non valido");
+		return r;
+	}
+	if((l->rif&RIF_VAL2) && (r=riferimento(p, &l->val2))!=0){
+		if(r==-2)
+			segnala_portata(p);
+		else
+			segnala_riga(p, "secondo operando non valido");
+		return r;
+	}
+	return 0;
+}
+
+/**
+ * @brief Funzione che restituisce la prossima operazione gia' analizzata dai thread di lettura parallela.
+ *
+ *	I pezzi si consumano nell'ordine del file: i numeri di riga, le segnalazioni delle righe
+ *	malformate e i riferimenti $N sono gli stessi della lettura normale, e anche la posizione
+ *	nel file dopo ogni operazione (parser_posizione()), per i punti di ripresa.
+ *
+ * @param p		parser con la lettura parallela avviata
+ * @param l		operazione letta
+ * @return		1 se e' stata letta un'operazione, 0 a fine operazioni, -1 in caso di errore
+*/
+
+static int prossimo_parallelo(parser *p, lavoro *l){
+	lettura_parallela *lp=p->par;
+	pezzo_letto *z;
+	riga_letta *x;
+	int r;
+
+	for(;;){
+		if(lp->attuale==NULL){
+			if(lp->finite || lp->consumati==lp->totale)
+				return 0;
+			z=&lp->pezzi[lp->consumati%lp->num_pezzi];
+			pthread_mutex_lock(&lp->m);
+			while(z->indice!=lp->consumati || !z->pronto)
+				pthread_cond_wait(&lp->pronto, &lp->m);
+			pthread_mutex_unlock(&lp->m);
+			if(z->errore){
+				write(STDOUT, "Errore in lettura del file\n", strlen("Errore in lettura del file\n"));
+				return -1;
+			}
+			lp->attuale=z;
+			lp->k=0;
+		}
+		z=lp->attuale;
+		if(lp->k<z->n){
+			x=&z->v[lp->k++];
+			p->riga=lp->riga_base+x->l.riga;
+			p->pos=z->inizio+x->fine;
+			if(x->motivo!=NULL){
+				segnala_riga(p, x->motivo);
+				continue;
+			}
+			*l=x->l;
+			if((r=riferimenti(p, l))==-2)
+				return -1;
+			if(r==-1)
+				continue;
+			l->riga=p->riga;
+			p->lavori++;
+			return 1;
+		}
+
+		//pezzo finito: il posto torna libero per i thread
+		lp->riga_base+=z->righe;
+		p->riga=lp->riga_base;
+		p->pos=z->fine;
+		lp->attuale=NULL;
+		if(z->vuota)
+			lp->finite=true;
+		pthread_mutex_lock(&lp->m);
+		lp->consumati++;
+		pthread_cond_broadcast(&lp->libero);
+		pthread_mutex_unlock(&lp->m);
+	}
+}
+
+/**
+ * @brief Funzione che legge la prossima operazione nel formato <id> <num1> <op> <num2>.
+ *
+ *	Le righe malformate vengono segnalate con il loro numero e saltate. Come nel formato
+ *	originale, una riga vuota indica la fine delle operazioni. Ciascun operando puo' essere
+ *	anche $N, il risultato dell'N-esima operazione (vedi riferimento()).
+ *
+ * @param p		parser
+ * @param l		operazione letta
+ * @return		1 se e' stata letta un'operazione, 0 a fine operazioni, -1 in caso di errore di lettura o di un riferimento oltre la portata
+*/
+
+int parser_prossimo(parser *p, lavoro *l){
+	const char *s, *fine, *motivo;
+	int r;
+
+	if(p->binario)
+		return prossimo_binario(p, l);
+	if(p->par!=NULL)
+		return prossimo_parallelo(p, l);
+	while((r=prossima_riga(p, &s, &fine))==1){
+		switch(analizza_riga(s, fine, p->num_proc, l, &motivo)){
+			case RIGA_VUOTA:
+				return 0;	//riga vuota: fine delle operazioni
+			case RIGA_COMMENTO:
+				continue;
+			case RIGA_MALFORMATA:
+				segnala_riga(p, motivo);
+				continue;
+		}
+		if((r=riferimenti(p, l))==-2)
+			return -1;
+		if(r==-1)
+			continue;
+		l->riga=p->riga;
+		p->lavori++;
+		return 1;
+	}
+	if(r==-1)
+		write(STDOUT, "Errore in lettura del file\n", strlen("Errore in lettura del file\n"));
+	return r;
+}
+
+/**
+ * @brief Funzione che restituisce la posizione nel file del prossimo byte da leggere (dopo l'ultima operazione letta).
+ *
+ * @param p		parser
+ * @return		posizione in byte dall'inizio del file
+*/
+
+long long parser_posizione(const parser *p){
+	return p->scartati+(long long)p->pos;
+}
+
+/**
+ * @brief Funzione che riprende la lettura da un punto gia' raggiunto da un'esecuzione precedente sullo stesso file.
+ *
+ *	Va chiamata dopo parser_intestazione(). Il file mappato viene solo riposizionato; in
+ *	lettura a blocchi i byte fino alla posizione vengono letti e scartati. I contatori di righe
+ *	e di operazioni ripartono dai valori indicati, cosi' i numeri di riga e i riferimenti $N
+ *	restano quelli del file.
+ *
+ * @param p		parser
+ * @param posizione	posizione nel file dopo l'ultima operazione gia' svolta (parser_posizione())
+ * @param riga		riga (o record) dell'ultima operazione gia' svolta
+ * @param lavori	numero di operazioni valide gia' svolte
+ * @return		0 in caso di successo, -1 se il file finisce prima della posizione o in caso di errore
+*/
+
+int parser_riprendi(parser *p, long long posizione, int riga, int lavori){
+	long long manca;
+
+	p->sospesa=false;
+	while((manca=posizione-parser_posizione(p))>0){
+		if(p->pos==p->len && (p->eof || riempi(p)<=0))
+			return -1;
+		p->pos+=((long long)(p->len-p->pos)<manca) ? p->len-p->pos : (size_t)manca;
+	}
+	if(manca<0)
+		return -1;
+	p->riga=riga;
+	p->lavori=lavori;
+	return 0;
+}
+
+/**
+ * @brief Funzione che aggiunge una riga analizzata a un pezzo, allargando l'array se serve.
+ *
+ * @param z		pezzo
+ * @param x		riga analizzata
+ * @return		0 in caso di successo, -1 se l'allocazione fallisce
+*/
+
+static int aggiungi_riga(pezzo_letto *z, const riga_letta *x){
+	riga_letta *v;
+	int cap;
+
+	if(z->n==z->cap){
+		cap=(z->cap>0) ? 2*z->cap : 1024;
+		if((v=(riga_letta *)realloc(z->v, cap*sizeof(riga_letta)))==NULL)
+			return -1;
+		z->v=v;
+		z->cap=cap;
+	}
+	z->v[z->n++]=*x;
+	return 0;
+}
+
+/**
+ * @brief Funzione che analizza il pezzo i del file, eseguita da un thread di lettura parallela.
+ *
+ *	I pezzi sono di PEZZO_LETTURA byte a partire dall'inizio delle operazioni, spostati ai fine
+ *	riga: ogni riga appartiene al pezzo in cui si trova il suo primo byte. Le righe (anche i
+ *	commenti) si contano, cosi' il padre puo' ricostruire i numeri di riga; l'analisi si ferma
+ *	alla riga vuota, che termina le operazioni.
+ *
+ * @param lp		stato della lettura parallela
+ * @param z		posto del pezzo
+ * @param i		indice del pezzo
+*/
+
+static void analizza_pezzo(const lettura_parallela *lp, pezzo_letto *z, long long i){
+	const char *base=lp->base, *s, *fine, *e, *nl;
+	size_t a=lp->origine+(size_t)i*PEZZO_LETTURA, b=a+PEZZO_LETTURA;
+	riga_letta x;
+
+	if(b>lp->len)
+		b=lp->len;
+	if(i>0 && base[a-1]!='\n')
+		a=((nl=(const char *)memchr(base+a, '\n', lp->len-a))!=NULL) ? (size_t)(nl-base)+1 : lp->len;
+	if(b<lp->len && base[b-1]!='\n')
+		b=((nl=(const char *)memchr(base+b, '\n', lp->len-b))!=NULL) ? (size_t)(nl-base)+1 : lp->len;
+	if(a>b)
+		a=b;	//una sola riga copre tutto il pezzo: appartiene al precedente
+	z->inizio=a;
+	z->fine=b;
+	z->righe=0;
+	z->n=0;
+	z->vuota=false;
+	z->errore=false;
+
+	for(s=base+a, fine=base+b; s<fine; s=e){
+		nl=(const char *)memchr(s, '\n', fine-s);
+		e=(nl!=NULL) ? nl+1 : fine;
+		if(nl==NULL)
+			nl=fine;
+		if(nl>s && nl[-1]=='\r')
+			nl--;
+		z->righe++;
+		x.motivo=NULL;
+		switch(analizza_riga(s, nl, lp->num_proc, &x.l, &x.motivo)){
+			case RIGA_VUOTA:
+				z->vuota=true;
+				z->fine=e-base;
+				return;
+			case RIGA_COMMENTO:
+				continue;
+		}
+		x.l.riga=z->righe;
+		x.fine=(unsigned)(e-(base+a));
+		if(aggiungi_riga(z, &x)==-1){
+			z->errore=true;
+			return;
+		}
+	}
+}
+
+/**
+ * @brief Funzione eseguita dai thread di lettura parallela: prende il prossimo pezzo, quando il suo posto e' libero, e lo analizza.
+ *
+ * @param arg		stato della lettura parallela
+*/
+
+static void *leggi_pezzi(void *arg){
+	lettura_parallela *lp=(lettura_parallela *)arg;
+	pezzo_letto *z;
+	long long i;
+
+	pthread_mutex_lock(&lp->m);
+	for(;;){
+		while(!lp->basta && lp->prossimo<lp->totale && lp->prossimo>=lp->consumati+lp->num_pezzi)
+			pthread_cond_wait(&lp->libero, &lp->m);
+		if(lp->basta || lp->prossimo>=lp->totale)
+			break;
+		i=lp->prossimo++;
+		z=&lp->pezzi[i%lp->num_pezzi];
+		z->indice=i;
+		z->pronto=false;
+		pthread_mutex_unlock(&lp->m);
+
+		analizza_pezzo(lp, z, i);
+
+		pthread_mutex_lock(&lp->m);
+		z->pronto=true;
+		//dopo la riga vuota, o un errore, i pezzi successivi non servono
+		if(z->vuota || z->errore)
+			lp->basta=true;
+		pthread_cond_broadcast(&lp->pronto);
+	}
+	pthread_mutex_unlock(&lp->m);
+	return NULL;
+}
+
+/**
+ * @brief Funzione che avvia la lettura parallela delle operazioni, dal punto raggiunto dal parser.
+ *
+ *	Il resto del file viene diviso in pezzi di PEZZO_LETTURA byte, analizzati da num_thread
+ *	thread mentre il padre consuma i pezzi gia' pronti nell'ordine del file; al piu'
+ *	2*num_thread pezzi sono in memoria. Serve un file di testo mappato in memoria: in lettura
+ *	a blocchi o nel formato binario (in cui leggere un record costa gia' poco) si continua
+ *	con la lettura normale. Va chiamata dopo parser_intestazione() (e parser_riprendi()).
+ *
+ * @param p		parser
+ * @param num_thread	numero di thread di lettura
+ * @return		0 in caso di successo, -1 se la lettura parallela non e' possibile
+*/
+
+int parser_parallelo(parser *p, int num_thread){
+	lettura_parallela *lp;
+	int i;
+
+	if(!p->mappato || p->binario || num_thread<1 || p->par!=NULL)
+		return -1;
+	if((lp=(lettura_parallela *)calloc(1, sizeof(lettura_parallela)))==NULL)
+		return -1;
+	lp->num_pezzi=2*num_thread;
+	lp->pezzi=(pezzo_letto *)calloc(lp->num_pezzi, sizeof(pezzo_letto));
+	lp->thread=(pthread_t *)malloc(num_thread*sizeof(pthread_t));
+	if(lp->pezzi==NULL || lp->thread==NULL){
+		free(lp->pezzi);
+		free(lp->thread);
+		free(lp);
+		return -1;
+	}
+	for(i=0; i<lp->num_pezzi; i++)
+		lp->pezzi[i].indice=-1;
+
+	//una riga sospesa da parser_intestazione() va ancora letta: si riparte dal suo inizio
+	lp->origine=p->sospesa ? (size_t)(p->s_inizio-p->base) : p->pos;
+	lp->riga_base=p->sospesa ? p->riga-1 : p->riga;
+	p->sospesa=false;
+	lp->totale=(p->len-lp->origine+PEZZO_LETTURA-1)/PEZZO_LETTURA;
+	lp->base=p->base;
+	lp->len=p->len;
+	lp->num_proc=p->num_proc;
+	pthread_mutex_init(&lp->m, NULL);
+	pthread_cond_init(&lp->libero, NULL);
+	pthread_cond_init(&lp->pronto, NULL);
+
+	for(i=0; i<num_thread; i++)
+		if(pthread_create(&lp->thread[i], NULL, leggi_pezzi, lp)!=0)
+			break;
+	if(i==0){
+		p->sospesa=(lp->origine!=p->pos);
+		pthread_mutex_destroy(&lp->m);
+		pthread_cond_destroy(&lp->libero);
+		pthread_cond_destroy(&lp->pronto);
+		free(lp->pezzi);
+		free(lp->thread);
+		free(lp);
+		return -1;
+	}
+	lp->num_thread=i;
+	p->par=lp;
+	return 0;
+}
@@ -0,0 +1,165 @@
+/**
+ * @file ring.c
+ * @author Marco Colognese
+*/
+
+#include "mylib.h"
+#include <string.h>
+
+/**
+ * @brief Funzione che inizializza una coda circolare a singolo produttore e singolo consumatore.
+ *
+ * @param r		coda da inizializzare
+ * @param dati		spazio per gli elementi (capacita*dim_elem byte)
+ * @param capacita	numero di elementi, potenza di 2
+ * @param dim_elem	dimensione di un elemento
+*/
+
+void ring_init(spsc *r, void *dati, unsigned capacita, unsigned dim_elem){
+	atomic_init(&r->testa, 0);
+	atomic_init(&r->coda, 0);
+	r->coda_vista=0;
+	r->testa_vista=0;
+	r->maschera=capacita-1;
+	r->dim_elem=dim_elem;
+	r->dati=(char *)dati;
+}
+
+/**
+ * @brief Funzione (del produttore) che inserisce un elemento in coda senza mai bloccarsi.
+ *
+ *	Il produttore rilegge l'indice del consumatore solo quando la sua copia locale dice che la
+ *	coda e' piena, cosi' la linea di cache del consumatore non viene toccata ad ogni inserimento.
+ *
+ * @param r		coda
+ * @param e		elemento da copiare in coda
+ * @return		true se l'elemento e' stato inserito, false se la coda e' piena
+*/
+
+bool ring_inserisci(spsc *r, const void *e){
+	unsigned c=atomic_load_explicit(&r->coda, memory_order_relaxed);
+
+	if(c-r->testa_vista>r->maschera){
+		r->testa_vista=atomic_load_explicit(&r->testa, memory_order_acquire);
+		if(c-r->testa_vista>r->maschera)
+			return false;
+	}
+	memcpy(r->dati+(size_t)(c&r->maschera)*r->dim_elem, e, r->dim_elem);
+	atomic_store_explicit(&r->coda, c+1, memory_order_release);
+	return true;
+}
+
+/**
+ * @brief Funzione (del consumatore) che estrae un elemento dalla coda senza mai bloccarsi.
+ *
+ * @param r		coda
+ * @param e		spazio in cui copiare l'elemento estratto
+ * @return		true se e' stato estratto un elemento, false se la coda e' vuota
+*/
+
+bool ring_estrai(spsc *r, void *e){
+	unsigned t=atomic_load_explicit(&r->testa, memory_order_relaxed);
+
+	if(t==r->coda_vista){
+		r->coda_vista=atomic_load_explicit(&r->coda, memory_order_acquire);
+		if(t==r->coda_vista)
+			return false;
+	}
+	memcpy(e, r->dati+(size_t)(t&r->maschera)*r->dim_elem, r->dim_elem);
+	atomic_store_explicit(&r->testa, t+1, memory_order_release);
+	return true;
+}
+
+/**
+ * @brief Funzione che verifica se la coda e' vuota, rileggendo entrambi gli indici.
+ *
+ * @param r		coda
+ * @return		true se la coda e' vuota
+*/
+
+bool ring_vuoto(spsc *r){
+	return atomic_load_explicit(&r->testa, memory_order_acquire)==atomic_load_explicit(&r->coda, memory_order_acquire);
+}
+
+/**
+ * @brief Funzione che restituisce il numero di elementi presenti in coda.
+ *
+ * @param r		coda
+ * @return		numero di elementi
+*/
+
+unsigned ring_occupati(spsc *r){
+	return atomic_load_explicit(&r->coda, memory_order_acquire)-atomic_load_explicit(&r->testa, memory_order_acquire);
+}
+
+/**
+ * @brief Funzione che inizializza una coda a singolo produttore e piu' consumatori (per il furto di lavoro).
+ *
+ * @param q		coda da inizializzare
+ * @param dati		spazio per gli elementi
+ * @param capacita	numero di elementi, potenza di 2
+*/
+
+void spmc_init(spmc *q, lavoro *dati, unsigned capacita){
+	atomic_init(&q->testa, 0);
+	atomic_init(&q->coda, 0);
+	q->testa_vista=0;
+	q->maschera=capacita-1;
+	q->dati=dati;
+}
+
+/**
+ * @brief Funzione (del padre, unico produttore) che inserisce un'operazione senza mai bloccarsi.
+ *
+ * @param q		coda
+ * @param l		operazione da inserire
+ * @return		true se l'operazione e' stata inserita, false se la coda e' piena
+*/
+
+bool spmc_inserisci(spmc *q, const lavoro *l){
+	unsigned c=atomic_load_explicit(&q->coda, memory_order_relaxed);
+
+	if(c-q->testa_vista>q->maschera){
+		q->testa_vista=atomic_load_explicit(&q->testa, memory_order_acquire);
+		if(c-q->testa_vista>q->maschera)
+			return false;
+	}
+	q->dati[c&q->maschera]=*l;
+	atomic_store_explicit(&q->coda, c+1, memory_order_release);
+	return true;
+}
+
+/**
+ * @brief Funzione che estrae un'operazione: la usa sia il figlio proprietario sia i figli che rubano.
+ *
+ *	I consumatori si contendono la testa con una compare-and-swap. L'elemento viene copiato
+ *	prima della CAS: se nel frattempo un altro consumatore lo ha preso (e il padre ha gia'
+ *	riscritto la posizione), la CAS fallisce e la copia viene scartata.
+ *
+ * @param q		coda
+ * @param l		spazio in cui copiare l'operazione estratta
+ * @return		true se e' stata estratta un'operazione, false se la coda e' vuota
+*/
+
+bool spmc_estrai(spmc *q, lavoro *l){
+	unsigned t=atomic_load_explicit(&q->testa, memory_order_acquire);
+
+	for(;;){
+		if(t==atomic_load_explicit(&q->coda, memory_order_acquire))
+			return false;
+		*l=q->dati[t&q->maschera];
+		if(atomic_compare_exchange_weak_explicit(&q->testa, &t, t+1, memory_order_acq_rel, memory_order_acquire))
+			return true;
+	}
+}
+
+/**
+ * @brief Funzione che verifica se la coda e' vuota.
+ *
+ * @param q		coda
+ * @return		true se la coda e' vuota
+*/
+
+bool spmc_vuota(spmc *q){
+	return atomic_load_explicit(&q->testa, memory_order_acquire)==atomic_load_explicit(&q->coda, memory_order_acquire);
+}
@@ -0,0 +1,251 @@
+/**
+ * @file ripresa.c
+ * @author Marco Colognese
+*/
+
+#include "mylib.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @brief Funzione che restituisce il punto di ripresa piu' recente del file, se c'e'.
+ *
+ * @param m		intestazione del file di ripresa
+ * @return		indice del punto (0 o 1), -1 se nessun punto e' mai stato scritto
+*/
+
+static int ultimo_punto(const intestazione_ripresa *m){
+	if(m->punto[0].generazione==0 && m->punto[1].generazione==0)
+		return -1;
+	return (m->punto[1].generazione>m->punto[0].generazione) ? 1 : 0;
+}
+
+/**
+ * @brief Funzione che apre (o crea) il file di ripresa di una simulazione e, se richiesto, legge il punto da cui riprendere.
+ *
+ *	Il file viene mappato in memoria: un punto di ripresa e' solo una copia in memoria e
+ *	sopravvive all'uccisione del padre, perche' le pagine restano al kernel. Il file e' legato al
+ *	file delle operazioni (dispositivo, i-node, dimensione e ultima modifica) e al formato dei
+ *	risultati: se non corrispondono la ripresa viene rifiutata. Senza riprendi, o se il file non
+ *	contiene alcun punto, la simulazione parte dall'inizio e i punti precedenti vengono scartati.
+ *	Il file con il punto ripreso viene sostituito (rename()) solo quando quello nuovo e' su disco.
+ *	Dopo la chiamata, r->ripreso e' il punto da cui riprendere (generazione 0 = dall'inizio) e
+ *	r->valori contiene i risultati delle ultime operazioni gia' consegnate.
+ *
+ * @param r		stato da inizializzare
+ * @param nome		nome del file di ripresa
+ * @param ingresso	file descriptor del file delle operazioni (un file regolare)
+ * @param binario	booleano che indica se il file dei risultati e' nel formato binario
+ * @param finestra	finestra del distributore
+ * @param num_valori	numero di risultati da salvare in ogni punto (la dimensione della tabella dei valori)
+ * @param intervallo	operazioni consegnate tra due punti di ripresa
+ * @param riprendi	booleano che indica se riprendere dall'ultimo punto salvato
+ * @return		0 in caso di successo, -1 in caso di errore, -2 se il file di ripresa appartiene a un altro file di operazioni
+*/
+
+int ripresa_apri(ripresa *r, const char *nome, int ingresso, bool binario, unsigned finestra, unsigned num_valori, unsigned long long intervallo, bool riprendi){
+	intestazione_ripresa *m, vecchia, nuova;
+	struct stat in, st;
+	unsigned long long seq, fine;
+	char *nuovo=NULL;
+	int k, fd;
+
+	memset(r, 0, sizeof(ripresa));
+	r->nome=nome;
+	if(fstat(ingresso, &in)==-1 || !S_ISREG(in.st_mode))
+		return -1;
+	r->num_valori=num_valori;
+	r->finestra=finestra;
+	r->intervallo=(intervallo>0) ? intervallo : RIPRESA_INTERVALLO;
+	r->posizione=(long long *)malloc(finestra*sizeof(long long));
+	r->riga=(int *)malloc(finestra*sizeof(int));
+	r->valori=(int *)calloc(num_valori, sizeof(int));
+	if(r->posizione==NULL || r->riga==NULL || r->valori==NULL)
+		goto errore;
+	if((r->fd=open(nome, O_RDWR|O_CREAT, 0666))==-1)
+		goto errore;
+
+	//il punto da cui riprendere si legge prima di ridimensionare il file
+	memset(&vecchia, 0, sizeof(vecchia));
+	k=-1;
+	if(riprendi && fstat(r->fd, &st)==0 && st.st_size>=(off_t)sizeof(vecchia) && pread(r->fd, &vecchia, sizeof(vecchia), 0)==(ssize_t)sizeof(vecchia) && memcmp(vecchia.magia, MAGIA_RIPRESA, 4)==0 && vecchia.versione==FORMATO_VERSIONE && st.st_size>=(off_t)(sizeof(vecchia)+2*(size_t)vecchia.num_valori*sizeof(int32_t)) && (k=ultimo_punto(&vecchia))!=-1){
+		if(vecchia.dispositivo!=(uint64_t)in.st_dev || vecchia.inode!=(uint64_t)in.st_ino || vecchia.dimensione!=(int64_t)in.st_size || vecchia.modifica_ns!=(int64_t)in.st_mtim.tv_sec*1000000000LL+in.st_mtim.tv_nsec || vecchia.binario!=binario){
+			close(r->fd);
+			free(r->posizione);
+			free(r->riga);
+			free(r->valori);
+			return -2;
+		}
+		//i risultati delle ultime operazioni consegnate, per i riferimenti $N delle successive
+		r->ripreso=vecchia.punto[k];
+		fine=r->ripreso.consegnati;
+		for(seq=(fine>vecchia.num_valori) ? fine-vecchia.num_valori : 0; seq<fine; seq++){
+			if(fine-seq>num_valori)
+				continue;
+			if(pread(r->fd, &r->valori[seq%num_valori], sizeof(int32_t), sizeof(vecchia)+((size_t)k*vecchia.num_valori+seq%vecchia.num_valori)*sizeof(int32_t))!=(ssize_t)sizeof(int32_t))
+				goto errore_file;
+		}
+	}
+
+	//con un punto da riprendere il file nuovo si prepara a parte e prende il posto del vecchio solo
+	//quando e' completo e su disco: fino ad allora il punto ripreso resta valido nel file vecchio
+	fd=r->fd;
+	if(k!=-1){
+		if((nuovo=(char *)malloc(strlen(nome)+strlen(".nuovo")+1))==NULL)
+			goto errore_file;
+		sprintf(nuovo, "%s.nuovo", nome);
+		if((fd=open(nuovo, O_RDWR|O_CREAT|O_TRUNC, 0666))==-1)
+			goto errore_nuovo;
+	}
+	r->dim=sizeof(intestazione_ripresa)+2*(size_t)num_valori*sizeof(int32_t);
+	if(ftruncate(fd, r->dim)==-1)
+		goto errore_nuovo;
+	m=(intestazione_ripresa *)mmap(NULL, r->dim, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	if(m==(intestazione_ripresa *)MAP_FAILED)
+		goto errore_nuovo;
+	r->m=m;
+	r->salvati[0]=(int32_t *)(m+1);
+	r->salvati[1]=r->salvati[0]+num_valori;
+
+	//intestazione di questa esecuzione, copiata nel file in un solo passo
+	memset(&nuova, 0, sizeof(nuova));
+	memcpy(nuova.magia, MAGIA_RIPRESA, 4);
+	nuova.versione=FORMATO_VERSIONE;
+	nuova.binario=binario;
+	nuova.dispositivo=in.st_dev;
+	nuova.inode=in.st_ino;
+	nuova.dimensione=in.st_size;
+	nuova.modifica_ns=(int64_t)in.st_mtim.tv_sec*1000000000LL+in.st_mtim.tv_nsec;
+	nuova.num_valori=num_valori;
+	if(k!=-1){
+		nuova.punto[0]=r->ripreso;
+		memcpy(r->salvati[0], r->valori, num_valori*sizeof(int32_t));
+	}
+	memcpy(m, &nuova, sizeof(nuova));
+	if(msync(m, r->dim, MS_SYNC)==-1)
+		goto errore_mappa;
+	if(k!=-1){
+		if(rename(nuovo, nome)==-1)
+			goto errore_mappa;
+		close(r->fd);
+		r->fd=fd;
+		free(nuovo);
+	}
+	return 0;
+
+errore_mappa:
+	munmap(r->m, r->dim);
+errore_nuovo:
+	if(k!=-1){
+		if(fd!=-1){
+			close(fd);
+			unlink(nuovo);
+		}
+		free(nuovo);
+	}
+errore_file:
+	close(r->fd);
+errore:
+	free(r->posizione);
+	free(r->riga);
+	free(r->valori);
+	r->m=NULL;
+	return -1;
+}
+
+/**
+ * @brief Funzione che ricorda dove finisce nel file delle operazioni l'operazione seq, appena inviata.
+ *
+ *	Il posto seq%finestra e' libero: va chiamata dopo che la finestra del distributore ha
+ *	spazio, cioe' quando l'operazione seq-finestra e' gia' stata consegnata.
+ *
+ * @param r		stato dei punti di ripresa
+ * @param seq		numero d'ordine dell'operazione
+ * @param posizione	posizione nel file dopo l'operazione (parser_posizione())
+ * @param riga		riga (o record) dell'operazione
+*/
+
+void ripresa_segna(ripresa *r, unsigned long long seq, long long posizione, int riga){
+	r->posizione[seq%r->finestra]=posizione;
+	r->riga[seq%r->finestra]=riga;
+}
+
+/**
+ * @brief Funzione chiamata per ogni risultato consegnato, nell'ordine: ne ricorda il valore e, ogni intervallo operazioni, scrive un punto di ripresa.
+ *
+ * @param r		stato dei punti di ripresa
+ * @param x		risultato appena scritto nel file dei risultati
+ * @return		0 in caso di successo, -1 se il punto di ripresa non e' stato scritto
+*/
+
+int ripresa_consegnato(ripresa *r, const risultato *x){
+	r->valori[x->seq%r->num_valori]=x->res;
+	if((x->seq+1ULL)%r->intervallo!=0)
+		return 0;
+	return ripresa_salva(r, x->seq+1ULL);
+}
+
+/**
+ * @brief Funzione che scrive un punto di ripresa dopo le prime consegnati operazioni, tutte gia' consegnate.
+ *
+ *	I risultati vengono prima scritti e portati su disco (fdatasync), poi si riempie il punto
+ *	piu' vecchio dei due e solo alla fine, dopo averlo portato su disco, gli si assegna la
+ *	generazione successiva: un'interruzione in qualunque momento lascia valido almeno un
+ *	punto, che non va mai oltre i risultati davvero scritti.
+ *
+ * @param r		stato dei punti di ripresa
+ * @param consegnati	numero di operazioni consegnate (almeno 1)
+ * @return		0 in caso di successo, -1 in caso di errore
+*/
+
+int ripresa_salva(ripresa *r, unsigned long long consegnati){
+	intestazione_ripresa *m=r->m;
+	punto_ripresa *p;
+	uint64_t generazione;
+	off_t dim;
+	int k=ultimo_punto(m);
+
+	if(uscita_svuota(r->u)==-1 || fdatasync(r->u->fd)==-1 || (dim=lseek(r->u->fd, 0, SEEK_CUR))==-1)
+		return -1;
+	generazione=(k==-1) ? 1 : m->punto[k].generazione+1;
+	k=(k==-1) ? 0 : 1-k;
+	p=&m->punto[k];
+	p->generazione=0;
+	p->consegnati=consegnati;
+	p->posizione=r->posizione[(consegnati-1)%r->finestra];
+	p->riga=r->riga[(consegnati-1)%r->finestra];
+	p->dim_uscita=dim;
+	memcpy(r->salvati[k], r->valori, r->num_valori*sizeof(int32_t));
+	if(msync(m, r->dim, MS_SYNC)==-1)
+		return -1;
+	p->generazione=generazione;
+	//la generazione sta in una sola pagina: se non arriva su disco vale il punto precedente, e il punto non viene contato
+	if(msync(m, sizeof(intestazione_ripresa), MS_SYNC)==-1)
+		return -1;
+	r->scritti++;
+	return 0;
+}
+
+/**
+ * @brief Funzione che chiude il file di ripresa.
+ *
+ * @param r		stato dei punti di ripresa
+ * @param completata	booleano che indica se la simulazione e' terminata: il file non serve piu' e viene rimosso
+*/
+
+void ripresa_chiudi(ripresa *r, bool completata){
+	if(r->m!=NULL)
+		munmap(r->m, r->dim);
+	close(r->fd);
+	if(completata)
+		unlink(r->nome);
+	free(r->posizione);
+	free(r->riga);
+	free(r->valori);
+	r->m=NULL;
+}
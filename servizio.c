@@ -0,0 +1,482 @@
+/**
+ * @file servizio.c
+ * @author Marco Colognese
+*/
+
+#include "mylib.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+///Servizio in esecuzione, per il gestore dei segnali
+static servizio *corrente=NULL;
+
+/**
+ * @brief Funzione che segnala al padre un evento (nuovo client, nuove operazioni, fine di un client) e lo sveglia.
+ *
+ * @param s		servizio
+*/
+
+static void segnala(servizio *s){
+	atomic_fetch_add(&s->eventi, 1);
+	attesa_sveglia(&s->d->a->padre);
+}
+
+/**
+ * @brief Gestore di SIGTERM e SIGINT: il servizio smette di accettare client e chiude dopo aver servito quelli connessi.
+*/
+
+static void chiudi_servizio(int sig){
+	(void)sig;
+	if(corrente!=NULL){
+		atomic_store(&corrente->chiusura, true);
+		segnala(corrente);
+	}
+}
+
+/**
+ * @brief Funzione eseguita dal thread lettore di ciascun client: legge le operazioni dal socket e le mette nella coda del client.
+ *
+ *	Il flusso ha lo stesso formato di un file di configurazione (testo o binario); il numero di
+ *	processi e' quello del servizio, quindi la prima riga puo' mancare, e le direttive #costo
+ *	vengono ignorate. Quando la coda e' piena il lettore attende che il padre ne invii una parte
+ *	ai figli: il client viene cosi' rallentato senza usare altra memoria.
+ *
+ * @param arg		client
+ * @return		NULL
+*/
+
+static void *leggi_cliente(void *arg){
+	cliente *c=(cliente *)arg;
+	lavoro l;
+	int r=0;
+
+	c->p.num_proc=c->s->d->a->num_proc;
+	//i numeri d'ordine delle operazioni del client si ricordano solo per le ultime finestra (vedi traduci_riferimenti())
+	c->p.portata=(int)c->s->d->finestra;
+	c->p.costi=&c->costi;
+	if(parser_intestazione(&c->p)!=-1){
+		while((r=parser_prossimo(&c->p, &l))==1){
+			pthread_mutex_lock(&c->m);
+			while(c->quante==CODA_CLIENTE)
+				pthread_cond_wait(&c->spazio, &c->m);
+			c->coda[(c->testa+c->quante)%CODA_CLIENTE]=l;
+			c->quante++;
+			pthread_mutex_unlock(&c->m);
+			segnala(c->s);
+		}
+	}
+	parser_chiudi(&c->p);
+	pthread_mutex_lock(&c->m);
+	c->interrotto=(r==-1);
+	c->finito=true;
+	pthread_mutex_unlock(&c->m);
+	segnala(c->s);
+	return NULL;
+}
+
+/**
+ * @brief Funzione che crea lo stato di un client appena connesso e avvia il suo thread lettore.
+ *
+ * @param s		servizio
+ * @param fd		socket del client
+ * @return		client, oppure NULL in caso di errore (il socket viene chiuso)
+*/
+
+static cliente *nuovo_cliente(servizio *s, int fd){
+	cliente *c=(cliente *)calloc(1, sizeof(cliente));
+	int letto;
+
+	if(c==NULL || (c->coda=(lavoro *)malloc(CODA_CLIENTE*sizeof(lavoro)))==NULL || (c->seq=(unsigned long long *)malloc(s->d->finestra*sizeof(unsigned long long)))==NULL)
+		goto errore;
+	//il parser legge da una copia del socket, che chiude a fine flusso; i risultati usano l'originale
+	if((letto=dup(fd))==-1)
+		goto errore;
+	if(parser_apri_fd(&c->p, letto)==-1)
+		goto errore;
+	if(uscita_apri(&c->u, fd, false, false)==-1){
+		parser_chiudi(&c->p);
+		goto errore;
+	}
+	//il padre non deve mai bloccarsi sul socket di un client che non legge i risultati
+	uscita_non_bloccante(&c->u, LIMITE_CLIENTE);
+	c->fd=fd;
+	c->num=++s->clienti;
+	c->s=s;
+	costo_init(&c->costi, 0);
+	pthread_mutex_init(&c->m, NULL);
+	pthread_cond_init(&c->spazio, NULL);
+	if(pthread_create(&c->lettore, NULL, leggi_cliente, c)!=0){
+		parser_chiudi(&c->p);
+		uscita_chiudi(&c->u);
+		free(c->coda);
+		free(c->seq);
+		free(c);
+		return NULL;
+	}
+	return c;
+
+errore:
+	if(c!=NULL){
+		free(c->coda);
+		free(c->seq);
+	}
+	free(c);
+	close(fd);
+	return NULL;
+}
+
+/**
+ * @brief Funzione eseguita dal thread che accetta le connessioni, finche' il servizio non deve chiudere.
+ *
+ * @param arg		servizio
+ * @return		NULL
+*/
+
+static void *accetta(void *arg){
+	servizio *s=(servizio *)arg;
+	struct pollfd pf={s->ascolto, POLLIN, 0};
+	char stampa[128];	//array di char per le stampe di sprintf
+	cliente *c;
+	int fd;
+
+	while(!atomic_load(&s->chiusura)){
+		//il timeout permette di accorgersi della chiusura anche senza connessioni
+		if(poll(&pf, 1, 100)<=0){
+			//con l'insieme elastico il padre deve poter ritirare i figli inattivi anche senza client
+			if(s->d->avvia!=NULL)
+				segnala(s);
+			continue;
+		}
+		if((fd=accept(s->ascolto, NULL, NULL))==-1)
+			continue;
+		if((c=nuovo_cliente(s, fd))==NULL){
+			write(STDOUT, "Servizio: client rifiutato\n", strlen("Servizio: client rifiutato\n"));
+			continue;
+		}
+		sprintf(stampa, "Servizio: client %d connesso\n", c->num);
+		write(STDOUT, stampa, strlen(stampa));
+		pthread_mutex_lock(&s->m);
+		c->succ=s->nuovi;
+		s->nuovi=c;
+		pthread_mutex_unlock(&s->m);
+		segnala(s);
+	}
+	close(s->ascolto);
+	unlink(s->percorso);
+	atomic_store(&s->accettatore_finito, true);
+	segnala(s);
+	return NULL;
+}
+
+/**
+ * @brief Funzione chiamata dal distributore per ogni risultato: lo scrive al client che ha inviato l'operazione.
+ *
+ * @param ctx		servizio
+ * @param r		risultato prelevato
+*/
+
+static void consegna_cliente(void *ctx, const risultato *r){
+	servizio *s=(servizio *)ctx;
+	cliente *c=s->canale[r->seq%s->d->finestra];
+
+	if(!c->staccato)
+		uscita_risultato(&c->u, r);
+	c->consegnati++;
+}
+
+/**
+ * @brief Funzione che scollega un client: chiude la connessione e scarta i suoi risultati e le sue operazioni non ancora inviate.
+ *
+ *	Le operazioni gia' inviate ai figli vengono comunque completate: il client viene liberato
+ *	da chiudi_cliente() dopo l'ultimo risultato, come gli altri.
+ *
+ * @param c		client
+ * @param motivo	motivo, per la stampa
+*/
+
+static void stacca_cliente(cliente *c, const char *motivo){
+	char stampa[256];	//array di char per le stampe di sprintf
+
+	c->staccato=true;
+	c->u.len=0;
+	//il lettore vede la fine del flusso e termina
+	shutdown(c->fd, SHUT_RDWR);
+	sprintf(stampa, "Servizio: client %d scollegato: %s\n", c->num, motivo);
+	write(STDOUT, stampa, strlen(stampa));
+}
+
+/**
+ * @brief Funzione che traduce i riferimenti ($N) di un'operazione del client, che contano solo le sue operazioni, nella distanza tra i numeri d'ordine del distributore.
+ *
+ *	Il parser del client scarta i riferimenti a piu' di finestra operazioni del client prima. Tra
+ *	le operazioni del client possono pero' esserci quelle degli altri client: se l'operazione
+ *	riferita e' ormai fuori dalla tabella dei valori del distributore il riferimento non si puo'
+ *	risolvere.
+ *
+ * @param d		distributore
+ * @param c		client
+ * @param l		operazione, che avra' numero d'ordine d->inviati
+ * @return		0 in caso di successo, -1 se un riferimento non si puo' risolvere
+*/
+
+static int traduci_riferimenti(dispatcher *d, cliente *c, lavoro *l){
+	int *op[2]={&l->val1, &l->val2};
+	unsigned long long distanza;
+	int k;
+
+	for(k=0; k<2; k++){
+		if(!(l->rif&(RIF_VAL1<<k)))
+			continue;
+		distanza=(unsigned)*op[k];
+		if(distanza==0 || distanza>d->finestra || distanza>c->inviati)
+			return -1;
+		distanza=d->inviati-c->seq[(c->inviati-distanza)%d->finestra];
+		if(distanza>=d->a->num_valori)
+			return -1;
+		*op[k]=(int)distanza;
+	}
+	return 0;
+}
+
+/**
+ * @brief Funzione che invia ai figli le operazioni in coda di un client.
+ *
+ * @param s		servizio
+ * @param c		client
+ * @return		numero di operazioni inviate
+*/
+
+static int invia_cliente(servizio *s, cliente *c){
+	lavoro l[LOTTO];
+	dispatcher *d=s->d;
+	int n, i;
+
+	pthread_mutex_lock(&c->m);
+	for(n=0; n<LOTTO && c->quante>0; n++){
+		l[n]=c->coda[c->testa];
+		c->testa=(c->testa+1)%CODA_CLIENTE;
+		c->quante--;
+	}
+	if(n>0)
+		pthread_cond_signal(&c->spazio);
+	pthread_mutex_unlock(&c->m);
+	//le operazioni di un client scollegato vengono scartate
+	if(c->staccato)
+		return n;
+
+	for(i=0; i<n; i++){
+		//disp_invia() assegna all'operazione il numero d'ordine d->inviati: il posto nel canale si
+		//puo' riusare solo quando la finestra ha spazio, cioe' dopo la consegna dell'operazione che lo occupava
+		while(d->inviati-d->consegnati>=d->finestra)
+			disp_raccogli(d, true);
+		if(l[i].rif!=0 && traduci_riferimenti(d, c, &l[i])==-1){
+			//meglio chiudere il client che dargli un risultato sbagliato
+			stacca_cliente(c, "riferimento $N a un'operazione il cui risultato non e' piu' disponibile");
+			return n;
+		}
+		s->canale[d->inviati%d->finestra]=c;
+		c->seq[c->inviati%d->finestra]=d->inviati;
+		c->inviati++;
+		if(disp_invia(d, &l[i])==-1){
+			//l'operazione rifiutata non ha numero d'ordine e non avra' risultato
+			c->inviati--;
+			stacca_cliente(c, "riferimento $N oltre la tabella dei valori");
+			return n;
+		}
+	}
+	return n;
+}
+
+/**
+ * @brief Funzione che verifica se un client ha finito e ha ricevuto tutti i risultati, e in tal caso lo chiude.
+ *
+ * @param c		client
+ * @return		true se il client e' stato chiuso
+*/
+
+static bool chiudi_cliente(cliente *c){
+	char stampa[128];	//array di char per le stampe di sprintf
+	bool finito;
+
+	pthread_mutex_lock(&c->m);
+	finito=c->finito && c->quante==0;
+	pthread_mutex_unlock(&c->m);
+	//si chiude dopo che il socket ha accettato l'ultimo risultato
+	if(!finito || c->consegnati!=c->inviati || c->u.len>0)
+		return false;
+
+	pthread_join(c->lettore, NULL);
+	uscita_chiudi(&c->u);
+	if(!c->staccato){
+		sprintf(stampa, "Servizio: client %d servito, %lu operazioni\n", c->num, c->inviati);
+		write(STDOUT, stampa, strlen(stampa));
+	}
+	pthread_mutex_destroy(&c->m);
+	pthread_cond_destroy(&c->spazio);
+	free(c->coda);
+	free(c->seq);
+	free(c);
+	return true;
+}
+
+/**
+ * @brief Funzione che esegue il padre come servizio: accetta client su un socket Unix e svolge le loro operazioni con i figli gia' avviati.
+ *
+ *	Ogni client invia un flusso di operazioni e riceve i risultati, nell'ordine delle sue
+ *	operazioni, sullo stesso socket, man mano che sono pronti; chiude il flusso con shutdown()
+ *	in scrittura, e il servizio chiude la connessione dopo l'ultimo risultato. Piu' client
+ *	possono essere connessi insieme: le loro operazioni si mescolano nelle code dei figli, che
+ *	restano attivi tra un client e l'altro. Il padre scrive i risultati senza mai bloccarsi
+ *	(uscita_non_bloccante()): quelli che il socket non accetta restano nel buffer del client e
+ *	vengono riprovati quando il socket torna scrivibile. Un client che lascia non letti piu' di
+ *	LIMITE_CLIENTE byte di risultati viene scollegato, cosi' non rallenta gli altri client.
+ *
+ *	Solo il padre usa il distributore: un thread accetta le connessioni e un thread per client
+ *	legge le operazioni, e tutti svegliano il padre sul suo punto di attesa, come fanno i figli
+ *	quando depositano un risultato. Con SIGTERM o SIGINT il servizio smette di accettare client,
+ *	serve quelli gia' connessi e ritorna; il chiamante termina poi i figli come al solito.
+ *
+ * @param d		distributore, gia' inizializzato sulla regione dei figli
+ * @param percorso	percorso del socket da creare
+ * @return		0 alla chiusura del servizio, -1 se il socket non puo' essere creato
+*/
+
+int servizio_esegui(dispatcher *d, const char *percorso){
+	servizio s;
+	struct sockaddr_un ind;
+	struct sigaction sa;
+	sigset_t segnali, vecchi;
+	cliente *c, **pc, *succ;
+	unsigned long visti;
+	struct pollfd pf[64];	//socket dei client con risultati in sospeso
+	bool lavoro, interrotto;
+	int j, n;
+
+	memset(&s, 0, sizeof(s));
+	s.d=d;
+	s.percorso=percorso;
+	if(strlen(percorso)>=sizeof(ind.sun_path)){
+		write(STDOUT, "Percorso del socket troppo lungo\n", strlen("Percorso del socket troppo lungo\n"));
+		return -1;
+	}
+	memset(&ind, 0, sizeof(ind));
+	ind.sun_family=AF_UNIX;
+	strcpy(ind.sun_path, percorso);
+	if((s.ascolto=socket(AF_UNIX, SOCK_STREAM, 0))==-1 || bind(s.ascolto, (struct sockaddr *)&ind, sizeof(ind))==-1 || listen(s.ascolto, 64)==-1){
+		write(STDOUT, "Creazione del socket non riuscita\n", strlen("Creazione del socket non riuscita\n"));
+		if(s.ascolto!=-1)
+			close(s.ascolto);
+		return -1;
+	}
+	if((s.canale=(cliente **)calloc(d->finestra, sizeof(cliente *)))==NULL){
+		close(s.ascolto);
+		unlink(percorso);
+		return -1;
+	}
+	pthread_mutex_init(&s.m, NULL);
+	d->consegna=consegna_cliente;
+	d->ctx=&s;
+
+	//i segnali arrivano solo al padre: i thread ereditano la maschera con SIGTERM, SIGINT e SIGUSR1 bloccati
+	corrente=&s;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler=chiudi_servizio;
+	sigaction(SIGTERM, &sa, NULL);
+	sigaction(SIGINT, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);	//un client che chiude prima del tempo non deve uccidere il servizio
+	sigemptyset(&segnali);
+	sigaddset(&segnali, SIGTERM);
+	sigaddset(&segnali, SIGINT);
+	sigaddset(&segnali, SIGUSR1);
+	pthread_sigmask(SIG_BLOCK, &segnali, &vecchi);
+	pthread_create(&s.accettatore, NULL, accetta, &s);
+	pthread_sigmask(SIG_SETMASK, &vecchi, NULL);
+
+	write(STDOUT, "Servizio: in ascolto\n", strlen("Servizio: in ascolto\n"));
+	for(;;){
+		visti=atomic_load(&s.eventi);
+		lavoro=false;
+
+		//presa in carico dei nuovi client
+		pthread_mutex_lock(&s.m);
+		while((c=s.nuovi)!=NULL){
+			s.nuovi=c->succ;
+			c->succ=s.attivi;
+			s.attivi=c;
+		}
+		pthread_mutex_unlock(&s.m);
+
+		//operazioni dei client, un lotto per client alla volta
+		for(c=s.attivi; c!=NULL; c=c->succ)
+			if(invia_cliente(&s, c)>0)
+				lavoro=true;
+		if(disp_raccogli(d, false)>0)
+			lavoro=true;
+
+		//risultati pronti e client serviti
+		for(pc=&s.attivi; (c=*pc)!=NULL;){
+			if(!c->staccato && c->u.len>0)
+				uscita_svuota(&c->u);
+			if(!c->staccato && c->u.errore)
+				stacca_cliente(c, "non legge i risultati o ha chiuso la connessione");
+			pthread_mutex_lock(&c->m);
+			interrotto=c->interrotto && c->quante==0;
+			pthread_mutex_unlock(&c->m);
+			//un flusso interrotto (riferimento oltre la portata) non deve sembrare servito per intero
+			if(!c->staccato && interrotto)
+				stacca_cliente(c, "lettura delle operazioni interrotta");
+			//chiudi_cliente() libera c
+			succ=c->succ;
+			if(chiudi_cliente(c)){
+				*pc=succ;
+				lavoro=true;
+			}
+			else
+				pc=&c->succ;
+		}
+
+		if(atomic_load(&s.accettatore_finito) && s.attivi==NULL && s.nuovi==NULL)
+			break;
+		if(lavoro)
+			continue;
+
+		//client con risultati in sospeso: si attende per poco che un socket torni scrivibile, poi si ricontrollano i figli
+		for(n=0, c=s.attivi; c!=NULL && n<(int)(sizeof(pf)/sizeof(pf[0])); c=c->succ)
+			if(!c->staccato && c->u.len>0){
+				pf[n].fd=c->fd;
+				pf[n].events=POLLOUT;
+				pf[n].revents=0;
+				n++;
+			}
+		if(n>0){
+			poll(pf, n, 1);
+			continue;
+		}
+
+		//nulla da fare: attendo un risultato o un evento, ricontrollando dopo l'annuncio
+		attesa_prepara(&d->a->padre);
+		for(j=0; j<d->a->num_proc; j++)
+			if(!ring_vuoto(&d->a->slot[j].risultati))
+				break;
+		if(j<d->a->num_proc || atomic_load(&s.eventi)!=visti)
+			attesa_annulla(&d->a->padre);
+		else
+			attesa_dormi(&d->a->padre);
+	}
+
+	pthread_join(s.accettatore, NULL);
+	corrente=NULL;
+	signal(SIGTERM, SIG_DFL);
+	signal(SIGINT, SIG_DFL);
+	pthread_mutex_destroy(&s.m);
+	free(s.canale);
+	write(STDOUT, "Servizio: chiuso\n", strlen("Servizio: chiuso\n"));
+	return 0;
+}
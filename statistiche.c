@@ -0,0 +1,170 @@
+/**
+ * @file statistiche.c
+ * @author Marco Colognese
+*/
+
+#include "mylib.h"
+#include <string.h>
+#include <stdio.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+///Distributore di cui stampare le statistiche alla ricezione di SIGUSR1
+static dispatcher *osservato=NULL;
+
+///Booleano impostato dal gestore di SIGUSR1 e controllato dal padre
+static volatile sig_atomic_t richiesta=0;
+
+/**
+ * @brief Funzione che restituisce l'istante corrente in nanosecondi (orologio monotono, senza system call grazie al vDSO).
+ *
+ * @return		nanosecondi da un istante arbitrario
+*/
+
+unsigned long long orologio_ns(void){
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (unsigned long long)t.tv_sec*1000000000ULL+t.tv_nsec;
+}
+
+/**
+ * @brief Funzione che aggiunge una latenza all'istogramma.
+ *
+ * @param h		istogramma
+ * @param ns		latenza in nanosecondi
+*/
+
+void isto_aggiungi(istogramma *h, unsigned long long ns){
+	h->classi[ns ? 63-__builtin_clzll(ns) : 0]++;
+	h->n++;
+	h->somma+=ns;
+	if(ns>h->massimo)
+		h->massimo=ns;
+}
+
+/**
+ * @brief Funzione che stima un percentile dell'istogramma.
+ *
+ *	Dentro la classe che contiene il percentile le latenze si considerano distribuite
+ *	uniformemente: il valore e' interpolato tra i limiti della classe (al piu' il massimo
+ *	osservato), cosi' l'errore resta entro la larghezza della classe.
+ *
+ * @param h		istogramma
+ * @param q		percentile, tra 0 e 1
+ * @return		latenza in nanosecondi (0 se l'istogramma e' vuoto)
+*/
+
+unsigned long long isto_percentile(const istogramma *h, double q){
+	double soglia=q*h->n, visti=0, basso, alto, stima;
+	int k;
+
+	if(h->n==0)
+		return 0;
+	if(q>=1)
+		return h->massimo;
+	for(k=0; k<ISTO_CLASSI-1; k++){
+		if(visti+h->classi[k]>=soglia && h->classi[k]>0)
+			break;
+		visti+=h->classi[k];
+	}
+	basso=(k==0) ? 0 : (double)(1ULL<<k);
+	alto=(double)(2ULL<<k);
+	if(alto>h->massimo)
+		alto=h->massimo;
+	stima=basso+(alto-basso)*(soglia-visti)/h->classi[k];
+	return (stima<h->massimo) ? (unsigned long long)stima : h->massimo;
+}
+
+/**
+ * @brief Funzione che stampa una riga di statistiche di un istogramma.
+ *
+ * @param nome		nome della latenza
+ * @param h		istogramma
+*/
+
+static void stampa_isto(const char *nome, const istogramma *h){
+	char stampa[512];	//array di char per le stampe di sprintf
+
+	sprintf(stampa, "STAT padre latenza=%s n=%llu media_ns=%llu p50_ns=%llu p90_ns=%llu p99_ns=%llu max_ns=%llu\n", nome, h->n, h->n ? h->somma/h->n : 0, isto_percentile(h, 0.5), isto_percentile(h, 0.9), isto_percentile(h, 0.99), h->massimo);
+	write(STDOUT, stampa, strlen(stampa));
+}
+
+/**
+ * @brief Funzione che stampa su STDOUT le statistiche di padre e figli, una riga "STAT" chiave=valore per volta.
+ *
+ *	Per i figli: operazioni, lotti, operazioni condivise, addormentamenti e il tempo diviso in
+ *	calcolo, attesa sul punto di attesa e inattivita' (il resto della vita del figlio: ricerca di
+ *	lavoro e attesa attiva), la CPU e il nodo NUMA su cui girano e il nodo delle pagine delle loro
+ *	code (-1 se non disponibile). Per il padre: gli istogrammi di latenza di inoltro e di
+ *	completamento, le operazioni messe da parte, il tempo bloccato in attesa dei risultati e la
+ *	CPU su cui gira, con i figli attivi, avviati e ritirati (-E) e le operazioni che hanno atteso
+ *	un risultato o seguito nella stessa coda quella da cui dipendono ($N) e le operazioni trovate
+ *	e non trovate nella cache dei risultati (-M).
+ *
+ * @param d		distributore
+*/
+
+void stat_stampa(const dispatcher *d){
+	const arena *a=d->a;
+	const contatori *c;
+	char stampa[512];	//array di char per le stampe di sprintf
+	unsigned long long ora=orologio_ns(), vita, occupato;
+	int j, cpu, nodo;
+
+	for(j=0; j<a->num_proc; j++){
+		c=&a->slot[j].stat;
+		vita=(c->ns_inizio==0) ? 0 : ((c->ns_fine ? c->ns_fine : ora)-c->ns_inizio);
+		occupato=c->ns_calcolo+c->ns_attesa;
+		sprintf(stampa, "STAT figlio=%d lavori=%llu lotti=%llu condivise=%llu addormentamenti=%llu ns_calcolo=%llu ns_attesa=%llu ns_inattivo=%llu ns_simulato=%llu cpu=%d nodo=%d nodo_code=%d\n", j+1, c->lavori, c->lotti, c->condivise, c->addormentamenti, c->ns_calcolo, c->ns_attesa, (vita>occupato) ? vita-occupato : 0, a->slot[j].tempo_simulato, c->cpu, c->nodo, affinita_nodo_memoria(a->slot[j].code));
+		write(STDOUT, stampa, strlen(stampa));
+	}
+	stampa_isto("inoltro", &d->inoltro);
+	stampa_isto("completamento", &d->completamento);
+	affinita_dove(&cpu, &nodo);
+	sprintf(stampa, "STAT padre inviati=%llu consegnati=%llu parcheggiate=%llu ns_attesa=%llu cpu=%d nodo=%d attivi=%d avvii=%llu ritiri=%llu dipendenti=%llu concatenate=%llu memo_successi=%llu memo_mancati=%llu\n", d->inviati, d->consegnati, d->parcheggiate, d->ns_attesa, cpu, nodo, d->attivi, d->avvii, d->ritiri, d->dipendenti, d->concatenate, d->memo_successi, d->memo_mancati);
+	write(STDOUT, stampa, strlen(stampa));
+}
+
+/**
+ * @brief Gestore di SIGUSR1: chiede al padre di stampare le statistiche e lo sveglia se sta aspettando.
+*/
+
+static void richiedi(int sig){
+	(void)sig;
+	richiesta=1;
+	if(osservato!=NULL)
+		attesa_sveglia(&osservato->a->padre);
+}
+
+/**
+ * @brief Funzione che installa il gestore di SIGUSR1 per il distributore d.
+ *
+ *	Le statistiche non vengono stampate nel gestore, ma dal padre in stat_controlla(), chiamata
+ *	dal distributore ad ogni raccolta dei risultati.
+ *
+ * @param d		distributore
+*/
+
+void stat_installa(dispatcher *d){
+	struct sigaction sa;
+
+	osservato=d;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler=richiedi;	//senza SA_RESTART: una lettura bloccata del file viene interrotta
+	sigaction(SIGUSR1, &sa, NULL);
+}
+
+/**
+ * @brief Funzione che stampa le statistiche se e' arrivato SIGUSR1.
+ *
+ * @param d		distributore
+*/
+
+void stat_controlla(dispatcher *d){
+	if(richiesta && d==osservato){
+		richiesta=0;
+		stat_stampa(d);
+	}
+}
@@ -0,0 +1,244 @@
+/**
+ * @file sync.c
+ * @author Marco Colognese
+*/
+
+#include "mylib.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/sem.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+///Numero massimo di giri di attesa attiva prima di addormentarsi (0 su macchine con una sola CPU)
+static unsigned giri_max=SPIN_MAX;
+
+/**
+ * @brief Funzione che segnala alla CPU che si sta facendo attesa attiva.
+*/
+
+static inline void rilassa(void){
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#endif
+}
+
+/**
+ * @brief Funzione che inizializza un punto di attesa.
+ *
+ *	Con SYNC_SYSV il processo dorme sul semaforo sem_num dell'array semaforo; con SYNC_FUTEX
+ *	dorme direttamente sul campo dorme con una futex, senza alcun oggetto IPC.
+ *
+ * @param p		punto di attesa
+ * @param modo		SYNC_SYSV oppure SYNC_FUTEX
+ * @param semaforo	id dell'array di semafori (solo SYNC_SYSV)
+ * @param sem_num	indice del semaforo su cui addormentarsi (solo SYNC_SYSV)
+*/
+
+void attesa_init(punto_attesa *p, int modo, int semaforo, int sem_num){
+	//con una sola CPU chi fa attesa attiva impedisce a chi deve svegliarlo di girare
+	if(sysconf(_SC_NPROCESSORS_ONLN)<2)
+		giri_max=0;
+	atomic_init(&p->dorme, 0);
+	p->modo=modo;
+	p->semaforo=semaforo;
+	p->sem_num=sem_num;
+	p->giri=giri_max/4;
+}
+
+/**
+ * @brief Funzione che annuncia che il processo sta per addormentarsi.
+ *
+ *	Dopo questa chiamata il processo deve ricontrollare la propria condizione (ad esempio che la
+ *	coda sia ancora vuota) e solo allora chiamare attesa_dormi(), oppure attesa_annulla().
+ *	La barriera garantisce che chi inserisce dopo il controllo veda il flag e lo svegli.
+ *
+ * @param p		punto di attesa
+*/
+
+void attesa_prepara(punto_attesa *p){
+	atomic_store_explicit(&p->dorme, 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+}
+
+/**
+ * @brief Funzione che ritira l'annuncio fatto con attesa_prepara().
+ *
+ * @param p		punto di attesa
+*/
+
+void attesa_annulla(punto_attesa *p){
+	atomic_store_explicit(&p->dorme, 0, memory_order_relaxed);
+}
+
+/**
+ * @brief Funzione che blocca il processo finche' non viene svegliato.
+ *
+ *	Con SYNC_FUTEX il processo prima fa al piu' giri cicli di attesa attiva aspettando che
+ *	qualcuno azzeri dorme (in quella fase chi sveglia non fa system call); poi passa dorme a 2 e
+ *	si addormenta nel kernel. Il numero di giri si adatta: raddoppia quando l'attesa attiva
+ *	basta, si dimezza quando non basta.
+ *	Il risveglio puo' essere spurio: il chiamante deve sempre ricontrollare la condizione.
+ *
+ * @param p		punto di attesa
+ * @return		0 al risveglio, -1 se il semaforo non esiste piu'
+*/
+
+int attesa_dormi(punto_attesa *p){
+	struct sembuf sops;
+	unsigned i;
+	int uno=1;
+
+	if(p->modo==SYNC_SYSV){
+		sops.sem_num=p->sem_num;
+		sops.sem_op=-1;
+		sops.sem_flg=0;
+		while(semop(p->semaforo, &sops, 1)==-1)
+			if(errno!=EINTR)
+				return -1;
+		return 0;
+	}
+
+	//fase di attesa attiva
+	for(i=0; i<p->giri; i++){
+		if(atomic_load_explicit(&p->dorme, memory_order_acquire)==0){
+			p->giri=(2*p->giri<giri_max) ? 2*p->giri : giri_max;
+			return 0;
+		}
+		rilassa();
+	}
+	p->giri/=2;
+	if(p->giri<SPIN_MIN && giri_max>0)
+		p->giri=SPIN_MIN;
+
+	//fase di attesa nel kernel: dorme=2 dice a chi sveglia di chiamare FUTEX_WAKE
+	if(atomic_compare_exchange_strong(&p->dorme, &uno, 2))
+		while(atomic_load_explicit(&p->dorme, memory_order_acquire)==2)
+			syscall(SYS_futex, &p->dorme, FUTEX_WAIT, 2, NULL, NULL, 0);
+	return 0;
+}
+
+/**
+ * @brief Funzione che sveglia il processo in attesa sul punto, se sta dormendo.
+ *
+ *	Se nessuno dorme non viene fatta alcuna system call: il costo e' una sola lettura atomica.
+ *
+ * @param p		punto di attesa
+*/
+
+void attesa_sveglia(punto_attesa *p){
+	struct sembuf sops;
+	int prima;
+
+	atomic_thread_fence(memory_order_seq_cst);
+	if(atomic_load_explicit(&p->dorme, memory_order_relaxed)==0 || (prima=atomic_exchange(&p->dorme, 0))==0)
+		return;
+	if(p->modo==SYNC_SYSV){
+		sops.sem_num=p->sem_num;
+		sops.sem_op=1;
+		sops.sem_flg=0;
+		semop(p->semaforo, &sops, 1);
+	}
+	else if(prima==2)
+		syscall(SYS_futex, &p->dorme, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+/**
+ * @brief Funzione che verifica se un processo e' vivo: esiste e non e' uno zombie in attesa di essere raccolto.
+ *
+ * @param pid		processo
+ * @return		true se il processo e' vivo
+*/
+
+static bool vivo(int pid){
+	char percorso[64], stato[512], *fine;
+	ssize_t n;
+	int fd;
+
+	if(kill(pid, 0)==-1 && errno!=EPERM)
+		return false;
+	sprintf(percorso, "/proc/%d/stat", pid);
+	if((fd=open(percorso, O_RDONLY))==-1)
+		return true;
+	n=read(fd, stato, sizeof(stato)-1);
+	close(fd);
+	if(n<=0)
+		return true;
+	stato[n]='\0';
+	//il nome del processo puo' contenere spazi e parentesi: lo stato segue l'ultima ')'
+	return (fine=strrchr(stato, ')'))==NULL || fine[1]=='\0' || fine[2]!='Z';
+}
+
+/**
+ * @brief Funzione che verifica se un array di semafori e' stato lasciato da un'esecuzione terminata senza rimuoverlo.
+ *
+ *	Per ogni semaforo il kernel ricorda il processo dell'ultima semop(): l'array e' abbandonato
+ *	se nessuno di questi processi e' ancora vivo (vedi vivo()). Un array su cui non e' mai stata fatta una
+ *	semop() e' considerato abbandonato solo se e' stato creato da piu' di ABBANDONO_S secondi,
+ *	per non rimuovere quello appena creato da un'altra esecuzione.
+ *
+ * @param semaforo	id dell'array di semafori
+ * @return		true se l'array e' abbandonato
+*/
+
+static bool abbandonato(int semaforo){
+	struct semid_ds ds;
+	bool usato=false;
+	unsigned short k;
+	int pid;
+
+	if(semctl(semaforo, 0, IPC_STAT, &ds)==-1)
+		return false;
+	for(k=0; k<ds.sem_nsems; k++){
+		if((pid=semctl(semaforo, k, GETPID))<=0)
+			continue;
+		usato=true;
+		if(vivo(pid))
+			return false;
+	}
+	return usato || time(NULL)-ds.sem_ctime>ABBANDONO_S;
+}
+
+/**
+ * @brief Funzione che crea in modo esclusivo l'array di n semafori con la chiave indicata, tutti a 0.
+ *
+ *	Se la chiave e' gia' in uso da un array abbandonato (un'esecuzione uccisa prima di
+ *	rimuoverlo), l'array viene rimosso e la creazione ripetuta. Il creatore fa subito una
+ *	semop() nulla sull'ultimo semaforo, cosi' il kernel lo registra come processo vivo
+ *	dell'array fin dall'inizio.
+ *
+ * @param chiave	chiave dell'array (ftok)
+ * @param n		numero di semafori
+ * @param rimosso	booleano impostato se e' stato rimosso un array abbandonato
+ * @return		id dell'array, -1 in caso di errore (o se l'array esistente e' in uso)
+*/
+
+int semaforo_crea(key_t chiave, int n, bool *rimosso){
+	struct sembuf sops;
+	unsigned short *valori;
+	int semaforo, vecchio;
+
+	*rimosso=false;
+	while((semaforo=semget(chiave, n, IPC_CREAT|IPC_EXCL|0666))==-1){
+		if(errno!=EEXIST || *rimosso || (vecchio=semget(chiave, 0, 0))==-1 || !abbandonato(vecchio) || semctl(vecchio, 0, IPC_RMID, 0)==-1)
+			return -1;
+		*rimosso=true;
+	}
+	if((valori=(unsigned short *)calloc(n, sizeof(unsigned short)))==NULL){
+		semctl(semaforo, 0, IPC_RMID, 0);
+		return -1;
+	}
+	semctl(semaforo, 0, SETALL, valori);
+	free(valori);
+	sops.sem_num=n-1;
+	sops.sem_op=0;
+	sops.sem_flg=IPC_NOWAIT;
+	semop(semaforo, &sops, 1);
+	return semaforo;
+}
@@ -0,0 +1,109 @@
+#!/bin/sh
+#
+# Prove di regressione (make test), da lanciare dalla cartella del progetto dopo make.
+#
+# Ogni prova confronta i risultati con quelli attesi (test/*.atteso, calcolati a parte in
+# aritmetica modulo 2^32) o con un'esecuzione di riferimento dello stesso file:
+#	1. kernel scalare, sse2 e avx2 contro il calcolo di un'operazione alla volta (prova_kernel);
+#	2. valori limite, divisione per zero e INT_MIN/-1 (limiti.txt) e riferimenti $N (dipendenze.txt);
+#	3. conversione testo -> binario -> testo, e risultati binari (-B) riconvertiti con convertitore -r;
+#	4. lettura parallela (-L) contro la lettura normale;
+#	5. riferimento $N oltre la portata di una finestra piccola (-f);
+#	6. ripresa (-P) dopo l'uccisione del padre a meta' simulazione.
+# I semafori usano ftok("father.c"): le prove vanno lanciate dalla cartella dei sorgenti.
+
+PROVE=$(dirname "$0")
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+falliti=0
+
+# esito codice nome: stampa l'esito di una prova e conta quelle fallite
+esito(){
+	if [ "$1" -eq 0 ]; then
+		echo "ok      $2"
+	else
+		echo "FALLITA $2"
+		falliti=$((falliti+1))
+	fi
+}
+
+# simula [opzioni di father]: esegue father senza costi simulati, con le stampe in $TMP/log
+simula(){
+	./father -c zero "$@" >"$TMP/log" 2>&1
+}
+
+# confronta file_risultati file_atteso [opzioni di father] file_operazioni
+confronta(){
+	r=$1
+	a=$2
+	shift 2
+	simula -o "$r" "$@" && cmp -s "$r" "$a"
+}
+
+# 1. kernel
+"$PROVE/prova_kernel" >"$TMP/log" 2>&1
+esito $? "kernel SIMD e scalare sui valori limite ($(tr '\n' ' ' <"$TMP/log"))"
+
+# 2. risultati attesi
+for opzioni in "" "-w" "-b thread" "-r 1 -w"; do
+	confronta "$TMP/r.txt" "$PROVE/limiti.atteso" $opzioni "$PROVE/limiti.txt"
+	esito $? "limiti.txt $opzioni"
+	confronta "$TMP/r.txt" "$PROVE/dipendenze.atteso" $opzioni "$PROVE/dipendenze.txt"
+	esito $? "dipendenze.txt $opzioni"
+done
+confronta "$TMP/r.txt" "$PROVE/dipendenze.atteso" -f 16 "$PROVE/dipendenze.txt"
+esito $? "dipendenze.txt -f 16 (portata 31)"
+
+# 3. conversione
+./convertitore "$PROVE/dipendenze.txt" "$TMP/d.bin" >"$TMP/log" &&
+	./convertitore "$TMP/d.bin" "$TMP/d.txt" >"$TMP/log" &&
+	./convertitore "$TMP/d.txt" "$TMP/d2.bin" >"$TMP/log" &&
+	cmp -s "$TMP/d.bin" "$TMP/d2.bin"
+esito $? "conversione testo -> binario -> testo -> binario"
+confronta "$TMP/r.txt" "$PROVE/dipendenze.atteso" "$TMP/d.bin"
+esito $? "dipendenze in formato binario"
+simula -B -o "$TMP/r.bin" "$PROVE/limiti.txt" &&
+	./convertitore -r "$TMP/r.bin" "$TMP/r.txt" >"$TMP/log" &&
+	cmp -s "$TMP/r.txt" "$PROVE/limiti.atteso"
+esito $? "risultati binari (-B) riconvertiti in testo"
+
+# 4. lettura parallela: il file deve occupare piu' pezzi da PEZZO_LETTURA byte
+./generatore -n 60000 -p 4 -d 0.2:20 -s 3 "$TMP/g.txt" >"$TMP/log" &&
+	simula -o "$TMP/serie.txt" "$TMP/g.txt" &&
+	confronta "$TMP/r.txt" "$TMP/serie.txt" -L 3 "$TMP/g.txt" &&
+	grep -q "lettura del file con 3 thread" "$TMP/log"
+esito $? "lettura parallela (-L 3) come la lettura normale"
+confronta "$TMP/r.txt" "$PROVE/dipendenze.atteso" -L 2 "$PROVE/dipendenze.txt"
+esito $? "dipendenze.txt -L 2"
+
+# 5. portata: $24 risale di 30 operazioni, oltre le 15 di -f 8; si fermano le operazioni successive
+simula -f 8 -o "$TMP/r.txt" "$PROVE/dipendenze.txt"
+codice=$?
+head -n 22 "$PROVE/dipendenze.atteso" >"$TMP/a.txt"
+[ $codice -eq 1 ] && grep -qF "Riga 24: riferimento \$N oltre 15 operazioni" "$TMP/log" && cmp -s "$TMP/r.txt" "$TMP/a.txt"
+esito $? "riferimento oltre la portata (-f 8)"
+
+# 6. ripresa: calcolo reale lento, il padre viene ucciso dopo il primo punto di ripresa
+./generatore -n 20000 -p 4 -d 0.2:20 -s 5 "$TMP/k.txt" >"$TMP/log" &&
+	simula -o "$TMP/k.atteso" "$TMP/k.txt"
+./father -R -c 50000 -C 500 -o "$TMP/k.out" "$TMP/k.txt" >"$TMP/log" 2>&1 &
+padre=$!
+attese=0
+while [ ! -s "$TMP/k.out" ] && [ $attese -lt 200 ]; do
+	sleep 0.05
+	attese=$((attese+1))
+done
+kill -9 $padre 2>/dev/null
+wait $padre 2>/dev/null
+[ -s "$TMP/k.out.ripresa" ] &&
+	simula -C 500 -P -o "$TMP/k.out" "$TMP/k.txt" &&
+	grep -q "Ripresa dopo" "$TMP/log" &&
+	cmp -s "$TMP/k.out" "$TMP/k.atteso"
+esito $? "ripresa (-P) dopo l'uccisione del padre"
+
+if [ $falliti -gt 0 ]; then
+	echo "$falliti prove fallite"
+	exit 1
+fi
+echo "tutte le prove superate"
+exit 0
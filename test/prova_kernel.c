@@ -0,0 +1,111 @@
+/**
+ * @file prova_kernel.c
+ * @author Marco Colognese
+*/
+
+#include "../mylib.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <limits.h>
+
+/**
+ * @brief Prova che confronta ogni kernel supportato (scalare, sse2, avx2) con il calcolo di un'operazione alla volta.
+ *
+ *	Gli operandi sono tutte le coppie di valori limite (0, 1, -1, INT_MIN, INT_MAX, ...), con
+ *	ogni operatore: comprese la divisione per zero (risultato 0) e INT_MIN/-1 (INT_MIN, come
+ *	ogni altra operazione che esce dall'intervallo degli int). Le operazioni vengono svolte sia
+ *	con kernel_lotto(), a lotti di ogni lunghezza da 1 a LOTTO, sia con kernel_calcola(), cosi'
+ *	da passare anche per le code dei vettori. Termina con 1 alla prima differenza.
+ *
+ *	Uso: prova_kernel
+*/
+
+static const char OPERAZIONI[4]={'+', '-', '*', '/'};
+
+///Valori limite degli operandi
+static const int LIMITI[]={0, 1, -1, 2, -2, 3, -7, 7, 46341, -46341, 65536, INT_MAX, INT_MIN, INT_MAX-1, INT_MIN+1};
+
+#define NUM_LIMITI (int)(sizeof(LIMITI)/sizeof(LIMITI[0]))
+
+/**
+ * @brief Funzione che svolge un'operazione come il vecchio ciclo dei figli, in aritmetica modulo 2^32.
+*/
+
+static int per_op(int a, char op, int b){
+	switch(op){
+		case '+': return (int)((unsigned)a+(unsigned)b);
+		case '-': return (int)((unsigned)a-(unsigned)b);
+		case '*': return (int)((unsigned)a*(unsigned)b);
+		case '/': return (b==0) ? 0 : (b==-1) ? (int)(0u-(unsigned)a) : a/b;
+		default: return 0;
+	}
+}
+
+int main(void){
+	int n=4*NUM_LIMITI*NUM_LIMITI;
+	lavoro *l;
+	int *res, *atteso, *a, *b;
+	int i, j, k, m, tipo, massimo, errori=0;
+
+	l=(lavoro *)calloc(n, sizeof(lavoro));
+	res=(int *)malloc(n*sizeof(int));
+	atteso=(int *)malloc(n*sizeof(int));
+	a=(int *)malloc(n*sizeof(int));
+	b=(int *)malloc(n*sizeof(int));
+	if(l==NULL || res==NULL || atteso==NULL || a==NULL || b==NULL){
+		fprintf(stderr, "Allocazione fallita\n");
+		exit(1);
+	}
+	//operatori mescolati, perche' kernel_lotto() li raggruppi
+	for(i=0, m=0; i<NUM_LIMITI; i++)
+		for(j=0; j<NUM_LIMITI; j++)
+			for(k=0; k<4; k++, m++){
+				l[m].val1=LIMITI[i];
+				l[m].val2=LIMITI[j];
+				l[m].op=OPERAZIONI[(k+i+j)%4];
+				atteso[m]=per_op(l[m].val1, l[m].op, l[m].val2);
+			}
+
+	massimo=kernel_init(KERNEL_AUTO);
+	for(tipo=KERNEL_SCALARE; tipo<=massimo; tipo++){
+		kernel_init(tipo);
+		//lotti di ogni lunghezza
+		for(m=1; m<=LOTTO && errori==0; m++){
+			memset(res, 0x55, n*sizeof(int));
+			for(i=0; i<n; i+=m)
+				kernel_lotto(l+i, res+i, (n-i<m) ? n-i : m);
+			for(i=0; i<n && errori==0; i++)
+				if(res[i]!=atteso[i]){
+					fprintf(stderr, "kernel=%s lotto=%d: %d%c%d=%d invece di %d\n", kernel_nome(tipo), m, l[i].val1, l[i].op, l[i].val2, res[i], atteso[i]);
+					errori++;
+				}
+		}
+		//un solo operatore, su array contigui di ogni lunghezza
+		for(k=0; k<4 && errori==0; k++){
+			for(i=0; i<n; i++){
+				a[i]=l[i].val1;
+				b[i]=l[i].val2;
+			}
+			for(m=1; m<=n && errori==0; m+=(m<2*LOTTO) ? 1 : LOTTO-1){
+				memset(res, 0x55, n*sizeof(int));
+				kernel_calcola(OPERAZIONI[k], a, b, res, m);
+				for(i=0; i<m && errori==0; i++)
+					if(res[i]!=per_op(a[i], OPERAZIONI[k], b[i])){
+						fprintf(stderr, "kernel=%s contiguo=%d: %d%c%d=%d invece di %d\n", kernel_nome(tipo), m, a[i], OPERAZIONI[k], b[i], res[i], per_op(a[i], OPERAZIONI[k], b[i]));
+						errori++;
+					}
+			}
+		}
+		if(errori>0)
+			break;
+		printf("kernel=%s operazioni=%d ok\n", kernel_nome(tipo), n);
+	}
+
+	free(l);
+	free(res);
+	free(atteso);
+	free(a);
+	free(b);
+	return (errori>0) ? 1 : 0;
+}
@@ -0,0 +1,143 @@
+/**
+ * @file traccia.c
+ * @author Marco Colognese
+*/
+
+#include "mylib.h"
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+///Nomi degli eventi, nell'ordine dei TR_*
+static const char *nomi[]={"lettura", "invio", "scelta", "parcheggio", "attesa", "raccolta", "calcolo", "termina"};
+
+///Nome dell'argomento di ciascun evento nel file (NULL = l'evento non ha argomento)
+static const char *argomenti[]={NULL, "figlio", "figlio", "figlio", NULL, "risultati", "operazioni", NULL};
+
+/**
+ * @brief Funzione che abilita la traccia: crea un anello di eventi per il padre e uno per ciascun figlio.
+ *
+ *	Gli anelli stanno in una mappatura anonima condivisa a parte, creata prima dei figli che la
+ *	ereditano: la regione delle code non cambia e, senza traccia, il costo e' un solo confronto
+ *	di a->tracce con NULL. Le pagine vengono allocate dal kernel solo quando vengono scritte.
+ *
+ * @param a		regione condivisa
+ * @return		0 in caso di successo, -1 in caso di errore
+*/
+
+int traccia_crea(arena *a){
+	size_t dim=(size_t)(a->num_proc+1)*sizeof(traccia);
+	traccia *t;
+
+	t=(traccia *)mmap(NULL, dim, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+	if(t==(traccia *)MAP_FAILED)
+		return -1;
+	a->tracce=t;
+	return 0;
+}
+
+/**
+ * @brief Funzione che aggiunge un evento, terminato adesso, all'anello di chi.
+ *
+ *	Ogni anello ha un solo produttore (il padre o il suo figlio) e viene letto solo alla fine,
+ *	quando i figli sono terminati: non serve alcuna operazione atomica. Quando l'anello e' pieno
+ *	si sovrascrivono gli eventi piu' vecchi. Si usa attraverso la macro TRACCIA.
+ *
+ * @param a		regione condivisa
+ * @param chi		0 per il padre, j per il figlio j
+ * @param tipo		tipo dell'evento (TR_*)
+ * @param inizio	istante di inizio dell'evento (orologio_ns); 0 = evento istantaneo
+ * @param arg		argomento dell'evento
+*/
+
+void traccia_evento(arena *a, int chi, int tipo, unsigned long long inizio, unsigned arg){
+	traccia *t=&a->tracce[chi];
+	evento *e=&t->ev[t->scritti%TRACCIA_EVENTI];
+	unsigned long long ora=orologio_ns();
+
+	e->inizio=(inizio==0) ? ora : inizio;
+	e->durata=ora-e->inizio;
+	e->arg=arg;
+	e->tipo=tipo;
+	t->scritti++;
+}
+
+/**
+ * @brief Funzione che scrive la traccia nel formato JSON di Chrome (chrome://tracing, Perfetto).
+ *
+ *	Gli anelli del padre e dei figli vengono riuniti in un unico file, un thread per ciascuno
+ *	(tid 0 = padre, tid j = figlio j), con eventi completi ("ph":"X") e tempi in microsecondi
+ *	dal primo evento. Va chiamata dopo la terminazione dei figli.
+ *
+ * @param a		regione condivisa
+ * @param nome		nome del file ("-" = STDOUT)
+ * @return		numero di eventi persi perche' sovrascritti, -1 in caso di errore
+*/
+
+long long traccia_scrivi(const arena *a, const char *nome){
+	const traccia *t;
+	const evento *e;
+	char riga[256];
+	unsigned long long base=~0ULL, k, primo;
+	long long persi=0;
+	uscita u;
+	int fd, j;
+
+	if(a->tracce==NULL)
+		return 0;
+	if((fd=(strcmp(nome, "-")==0) ? STDOUT : creat(nome, 0666))==-1)
+		return -1;
+	if(uscita_apri(&u, fd, false, false)==-1){
+		if(fd!=STDOUT)
+			close(fd);
+		return -1;
+	}
+
+	//origine dei tempi: l'evento piu' vecchio rimasto negli anelli
+	for(j=0; j<=a->num_proc; j++){
+		t=&a->tracce[j];
+		primo=(t->scritti>TRACCIA_EVENTI) ? t->scritti-TRACCIA_EVENTI : 0;
+		for(k=primo; k<t->scritti; k++)
+			if(t->ev[k%TRACCIA_EVENTI].inizio<base)
+				base=t->ev[k%TRACCIA_EVENTI].inizio;
+	}
+
+	uscita_scrivi(&u, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", strlen("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"));
+	for(j=0; j<=a->num_proc; j++){
+		if(j==0)
+			sprintf(riga, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"padre\"}}");
+		else
+			sprintf(riga, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"figlio %d\"}}", j, j);
+		uscita_scrivi(&u, riga, strlen(riga));
+	}
+	for(j=0; j<=a->num_proc; j++){
+		t=&a->tracce[j];
+		primo=(t->scritti>TRACCIA_EVENTI) ? t->scritti-TRACCIA_EVENTI : 0;
+		persi+=primo;
+		for(k=primo; k<t->scritti; k++){
+			e=&t->ev[k%TRACCIA_EVENTI];
+			if(argomenti[e->tipo]!=NULL)
+				sprintf(riga, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"%s\":%u}}", nomi[e->tipo], j, (e->inizio-base)*1e-3, e->durata*1e-3, argomenti[e->tipo], e->arg);
+			else
+				sprintf(riga, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", nomi[e->tipo], j, (e->inizio-base)*1e-3, e->durata*1e-3);
+			uscita_scrivi(&u, riga, strlen(riga));
+		}
+	}
+	uscita_scrivi(&u, "\n]}\n", strlen("\n]}\n"));
+	return (uscita_chiudi(&u)==-1) ? -1 : persi;
+}
+
+/**
+ * @brief Funzione che rimuove gli anelli della traccia.
+ *
+ * @param a		regione condivisa
+*/
+
+void traccia_distruggi(arena *a){
+	if(a->tracce==NULL)
+		return;
+	munmap(a->tracce, (size_t)(a->num_proc+1)*sizeof(traccia));
+	a->tracce=NULL;
+}
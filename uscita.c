@@ -0,0 +1,486 @@
+/**
+ * @file uscita.c
+ * @author Marco Colognese
+*/
+
+#include "mylib.h"
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+/**
+ * @brief Funzione che prepara la scrittura bufferizzata dei risultati sul file descriptor fd.
+ *
+ *	I risultati vengono accumulati in un buffer di dimensione fissa e scritti con una sola
+ *	write() quando il buffer e' pieno o quando viene chiamata uscita_svuota(): la memoria usata
+ *	non dipende dal numero di risultati. Nel formato binario il file inizia con un'intestazione
+ *	intestazione_risultati ed e' seguito da un record_risultato per ogni risultato; un file che
+ *	si continua (la ripresa di una simulazione) ha gia' l'intestazione.
+ *
+ * @param u		scrittore da inizializzare
+ * @param fd		file descriptor su cui scrivere (file, pipe o STDOUT)
+ * @param binario	booleano che indica se scrivere i risultati nel formato binario
+ * @param intestato	booleano che indica che il file ha gia' l'intestazione binaria (non va riscritta)
+ * @return		0 in caso di successo, -1 se il buffer non puo' essere allocato
+*/
+
+int uscita_apri(uscita *u, int fd, bool binario, bool intestato){
+	intestazione_risultati t;
+
+	u->fd=fd;
+	u->len=0;
+	u->cap=USCITA_BLOCCO;
+	u->binario=binario;
+	u->errore=false;
+	u->as=NULL;
+	u->limite=0;
+	if((u->buf=(char *)malloc(u->cap))==NULL)
+		return -1;
+	if(binario && !intestato){
+		memset(&t, 0, sizeof(t));
+		memcpy(t.magia, MAGIA_RISULTATI, 4);
+		t.versione=FORMATO_VERSIONE;
+		t.dim_record=sizeof(record_risultato);
+		uscita_scrivi(u, (const char *)&t, sizeof(t));
+	}
+	return 0;
+}
+
+/**
+ * @brief Funzione che scrive n byte sul file descriptor, ripetendo la write() se scrive solo una parte dei byte o viene interrotta.
+ *
+ * @param fd		file descriptor
+ * @param buf		byte da scrivere
+ * @param n		numero di byte
+ * @return		0 in caso di successo, -1 in caso di errore di scrittura
+*/
+
+static int scrivi_tutto(int fd, const char *buf, size_t n){
+	size_t fatti=0;
+	ssize_t r;
+
+	while(fatti<n){
+		r=write(fd, buf+fatti, n-fatti);
+		if(r==-1){
+			if(errno==EINTR)
+				continue;
+			return -1;
+		}
+		fatti+=r;
+	}
+	return 0;
+}
+
+/**
+ * @brief Funzione che porta su disco i byte gia' scritti (fdatasync); pipe e terminali non ne hanno bisogno.
+ *
+ * @param fd		file descriptor
+ * @return		0 in caso di successo, -1 in caso di errore
+*/
+
+static int sincronizza(int fd){
+	if(fdatasync(fd)==-1 && errno!=EINVAL && errno!=EROFS)
+		return -1;
+	return 0;
+}
+
+/**
+ * @brief Funzione eseguita dal thread di scrittura asincrona: scrive ogni blocco consegnato e lo segnala come scritto.
+ *
+ * @param arg		scrittore (uscita)
+*/
+
+static void *scrivi_blocchi(void *arg){
+	uscita *u=(uscita *)arg;
+	scrittura_asincrona *as=u->as;
+	size_t n;
+	int r;
+
+	pthread_mutex_lock(&as->m);
+	for(;;){
+		while(as->da_scrivere==0 && !as->basta)
+			pthread_cond_wait(&as->consegnato, &as->m);
+		if(as->da_scrivere==0)
+			break;
+		//il blocco in as->altro non viene toccato dal chiamante finche' da_scrivere non torna a 0
+		n=as->da_scrivere;
+		pthread_mutex_unlock(&as->m);
+		r=scrivi_tutto(u->fd, as->altro, n);
+		if(r==0 && as->fsync==FSYNC_BLOCCO)
+			r=sincronizza(u->fd);
+		pthread_mutex_lock(&as->m);
+		if(r==-1)
+			as->errore=true;
+		as->blocchi++;
+		as->da_scrivere=0;
+		pthread_cond_broadcast(&as->scritto);
+	}
+	pthread_mutex_unlock(&as->m);
+	return NULL;
+}
+
+/**
+ * @brief Funzione che attende che il thread di scrittura abbia finito il blocco consegnato. Va chiamata con il mutex preso.
+ *
+ * @param u		scrittore con la scrittura asincrona
+*/
+
+static void attendi_scritto(uscita *u){
+	scrittura_asincrona *as=u->as;
+	struct timespec t0, t1;
+
+	if(as->da_scrivere==0)
+		return;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	while(as->da_scrivere>0)
+		pthread_cond_wait(&as->scritto, &as->m);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	as->ns_attesa+=(t1.tv_sec-t0.tv_sec)*1000000000ULL+t1.tv_nsec-t0.tv_nsec;
+}
+
+/**
+ * @brief Funzione che scambia i due buffer e sveglia il thread di scrittura. Va chiamata con il mutex preso e il thread libero.
+ *
+ * @param u		scrittore con la scrittura asincrona
+*/
+
+static void scambia(uscita *u){
+	scrittura_asincrona *as=u->as;
+	char *b;
+
+	b=as->altro;
+	as->altro=u->buf;
+	u->buf=b;
+	as->da_scrivere=u->len;
+	if(as->errore)
+		u->errore=true;
+	pthread_cond_signal(&as->consegnato);
+	u->len=0;
+}
+
+/**
+ * @brief Funzione che consegna il buffer al thread di scrittura e continua sull'altro buffer.
+ *
+ *	Se il thread sta ancora scrivendo il blocco precedente si attende che finisca: al piu' un
+ *	blocco e' in scrittura mentre il chiamante riempie l'altro.
+ *
+ * @param u		scrittore con la scrittura asincrona
+*/
+
+static void consegna(uscita *u){
+	scrittura_asincrona *as=u->as;
+
+	if(u->len==0)
+		return;
+	pthread_mutex_lock(&as->m);
+	attendi_scritto(u);
+	scambia(u);
+	pthread_mutex_unlock(&as->m);
+}
+
+/**
+ * @brief Funzione che avvia la scrittura asincrona: le write() passano a un thread, con due buffer di soglia byte.
+ *
+ *	Quando il buffer raggiunge la soglia viene consegnato al thread, che lo scrive mentre il
+ *	chiamante continua sull'altro buffer: la scrittura del file si sovrappone al calcolo invece
+ *	di sommarsi. uscita_svuota() resta sincrona: al ritorno tutti i byte sono stati scritti (e
+ *	con FSYNC_BLOCCO portati su disco), come serve ai punti di ripresa. Con FSYNC_FINE il file
+ *	viene portato su disco solo in uscita_chiudi().
+ *
+ * @param u		scrittore, aperto con uscita_apri()
+ * @param soglia	byte accumulati prima di consegnare un blocco al thread (almeno USCITA_RIGA)
+ * @param fsync		FSYNC_MAI, FSYNC_BLOCCO o FSYNC_FINE
+ * @return		0 in caso di successo, -1 in caso di errore
+*/
+
+int uscita_asincrona(uscita *u, size_t soglia, int fsync){
+	scrittura_asincrona *as;
+	char *b;
+
+	if(u->as!=NULL || soglia<USCITA_RIGA)
+		return -1;
+	if(u->len>soglia && uscita_svuota(u)==-1)
+		return -1;
+	if((as=(scrittura_asincrona *)calloc(1, sizeof(scrittura_asincrona)))==NULL)
+		return -1;
+	if((as->altro=(char *)malloc(soglia))==NULL || (b=(char *)realloc(u->buf, soglia))==NULL){
+		free(as->altro);
+		free(as);
+		return -1;
+	}
+	u->buf=b;
+	u->cap=soglia;
+	as->fsync=fsync;
+	pthread_mutex_init(&as->m, NULL);
+	pthread_cond_init(&as->consegnato, NULL);
+	pthread_cond_init(&as->scritto, NULL);
+	u->as=as;
+	if(pthread_create(&as->thread, NULL, scrivi_blocchi, u)!=0){
+		u->as=NULL;
+		pthread_mutex_destroy(&as->m);
+		pthread_cond_destroy(&as->consegnato);
+		pthread_cond_destroy(&as->scritto);
+		free(as->altro);
+		free(as);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Funzione che rende non bloccante la scrittura su un socket: i byte che il socket non accetta restano nel buffer.
+ *
+ *	Ogni scrittura usa send() con MSG_DONTWAIT, senza cambiare i flag del socket (che puo'
+ *	essere condiviso con un lettore bloccante). Quando il buffer e' pieno cresce, fino a limite
+ *	byte; oltre il limite i byte vengono scartati e lo scrittore segna l'errore.
+ *
+ * @param u		scrittore su un socket
+ * @param limite	byte che il buffer puo' contenere al piu' (almeno la capacita' iniziale)
+*/
+
+void uscita_non_bloccante(uscita *u, size_t limite){
+	u->limite=limite;
+}
+
+/**
+ * @brief Funzione che scrive sul socket i byte del buffer che accetta senza bloccarsi, tenendo gli altri.
+ *
+ * @param u		scrittore non bloccante
+ * @return		0 in caso di successo (anche se restano byte da scrivere), -1 in caso di errore
+*/
+
+static int svuota_non_bloccante(uscita *u){
+	size_t fatti=0;
+	ssize_t r;
+
+	while(fatti<u->len){
+		r=send(u->fd, u->buf+fatti, u->len-fatti, MSG_DONTWAIT|MSG_NOSIGNAL);
+		if(r==-1){
+			if(errno==EINTR)
+				continue;
+			if(errno!=EAGAIN && errno!=EWOULDBLOCK){
+				u->errore=true;
+				fatti=u->len;
+			}
+			break;
+		}
+		fatti+=r;
+	}
+	memmove(u->buf, u->buf+fatti, u->len-fatti);
+	u->len-=fatti;
+	return u->errore ? -1 : 0;
+}
+
+/**
+ * @brief Funzione che scrive sul file descriptor tutti i byte accumulati nel buffer.
+ *
+ *	Con la scrittura asincrona il buffer viene consegnato al thread e si attende che sia scritto.
+ *	Con la scrittura non bloccante restano nel buffer i byte che il socket non accetta.
+ *
+ * @param u		scrittore
+ * @return		0 in caso di successo, -1 in caso di errore di scrittura
+*/
+
+int uscita_svuota(uscita *u){
+	if(u->limite>0)
+		return svuota_non_bloccante(u);
+	if(u->as!=NULL){
+		consegna(u);
+		pthread_mutex_lock(&u->as->m);
+		attendi_scritto(u);
+		if(u->as->errore)
+			u->errore=true;
+		pthread_mutex_unlock(&u->as->m);
+		return u->errore ? -1 : 0;
+	}
+	if(scrivi_tutto(u->fd, u->buf, u->len)==-1)
+		u->errore=true;
+	u->len=0;
+	return u->errore ? -1 : 0;
+}
+
+/**
+ * @brief Funzione che avvia la scrittura dei byte accumulati senza attendere che finisca.
+ *
+ *	Con la scrittura asincrona il buffer passa al thread solo se il thread e' libero; se sta
+ *	ancora scrivendo il blocco precedente i byte restano nel buffer e passeranno alla prossima
+ *	chiamata. Senza il thread equivale a uscita_svuota().
+ *
+ * @param u		scrittore
+ * @return		0 se non restano byte nel buffer, 1 se restano byte da passare al thread, -1 in caso di errore di scrittura
+*/
+
+int uscita_inoltra(uscita *u){
+	scrittura_asincrona *as=u->as;
+
+	if(as==NULL)
+		return uscita_svuota(u);
+	if(u->len>0){
+		pthread_mutex_lock(&as->m);
+		if(as->da_scrivere==0)
+			scambia(u);
+		pthread_mutex_unlock(&as->m);
+	}
+	if(u->errore)
+		return -1;
+	return (u->len>0) ? 1 : 0;
+}
+
+/**
+ * @brief Funzione che fa posto nel buffer pieno: lo scrive, o lo consegna al thread di scrittura asincrona senza attendere.
+ *
+ *	Nella scrittura non bloccante, se il socket non accetta abbastanza byte, il buffer raddoppia
+ *	fino al limite; oltre, i byte non scritti vengono scartati e lo scrittore segna l'errore.
+ *
+ * @param u		scrittore
+ * @param n		byte che devono starci
+*/
+
+static void fai_posto(uscita *u, size_t n){
+	char *b;
+
+	if(u->as!=NULL){
+		consegna(u);
+		return;
+	}
+	uscita_svuota(u);
+	if(u->limite==0 || u->len+n<=u->cap)
+		return;
+	if(2*u->cap>u->limite || (b=(char *)realloc(u->buf, 2*u->cap))==NULL){
+		u->errore=true;
+		u->len=0;
+		return;
+	}
+	u->buf=b;
+	u->cap*=2;
+}
+
+/**
+ * @brief Funzione che aggiunge n byte al buffer, svuotandolo prima se non c'e' spazio.
+ *
+ * @param u		scrittore
+ * @param s		byte da scrivere
+ * @param n		numero di byte (al piu' la capacita' del buffer: USCITA_BLOCCO, o la soglia con la scrittura asincrona)
+*/
+
+void uscita_scrivi(uscita *u, const char *s, size_t n){
+	if(u->len+n>u->cap)
+		fai_posto(u, n);
+	memcpy(u->buf+u->len, s, n);
+	u->len+=n;
+}
+
+///Coppie di cifre decimali da 00 a 99, per convertire due cifre alla volta
+static const char CIFRE[201]=
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+/**
+ * @brief Funzione che scrive in s la rappresentazione decimale di n, sostituendo le vecchie itoa() e reverse().
+ *
+ *	Le cifre vengono prodotte a coppie, dalla meno significativa, in un buffer temporaneo e poi
+ *	copiate: nessuna inversione e nessun terminatore. Funziona anche per INT_MIN.
+ *
+ * @param s		destinazione (almeno 11 caratteri)
+ * @param n		valore intero
+ * @return		numero di caratteri scritti
+*/
+
+size_t scrivi_intero(char *s, int n){
+	char tmp[BUFLEN];
+	char *c=tmp+BUFLEN;
+	unsigned v=(n<0) ? 0u-(unsigned)n : (unsigned)n;
+	size_t len;
+
+	while(v>=100){
+		c-=2;
+		memcpy(c, CIFRE+2*(v%100), 2);
+		v/=100;
+	}
+	if(v>=10){
+		c-=2;
+		memcpy(c, CIFRE+2*v, 2);
+	}
+	else
+		*--c='0'+v;
+	if(n<0)
+		*--c='-';
+	len=tmp+BUFLEN-c;
+	memcpy(s, c, len);
+	return len;
+}
+
+/**
+ * @brief Funzione che scrive nel buffer la riga <num1><op><num2>=<res> di un risultato.
+ *
+ *	La riga viene formattata direttamente nel buffer, senza stringhe intermedie. Nel formato
+ *	binario viene invece scritto un record_risultato.
+ *
+ * @param u		scrittore
+ * @param r		risultato da scrivere
+*/
+
+void uscita_risultato(uscita *u, const risultato *r){
+	record_risultato b;
+	char *s;
+
+	if(u->len+USCITA_RIGA>u->cap)
+		fai_posto(u, USCITA_RIGA);
+	if(u->binario){
+		b.val1=r->val1;
+		b.val2=r->val2;
+		b.res=r->res;
+		b.op=r->op;
+		memset(b.riservato, 0, sizeof(b.riservato));
+		memcpy(u->buf+u->len, &b, sizeof(b));
+		u->len+=sizeof(b);
+		return;
+	}
+	s=u->buf+u->len;
+	s+=scrivi_intero(s, r->val1);
+	*s++=r->op;
+	s+=scrivi_intero(s, r->val2);
+	*s++='=';
+	s+=scrivi_intero(s, r->res);
+	*s++='\n';
+	u->len=s-u->buf;
+}
+
+/**
+ * @brief Funzione che svuota il buffer, lo libera e chiude il file descriptor (tranne STDOUT).
+ *
+ *	Con la scrittura asincrona termina anche il thread e, con FSYNC_FINE, porta il file su disco.
+ *
+ * @param u		scrittore
+ * @return		0 se tutti i risultati sono stati scritti, -1 altrimenti
+*/
+
+int uscita_chiudi(uscita *u){
+	scrittura_asincrona *as=u->as;
+
+	uscita_svuota(u);
+	if(as!=NULL){
+		pthread_mutex_lock(&as->m);
+		as->basta=true;
+		pthread_cond_signal(&as->consegnato);
+		pthread_mutex_unlock(&as->m);
+		pthread_join(as->thread, NULL);
+		if(as->fsync==FSYNC_FINE && !u->errore && sincronizza(u->fd)==-1)
+			u->errore=true;
+		pthread_mutex_destroy(&as->m);
+		pthread_cond_destroy(&as->consegnato);
+		pthread_cond_destroy(&as->scritto);
+		free(as->altro);
+		free(as);
+		u->as=NULL;
+	}
+	free(u->buf);
+	u->buf=NULL;
+	if(u->fd!=STDOUT && close(u->fd)==-1)
+		u->errore=true;
+	return u->errore ? -1 : 0;
+}